@@ -153,38 +153,6 @@ get_screen_size(void)
 	return rv;
 }
 
-/*
- * Allocate the display lines in the vscreen[] array.
- * Call this before using vscreen[].
- *
- * Return true with vscreen[] allocated to TEXT_ROWS*current_columns characters if successful.
- */
-int
-malloc_vscreen(void)
-{
-	int	i;
-
-	if (current_columns == 0 || ((screen_columns > 0) ? (current_columns != screen_columns) : (current_columns != TEXT_COLUMNS))) {
-		if (screen_columns > 0) {
-			current_columns = screen_columns;
-		} else {
-			current_columns = TEXT_COLUMNS;
-		}
-		for (i = 0; i < TEXT_ROWS; i++) {
-			if (vscreen[i]) {
-				free(vscreen[i]);
-			}
-			vscreen[i] = malloc(current_columns + 1);
-			if (vscreen[i] == NULL) {
-				error(_("Out of memory (can't malloc(3))."));
-				current_columns = 0;
-				return false;
-			}
-		}
-	}
-	return true;
-}
-
 /*
  * Allocate the needed global expression storage arrays.
  * Each is static and can hold n_tokens elements.
@@ -321,6 +289,7 @@ clean_up(void)
 		gfp = default_out;
 	}
 	gfp_filename = NULL;
+	gradient_clean_up();	/* free any interrupted gradient code generation */
 	for (i = 0; i < n_equations; i++) {
 		if (n_lhs[i] <= 0) {
 			n_lhs[i] = 0;
@@ -330,29 +299,141 @@ clean_up(void)
 }
 
 /*
- * Register all sign variables in all equation spaces
- * so that the next sign variables returned by next_sign() will be unique.
+ * The sign variable subscripts used in each equation space, as bit masks,
+ * so only the equation spaces written since they were last scanned are scanned again.
+ */
+static sign_mask_type	sign_masks[N_EQUATIONS];
+static char		sign_mask_ok[N_EQUATIONS];	/* true if sign_masks[] is up to date */
+static char		espace_changed[N_EQUATIONS];	/* true if written during the current command */
+
+/*
+ * The inverted index of the variables in the equation spaces.
+ * espace_vars[en] is the list of distinct variables in equation space "en" with their occurrence counts,
+ * in ascending order, and var_index[] is a hash table of the set of equation spaces each variable is in.
+ * Like the sign variable masks, only the equation spaces written since they were last scanned are scanned again.
+ */
+#define	ESPACE_WORDS	((N_EQUATIONS + 63) / 64)
+
+typedef struct {		/* var_index[] hash table entry */
+	long			v;			/* Mathomatic variable, or 0 if unused */
+	unsigned long long	espaces[ESPACE_WORDS];	/* bit set of the equation spaces containing v */
+} var_index_type;
+
+static sort_type	*espace_vars[N_EQUATIONS];
+static int		n_espace_vars[N_EQUATIONS];
+static int		espace_vars_size[N_EQUATIONS];	/* allocated size of espace_vars[] */
+static char		espace_vars_ok[N_EQUATIONS];	/* true if espace_vars[] and var_index[] are up to date */
+static var_index_type	*var_index;
+static int		var_index_size;			/* number of var_index[] entries, a power of 2 */
+static int		var_index_used;			/* number of var_index[] entries with a variable */
+static long		*scan_buf;			/* the variables collected by scan_espace_vars() */
+static int		scan_buf_size;
+
+/*
+ * Note that equation space "en" was or may be written by the current command,
+ * or all equation spaces if "en" is negative.
+ * Its sign variables and other variables will be scanned again when next needed,
+ * including by later commands, in case they are scanned before the writing is done.
  */
 void
-set_sign_array(void)
+espace_written(en)
+int	en;
+{
+	int	i;
+
+	if (en >= N_EQUATIONS)
+		return;
+	if (en >= 0) {
+		sign_mask_ok[en] = false;
+		espace_vars_ok[en] = false;
+		espace_changed[en] = true;
+		return;
+	}
+	for (i = 0; i < N_EQUATIONS; i++) {
+		sign_mask_ok[i] = false;
+		espace_vars_ok[i] = false;
+		espace_changed[i] = true;
+	}
+}
+
+/*
+ * Forget all registered sign variables, before processing a command.
+ * The sign variables in all equation spaces are registered by next_sign()
+ * only when a new sign variable is actually needed,
+ * so most commands never scan the equation spaces for them.
+ */
+void
+reset_sign_array(void)
 {
-	int	i, j;
+	int	i;
 
+	for (i = 0; i < N_EQUATIONS; i++) {
+		if (espace_changed[i]) {
+			sign_mask_ok[i] = false;
+			espace_vars_ok[i] = false;
+			espace_changed[i] = false;
+		}
+	}
 	CLEAR_ARRAY(sign_array);
+	sign_array_stale = true;
+}
+
+/*
+ * Return the bit mask of the sign variable subscripts used in expression "p1".
+ */
+static sign_mask_type
+sign_mask(p1, n)
+token_type	*p1;
+int		n;
+{
+	int		j;
+	sign_mask_type	mask = 0;
+
+	for (j = 0; j < n; j += 2) {
+		if (p1[j].kind == VARIABLE && (p1[j].token.variable & VAR_MASK) == SIGN) {
+			mask |= ((sign_mask_type) 1) << ((p1[j].token.variable >> VAR_SHIFT) & SUBSCRIPT_MASK);
+		}
+	}
+	return mask;
+}
+
+/*
+ * Add the sign variables in all equation spaces to sign_array[],
+ * scanning only the equation spaces written since they were last scanned.
+ */
+static void
+register_sign_vars(void)
+{
+	int		i;
+	sign_mask_type	mask = 0;
+
+	sign_array_stale = false;
 	for (i = 0; i < n_equations; i++) {
+		if (!sign_mask_ok[i]) {
+			sign_masks[i] = (n_lhs[i] > 0) ? (sign_mask(lhs[i], n_lhs[i]) | sign_mask(rhs[i], n_rhs[i])) : 0;
+			sign_mask_ok[i] = true;
+		}
 		if (n_lhs[i] > 0) {
-			for (j = 0; j < n_lhs[i]; j += 2) {
-				if (lhs[i][j].kind == VARIABLE && (lhs[i][j].token.variable & VAR_MASK) == SIGN) {
-					sign_array[(lhs[i][j].token.variable >> VAR_SHIFT) & SUBSCRIPT_MASK] = true;
-				}
-			}
-			for (j = 0; j < n_rhs[i]; j += 2) {
-				if (rhs[i][j].kind == VARIABLE && (rhs[i][j].token.variable & VAR_MASK) == SIGN) {
-					sign_array[(rhs[i][j].token.variable >> VAR_SHIFT) & SUBSCRIPT_MASK] = true;
-				}
-			}
+			mask |= sign_masks[i];
 		}
 	}
+	for (i = 0; mask; i++, mask >>= 1) {
+		if (mask & 1) {
+			sign_array[i] = true;
+		}
+	}
+}
+
+/*
+ * Register all sign variables in all equation spaces
+ * so that the next sign variables returned by next_sign() will be unique.
+ */
+void
+set_sign_array(void)
+{
+	espace_written(-1);
+	CLEAR_ARRAY(sign_array);
+	register_sign_vars();
 }
 
 /*
@@ -365,6 +446,9 @@ long	*vp;
 {
 	int	i;
 
+	if (sign_array_stale) {
+		register_sign_vars();
+	}
 	for (i = 0;; i++) {
 		if (i >= ARR_CNT(sign_array)) {
 			/* out of unique sign variables */
@@ -401,6 +485,8 @@ clear_all(void)
 	}
 /* reset everything to a known state */
 	CLEAR_ARRAY(sign_array);
+	espace_written(-1);
+	clear_exact();
 	init_gvars();
 }
 
@@ -569,6 +655,178 @@ long		v;	/* standard Mathomatic variable */
 	return count;
 }
 
+/*
+ * Compare function for qsort(3) of Mathomatic variables.
+ */
+static int
+long_cmp(p1, p2)
+long	*p1, *p2;
+{
+	if (*p1 < *p2)
+		return -1;
+	return(*p1 > *p2);
+}
+
+/*
+ * Return the var_index[] hash table entry for variable "v".
+ * If it is not in the table, return the unused entry where it belongs.
+ */
+static var_index_type *
+var_index_entry(v)
+long	v;
+{
+	unsigned long	h;
+
+	h = (unsigned long) v;
+	h ^= h >> VAR_SHIFT;
+	h *= 2654435761UL;
+	h ^= h >> 16;
+	for (h &= (var_index_size - 1);; h = (h + 1) & (var_index_size - 1)) {
+		if (var_index[h].v == v || var_index[h].v == 0)
+			return &var_index[h];
+	}
+}
+
+/*
+ * Make room in var_index[] for "n" more variables, keeping it at most half full.
+ *
+ * Return true if successful, false if out of memory.
+ */
+static int
+grow_var_index(n)
+int	n;
+{
+	int		i, size, old_size;
+	var_index_type	*old, *ep;
+
+	for (size = var_index_size ? var_index_size : 256; (var_index_used + n) * 2 > size; size *= 2)
+		;
+	if (size == var_index_size)
+		return true;
+	if ((ep = (var_index_type *) calloc(size, sizeof(var_index_type))) == NULL)
+		return false;
+	old = var_index;
+	old_size = var_index_size;
+	var_index = ep;
+	var_index_size = size;
+	for (i = 0; i < old_size; i++) {
+		if (old[i].v) {
+			*var_index_entry(old[i].v) = old[i];
+		}
+	}
+	free(old);
+	return true;
+}
+
+/*
+ * Scan equation space "en" for its variables,
+ * updating espace_vars[en] and var_index[].
+ *
+ * Return true if successful, false if out of memory.
+ */
+static int
+scan_espace_vars(en)
+int	en;
+{
+	int		i, j, k, n, side, len;
+	long		*lp;
+	sort_type	*sp;
+	token_type	*p1;
+	var_index_type	*ep;
+
+	n = 0;
+	if (n_lhs[en] > 0) {
+		n = (n_lhs[en] + max(n_rhs[en], 0)) / 2 + 2;
+	}
+	if (n > scan_buf_size) {
+		if ((lp = (long *) realloc(scan_buf, n * sizeof(long))) == NULL)
+			return false;
+		scan_buf = lp;
+		scan_buf_size = n;
+	}
+	n = 0;
+	for (side = 0; side < 2 && n_lhs[en] > 0; side++) {
+		p1 = side ? rhs[en] : lhs[en];
+		len = side ? n_rhs[en] : n_lhs[en];
+		for (j = 0; j < len; j += 2) {
+			if (p1[j].kind == VARIABLE) {
+				scan_buf[n++] = p1[j].token.variable;
+			}
+		}
+	}
+	qsort((char *) scan_buf, n, sizeof(long), long_cmp);
+	for (i = 0, k = 0; i < n; i++) {
+		if (i == 0 || scan_buf[i] != scan_buf[i-1])
+			k++;
+	}
+	if (k > espace_vars_size[en]) {
+		if ((sp = (sort_type *) realloc(espace_vars[en], k * sizeof(sort_type))) == NULL)
+			return false;
+		espace_vars[en] = sp;
+		espace_vars_size[en] = k;
+	}
+	if (!grow_var_index(k))
+		return false;
+	for (i = 0; i < n_espace_vars[en]; i++) {
+		ep = var_index_entry(espace_vars[en][i].v);
+		ep->espaces[en / 64] &= ~(1ULL << (en % 64));
+	}
+	sp = espace_vars[en];
+	for (i = 0, k = 0; i < n; i++) {
+		if (k && scan_buf[i] == sp[k-1].v) {
+			sp[k-1].count++;
+			continue;
+		}
+		sp[k].v = scan_buf[i];
+		sp[k].count = 1;
+		k++;
+		ep = var_index_entry(scan_buf[i]);
+		if (ep->v == 0) {
+			ep->v = scan_buf[i];
+			var_index_used++;
+		}
+		ep->espaces[en / 64] |= (1ULL << (en % 64));
+	}
+	n_espace_vars[en] = k;
+	espace_vars_ok[en] = true;
+	return true;
+}
+
+/*
+ * Return true if the index of the variables in equation space "en" can be used,
+ * scanning it if it was written since it was last scanned.
+ * Equation spaces written by the current command are not trusted,
+ * because they may be written again after being scanned.
+ */
+static int
+espace_vars_usable(en)
+int	en;
+{
+	if (en < 0 || en >= N_EQUATIONS || espace_changed[en])
+		return false;
+	return(espace_vars_ok[en] || scan_espace_vars(en));
+}
+
+/*
+ * Set "*vpp" to the list of the distinct variables in equation space "en",
+ * with their occurrence counts, in ascending order.
+ * The list is valid until equation space "en" is written.
+ *
+ * Return the number of variables in the list, or -1 with an error message if out of memory.
+ */
+int
+espace_var_list(en, vpp)
+int		en;
+sort_type	**vpp;
+{
+	if (!espace_vars_usable(en) && !scan_espace_vars(en)) {
+		error(_("Out of memory (can't malloc(3))."));
+		return -1;
+	}
+	*vpp = espace_vars[en];
+	return n_espace_vars[en];
+}
+
 /*
  * Return true if variable "v" exists in equation space "i".
  */
@@ -579,6 +837,9 @@ long	v;	/* standard Mathomatic variable */
 {
 	if (empty_equation_space(i))
 		return false;
+	if (v && espace_vars_usable(i)) {
+		return((var_index_entry(v)->espaces[i / 64] >> (i % 64)) & 1);
+	}
 	if (found_var(lhs[i], n_lhs[i], v))
 		return true;
 	if (n_rhs[i] <= 0)
@@ -594,14 +855,24 @@ long	v;	/* standard Mathomatic variable */
  * Search forward starting at the next equation space if forward_direction is true,
  * otherwise search backwards starting at the previous equation space.
  * If found, return true with cur_equation set to the equation space the variable is found in.
+ * Only the bit set of the equation spaces containing "v" is checked,
+ * except for the equation spaces that must be scanned.
  */
 int
 search_all_for_var(v, forward_direction)
 long	v;
 int	forward_direction;
 {
-	int	i, n;
+	int		i, n;
+	var_index_type	*ep = NULL;
 
+	for (i = 0; i < n_equations; i++) {
+		if (!empty_equation_space(i) && !espace_vars_usable(i) && !espace_changed[i])
+			break;
+	}
+	if (v && i >= n_equations) {
+		ep = var_index_entry(v);
+	}
 	i = cur_equation;
 	for (n = 0; n < n_equations; n++) {
 		if (forward_direction) {
@@ -615,10 +886,14 @@ int	forward_direction;
 			else
 				i--;
 		}
-		if (var_in_equation(i, v)) {
-			cur_equation = i;
-			return true;
+		if (ep && !espace_changed[i]) {
+			if (((ep->espaces[i / 64] >> (i % 64)) & 1) == 0 || empty_equation_space(i))
+				continue;
+		} else if (!var_in_equation(i, v)) {
+			continue;
 		}
+		cur_equation = i;
+		return true;
 	}
 	return false;
 }
@@ -665,32 +940,98 @@ token_type	*expression;	/* expression pointer */
 int		len;		/* expression length */
 long		v;		/* variable to substitute with expression */
 {
-	int	j, k;
-	int	level;
-	int	substituted = false;
+	subst_type	sub;
+
+	sub.v = v;
+	sub.expression = expression;
+	sub.len = len;
+	return subst_vars_with_exps(equation, np, &sub, 1);
+}
+
+/*
+ * Compare function for qsort(3) and bsearch(3) of subst_type by variable.
+ */
+static int
+subst_cmp(p1, p2)
+subst_type	*p1, *p2;
+{
+	if (p1->v < p2->v)
+		return -1;
+	return(p1->v > p2->v);
+}
 
-	if (v == 0 || len <= 0)
+/*
+ * Substitute every instance of each variable subs[].v in "equation"
+ * with its expression subs[].expression, all at once,
+ * so the variables in the substituted expressions are never substituted themselves.
+ * The new length is computed first, then the equation side is expanded in place from the end,
+ * so each token is moved only once, no matter how many substitutions are made.
+ * The expressions must not be in "equation".
+ * "subs" is sorted by variable here, and each variable should be in it only once.
+ *
+ * Return true if something was substituted.
+ */
+int
+subst_vars_with_exps(equation, np, subs, n_subs)
+token_type	*equation;	/* equation side pointer */
+int		*np;		/* pointer to equation side length */
+subst_type	*subs;		/* the variables to substitute and their expressions */
+int		n_subs;		/* number of entries in subs[] */
+{
+	int		i, j, k, n, level;
+	int		substituted = false;
+	subst_type	*sp, key;
+
+	if (n_subs <= 0)
+		return false;
+	if (n_subs > 1) {
+		qsort((char *) subs, n_subs, sizeof(*subs), subst_cmp);
+	}
+	for (i = 0; i < n_subs; i++) {
+		subs[i].count = 0;
+	}
+	n = *np;
+	for (j = 0; j < *np; j++) {
+		if (equation[j].kind == VARIABLE) {
+			key.v = equation[j].token.variable;
+			sp = (subst_type *) bsearch(&key, subs, n_subs, sizeof(*subs), subst_cmp);
+			if (sp && sp->v && sp->len > 0) {
+				sp->count++;
+				n += sp->len - 1;
+				substituted = true;
+			}
+		}
+	}
+	if (!substituted)
 		return false;
+	if (n > n_tokens) {
+		error_huge();
+	}
+	k = n;
 	for (j = *np - 1; j >= 0; j--) {
-		if (equation[j].kind == VARIABLE && equation[j].token.variable == v) {
+		sp = NULL;
+		if (equation[j].kind == VARIABLE) {
+			key.v = equation[j].token.variable;
+			sp = (subst_type *) bsearch(&key, subs, n_subs, sizeof(*subs), subst_cmp);
+		}
+		if (sp && sp->v && sp->len > 0) {
 			level = equation[j].level;
-			if (*np + len - 1 > n_tokens) {
-				error_huge();
-			}
-			blt(&equation[j+len], &equation[j+1], (*np - (j + 1)) * sizeof(token_type));
-			*np += len - 1;
-			blt(&equation[j], expression, len * sizeof(token_type));
-			for (k = j; k < j + len; k++)
-				equation[k].level += level;
-			substituted = true;
+			k -= sp->len;
+			blt(&equation[k], sp->expression, sp->len * sizeof(token_type));
+			for (i = k; i < k + sp->len; i++)
+				equation[i].level += level;
+		} else {
+			equation[--k] = equation[j];
 		}
 	}
-	if (substituted) {
-		if (is_integer_var(v) && !is_integer_expr(expression, len)) {
+	*np = n;
+	for (i = 0; i < n_subs; i++) {
+		if (subs[i].count && is_integer_var(subs[i].v) && !is_integer_expr(subs[i].expression, subs[i].len)) {
 			warning(_("Substituting integer variable with non-integer expression."));
+			break;
 		}
 	}
-	return substituted;
+	return true;
 }
 
 /*
@@ -984,11 +1325,16 @@ int	en;	/* equation space number the result is in */
 		return false;
 	}
 #if	LIBRARY
+	espace_written(en);
 	make_fractions_and_group(en);
 	if (factor_int_flag) {
 		factor_int_equation(en);
 	}
 	free_result_str();
+	if (no_result_str) {	/* the caller only wants the equation number, render nothing */
+		result_en = en;
+		return true;
+	}
 #if	1	/* Set this to 1 to allow display2d to decide library output mode. */
 	if (display2d) {
 		result_str = flist_equation_string(en);
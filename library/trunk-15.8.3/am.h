@@ -138,6 +138,20 @@ typedef	struct {		/* storage structure for each token in an expression */
 
 #define	DIVISOR_SIZE		min((DEFAULT_N_TOKENS / 2), 15000)	/* a nice maximum divisor size */
 
+/*
+ * The following defines the number of entries in each of the integer factorization,
+ * GCD, and fraction conversion result caches,
+ * which remember recently computed results for the whole session.
+ * Should be a prime number.
+ */
+#ifndef	INT_CACHE_SIZE
+#if	HANDHELD
+#define	INT_CACHE_SIZE		127
+#else
+#define	INT_CACHE_SIZE		1021
+#endif
+#endif
+
 /*
  * All Mathomatic variables are referenced by the value in a C long int variable.
  * The actual name string is stored separately.
@@ -154,12 +168,27 @@ typedef	struct {		/* storage structure for each token in an expression */
 #define	MAX_SUBSCRIPT	(SUBSCRIPT_MASK - 1)	/* maximum variable subscript, currently only used for "sign" variables */
 
 typedef	char	sign_array_type[MAX_SUBSCRIPT+2];	/* boolean array for generating unique "sign" variables */
+typedef	unsigned long long	sign_mask_type;		/* bit mask of the sign_array_type subscripts used in an expression */
 
 typedef struct {		/* qsort(3) data structure for sorting Mathomatic variables */
 	long	v;		/* Mathomatic variable */
 	int	count;		/* number of times the variable occurs */
 } sort_type;
 
+typedef struct {		/* a variable and the expression to substitute for it, for subst_vars_with_exps() */
+	long		v;		/* Mathomatic variable */
+	token_type	*expression;	/* expression pointer */
+	int		len;		/* expression length */
+	int		count;		/* set to the number of times the variable was substituted */
+} subst_type;
+
+typedef struct {		/* growable text string, appended to in amortized constant time */
+	char	*str;		/* the null terminated string, or NULL if nothing appended yet */
+	int	len;		/* length of the string */
+	int	size;		/* allocated size of str[] */
+	int	failed;		/* true if out of memory */
+} strbuf_type;
+
 /* A list of supported output languages for the code command: */
 enum language_list {
 	C = 1,      /* or C++ */
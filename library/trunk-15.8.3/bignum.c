@@ -0,0 +1,1216 @@
+/*
+ * Mathomatic arbitrary precision integer routines.
+ * Used to factor integers that are too large for double precision floating point,
+ * and to do exact integer arithmetic on constants when "set exact_integers" is on.
+ * Limbs are stored in doubles, so all arithmetic is exact integer arithmetic
+ * as long as intermediate results stay below 2^53.
+ * Multiplication uses coef_multiply(), which does Karatsuba for large numbers.
+ *
+ * Copyright (C) 1987-2012 George Gesslein II.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+The chief copyright holder can be contacted at gesslein@mathomatic.org, or
+George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
+
+ */
+
+#include "includes.h"
+
+#define	BIG_BASE		10000.0		/* each limb holds 4 decimal digits */
+#define	BIG_BASE_DIGITS		4
+#define	BIG_MAX_LIMBS		64		/* maximum number of limbs, must hold the product of two factored numbers */
+#define	BIG_MAX_DIGITS		((BIG_MAX_LIMBS / 2) * BIG_BASE_DIGITS)	/* maximum number of digits that can be factored */
+#define	BIG_STRING_SIZE		(BIG_MAX_LIMBS * BIG_BASE_DIGITS + 1)	/* size of a buffer holding all digits of a big integer */
+#define	MAX_BIG_FACTORS		100		/* maximum number of unique prime factors */
+#define	TRIAL_DIVISION_LIMIT	100000.0	/* trial divide by all odd numbers up to this */
+#define	RHO_MAX_WORK		2.0e8		/* maximum Pollard rho iterations times limbs squared, limits the time spent */
+#define	EXACT_LIMIT		9007199254740992.0	/* 2^53, all integers below this are exact in a double */
+#define	EXACT_MIN_SLOTS		1024		/* initial size of the exact integer hash table, must be a power of 2 */
+
+typedef struct {
+	int	n;			/* number of limbs used, 0 for zero */
+	double	limb[BIG_MAX_LIMBS];	/* base BIG_BASE digits, least significant first */
+} big_type;
+
+static int big_split(big_type *np);
+
+static big_type	big_factor[MAX_BIG_FACTORS];	/* the unique prime factors found, in ascending order */
+static int	big_count[MAX_BIG_FACTORS];	/* number of times each factor occurs */
+static int	n_big_factors;			/* number of unique factors stored in big_factor[] */
+
+/*
+ * Constants are still stored as doubles in expressions.
+ * The exact value of each large integer constant made by exact arithmetic
+ * is remembered here, keyed by the double that stands for it.
+ * That double is the correctly rounded value, unless another live integer
+ * already rounds to it, in which case it is the nearest free double.
+ * Floating point arithmetic uses the correctly rounded value, see exact_float().
+ * Entries are only forgotten by exact_collect(), when no equation space uses them.
+ */
+typedef struct {
+	double		key;		/* the absolute value as a double, 0 if the slot is unused */
+	double		rounded;	/* the correctly rounded absolute value */
+	int		live;		/* mark used by exact_collect() */
+	big_type	*bp;		/* the exact absolute value */
+} exact_type;
+
+static exact_type	*exact_table;	/* hash table of exact_slots entries, open addressing */
+static int		exact_slots;	/* allocated size of exact_table[], 0 or a power of 2 */
+static int		n_exact;	/* number of used slots in exact_table[] */
+static int		exact_collect_at = EXACT_MIN_SLOTS / 2;	/* n_exact at which to next run exact_collect() */
+
+/*
+ * Remove leading zero limbs.
+ */
+static void
+big_trim(ap)
+big_type	*ap;
+{
+	while (ap->n > 0 && ap->limb[ap->n-1] == 0.0)
+		ap->n--;
+}
+
+/*
+ * Return the remainder of the non-negative integer t divided by the positive integer d,
+ * and set *qp to the quotient.
+ * This is exact for t < 2^53 and much faster than fmod(3).
+ */
+static double
+int_divide(t, d, qp)
+double	t, d;
+double	*qp;
+{
+	double	q, r;
+
+	q = floor(t / d);
+	r = t - q * d;
+	if (r < 0.0) {
+		r += d;
+		q -= 1.0;
+	} else if (r >= d) {
+		r -= d;
+		q += 1.0;
+	}
+	*qp = q;
+	return r;
+}
+
+/*
+ * Set *ap to the non-negative integer d.
+ */
+static void
+big_from_double(ap, d)
+big_type	*ap;
+double		d;
+{
+	ap->n = 0;
+	while (d > 0.0) {
+		ap->limb[ap->n++] = int_divide(d, BIG_BASE, &d);
+	}
+}
+
+/*
+ * Set *ap to the value of the "len" decimal digits at "cp".
+ */
+static void
+big_from_string(ap, cp, len)
+big_type	*ap;
+char		*cp;
+int		len;
+{
+	int	i, j, k;
+	double	d;
+
+	ap->n = (len + BIG_BASE_DIGITS - 1) / BIG_BASE_DIGITS;
+	for (i = 0, k = len; i < ap->n; i++, k -= BIG_BASE_DIGITS) {
+		d = 0.0;
+		for (j = max(0, k - BIG_BASE_DIGITS); j < k; j++) {
+			d = d * 10.0 + (cp[j] - '0');
+		}
+		ap->limb[i] = d;
+	}
+	big_trim(ap);
+}
+
+/*
+ * Return the value of *ap as a double, which is only exact below 2^53.
+ */
+static double
+big_to_double(ap)
+big_type	*ap;
+{
+	int	i;
+	double	d = 0.0;
+
+	for (i = ap->n - 1; i >= 0; i--) {
+		d = d * BIG_BASE + ap->limb[i];
+	}
+	return d;
+}
+
+/*
+ * Return limb number i of *ap, which is 0 if out of range.
+ */
+static double
+big_limb(ap, i)
+big_type	*ap;
+int		i;
+{
+	if (i < 0 || i >= ap->n)
+		return 0.0;
+	return ap->limb[i];
+}
+
+/*
+ * Compare two big integers.
+ *
+ * Return -1, 0, or 1, if *ap is less than, equal to, or greater than *bp.
+ */
+static int
+big_cmp(ap, bp)
+big_type	*ap, *bp;
+{
+	int	i;
+
+	if (ap->n != bp->n)
+		return((ap->n < bp->n) ? -1 : 1);
+	for (i = ap->n - 1; i >= 0; i--) {
+		if (ap->limb[i] != bp->limb[i])
+			return((ap->limb[i] < bp->limb[i]) ? -1 : 1);
+	}
+	return 0;
+}
+
+/*
+ * *rp = *ap + *bp.
+ */
+static void
+big_add(rp, ap, bp)
+big_type	*rp, *ap, *bp;
+{
+	int	i, n;
+	double	t, carry = 0.0;
+
+	n = max(ap->n, bp->n);
+	for (i = 0; i < n; i++) {
+		t = big_limb(ap, i) + big_limb(bp, i) + carry;
+		if (t >= BIG_BASE) {
+			t -= BIG_BASE;
+			carry = 1.0;
+		} else {
+			carry = 0.0;
+		}
+		rp->limb[i] = t;
+	}
+	if (carry != 0.0) {
+		if (n >= BIG_MAX_LIMBS)
+			error_huge();
+		rp->limb[n++] = carry;
+	}
+	rp->n = n;
+}
+
+/*
+ * *rp = *ap - *bp, where *ap >= *bp.
+ */
+static void
+big_sub(rp, ap, bp)
+big_type	*rp, *ap, *bp;
+{
+	int	i;
+	double	t, borrow = 0.0;
+
+	for (i = 0; i < ap->n; i++) {
+		t = ap->limb[i] - big_limb(bp, i) - borrow;
+		if (t < 0.0) {
+			t += BIG_BASE;
+			borrow = 1.0;
+		} else {
+			borrow = 0.0;
+		}
+		rp->limb[i] = t;
+	}
+	rp->n = ap->n;
+	big_trim(rp);
+}
+
+/*
+ * *rp = *ap * m, where m is a small non-negative integer.
+ */
+static void
+big_mul_small(rp, ap, m)
+big_type	*rp, *ap;
+double		m;
+{
+	int	i;
+	double	t, carry = 0.0;
+
+	for (i = 0; i < ap->n; i++) {
+		t = ap->limb[i] * m + carry;
+		rp->limb[i] = int_divide(t, BIG_BASE, &carry);
+	}
+	rp->n = ap->n;
+	while (carry > 0.0) {
+		if (rp->n >= BIG_MAX_LIMBS)
+			error_huge();
+		rp->limb[rp->n++] = int_divide(carry, BIG_BASE, &carry);
+	}
+	big_trim(rp);
+}
+
+/*
+ * *qp = *ap / d, where d is a small positive integer.
+ * qp may be NULL or the same as ap.
+ *
+ * Return the remainder.
+ */
+static double
+big_divmod_small(qp, ap, d)
+big_type	*qp, *ap;
+double		d;
+{
+	int	i;
+	double	t, q, r = 0.0;
+
+	for (i = ap->n - 1; i >= 0; i--) {
+		t = r * BIG_BASE + ap->limb[i];
+		r = int_divide(t, d, &q);
+		if (qp)
+			qp->limb[i] = q;
+	}
+	if (qp) {
+		qp->n = ap->n;
+		big_trim(qp);
+	}
+	return r;
+}
+
+/*
+ * *rp = *ap * *bp.
+ */
+static void
+big_mul(rp, ap, bp)
+big_type	*rp, *ap, *bp;
+{
+	int	i, n;
+	double	a[BIG_MAX_LIMBS], b[BIG_MAX_LIMBS], r[BIG_MAX_LIMBS*2];
+	double	t, carry;
+
+	if (ap->n == 0 || bp->n == 0) {
+		rp->n = 0;
+		return;
+	}
+	if (ap->n + bp->n > BIG_MAX_LIMBS)
+		error_huge();
+	n = max(ap->n, bp->n);
+	for (i = 0; i < n; i++) {
+		a[i] = big_limb(ap, i);
+		b[i] = big_limb(bp, i);
+	}
+	coef_multiply(r, a, n, b, n);
+	r[2*n-1] = 0.0;
+	carry = 0.0;
+	for (i = 0; i < ap->n + bp->n; i++) {
+		t = r[i] + carry;
+		rp->limb[i] = int_divide(t, BIG_BASE, &carry);
+	}
+	rp->n = ap->n + bp->n;
+	big_trim(rp);
+}
+
+/*
+ * Long division: *qp = *ap / *mp and *rp = *ap % *mp.
+ * qp or rp may be NULL.
+ */
+static void
+big_divmod(qp, rp, ap, mp)
+big_type	*qp, *rp, *ap, *mp;
+{
+	int		i;
+	double		q, r, m;
+	double		qd[BIG_MAX_LIMBS];
+	big_type	rem, t;
+
+	if (mp->n == 0) {
+		error_bug("Division by zero in big_divmod().");
+	}
+	if (mp->n == 1) {
+		r = big_divmod_small(qp, ap, mp->limb[0]);
+		if (rp)
+			big_from_double(rp, r);
+		return;
+	}
+	rem.n = 0;
+	for (i = ap->n - 1; i >= 0; i--) {
+/* rem = rem * BIG_BASE + next limb: */
+		blt(&rem.limb[1], &rem.limb[0], rem.n * sizeof(double));
+		rem.limb[0] = ap->limb[i];
+		rem.n++;
+		big_trim(&rem);
+		q = 0.0;
+		if (big_cmp(&rem, mp) >= 0) {
+/* estimate the quotient digit from the leading limbs, then correct it: */
+			r = (big_limb(&rem, mp->n) * BIG_BASE + big_limb(&rem, mp->n - 1)) * BIG_BASE + big_limb(&rem, mp->n - 2);
+			m = mp->limb[mp->n-1] * BIG_BASE + mp->limb[mp->n-2];
+			q = floor(r / m);
+			if (q > BIG_BASE - 1.0)
+				q = BIG_BASE - 1.0;
+			big_mul_small(&t, mp, q);
+			while (big_cmp(&t, &rem) > 0) {
+				q -= 1.0;
+				big_sub(&t, &t, mp);
+			}
+			big_sub(&rem, &rem, &t);
+			while (big_cmp(&rem, mp) >= 0) {
+				q += 1.0;
+				big_sub(&rem, &rem, mp);
+			}
+		}
+		qd[i] = q;
+	}
+	if (qp) {
+		qp->n = ap->n;
+		for (i = 0; i < ap->n; i++)
+			qp->limb[i] = qd[i];
+		big_trim(qp);
+	}
+	if (rp)
+		*rp = rem;
+}
+
+/*
+ * *rp = (*ap * *bp) % *mp.
+ */
+static void
+big_mulmod(rp, ap, bp, mp)
+big_type	*rp, *ap, *bp, *mp;
+{
+	big_type	t;
+
+	big_mul(&t, ap, bp);
+	big_divmod(NULL, rp, &t, mp);
+}
+
+/*
+ * Greatest Common Divisor: *rp = gcd(*ap, *bp).
+ */
+static void
+big_gcd(rp, ap, bp)
+big_type	*rp, *ap, *bp;
+{
+	big_type	a, b, t;
+
+	a = *ap;
+	b = *bp;
+	while (b.n > 0) {
+		big_divmod(NULL, &t, &a, &b);
+		a = b;
+		b = t;
+	}
+	*rp = a;
+}
+
+/*
+ * Miller-Rabin strong probable prime test of odd *np, which must be larger than 100.
+ * The chance of a composite passing all bases is negligible.
+ *
+ * Return true if *np is prime.
+ */
+static int
+big_is_prime(np)
+big_type	*np;
+{
+	static double	bases[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71 };
+	int		i, j, s;
+	big_type	n_minus_1, d, e, x, b, one;
+
+	big_from_double(&one, 1.0);
+	big_sub(&n_minus_1, np, &one);
+	d = n_minus_1;
+	for (s = 0; big_divmod_small(NULL, &d, 2.0) == 0.0; s++) {
+		big_divmod_small(&d, &d, 2.0);
+	}
+	for (i = 0; i < ARR_CNT(bases); i++) {
+/* x = bases[i] ^ d mod n: */
+		big_from_double(&b, bases[i]);
+		x = one;
+		e = d;
+		while (e.n > 0) {
+			if (big_divmod_small(&e, &e, 2.0) != 0.0) {
+				big_mulmod(&x, &x, &b, np);
+			}
+			if (e.n > 0)
+				big_mulmod(&b, &b, &b, np);
+		}
+		if (big_cmp(&x, &one) == 0 || big_cmp(&x, &n_minus_1) == 0)
+			continue;
+		for (j = 1; j < s; j++) {
+			big_mulmod(&x, &x, &x, np);
+			if (big_cmp(&x, &n_minus_1) == 0)
+				break;
+		}
+		if (j >= s)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Pollard's rho function: *yp = (*yp * *yp + c) % *np.
+ */
+static void
+rho_step(yp, c, np)
+big_type	*yp;
+double		c;
+big_type	*np;
+{
+	big_type	t;
+
+	big_mulmod(yp, yp, yp, np);
+	big_from_double(&t, c);
+	big_add(yp, yp, &t);
+	if (big_cmp(yp, np) >= 0)
+		big_sub(yp, yp, np);
+}
+
+/*
+ * *rp = |*ap - *bp|.
+ */
+static void
+big_abs_diff(rp, ap, bp)
+big_type	*rp, *ap, *bp;
+{
+	if (big_cmp(ap, bp) >= 0)
+		big_sub(rp, ap, bp);
+	else
+		big_sub(rp, bp, ap);
+}
+
+/*
+ * Find a non-trivial factor of the odd composite *np using Brent's variant of Pollard's rho method.
+ *
+ * Return true with the factor in *dp if successful.
+ */
+static int
+pollard_rho(np, dp)
+big_type	*np, *dp;
+{
+	double		c, steps, max_steps;
+	long		i, k, r;
+	big_type	x, y, ys, q, t, one;
+
+	big_from_double(&one, 1.0);
+	steps = 0.0;
+	max_steps = RHO_MAX_WORK / ((double) np->n * np->n);
+	for (c = 1.0; c <= 5.0 && steps < max_steps; c += 1.0) {
+		big_from_double(&y, 2.0);
+		x = ys = y;
+		q = one;
+		*dp = one;
+		for (r = 1; big_cmp(dp, &one) == 0 && steps < max_steps; r *= 2) {
+			if (abort_flag) {
+				/* Control-C pressed, give up on this factor */
+				abort_flag = false;
+				return false;
+			}
+			x = y;
+			for (i = 0; i < r; i++)
+				rho_step(&y, c, np);
+			steps += r;
+			for (k = 0; k < r && big_cmp(dp, &one) == 0 && steps < max_steps; k += 100) {
+				ys = y;
+				for (i = 0; i < 100 && i < r - k; i++) {
+					rho_step(&y, c, np);
+					big_abs_diff(&t, &x, &y);
+					big_mulmod(&q, &q, &t, np);
+				}
+				steps += i;
+				big_gcd(dp, &q, np);
+			}
+		}
+		if (big_cmp(dp, np) == 0) {
+/* the product became a multiple of n, so backtrack one step at a time: */
+			do {
+				rho_step(&ys, c, np);
+				big_abs_diff(&t, &x, &ys);
+				big_gcd(dp, &t, np);
+			} while (big_cmp(dp, &one) == 0);
+		}
+		if (big_cmp(dp, &one) != 0 && big_cmp(dp, np) != 0)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Add "count" occurrences of the prime *pp to big_factor[], keeping it sorted.
+ */
+static void
+add_big_factor(pp, count)
+big_type	*pp;
+int		count;
+{
+	int	i, j, cmp;
+
+	for (i = 0; i < n_big_factors; i++) {
+		cmp = big_cmp(pp, &big_factor[i]);
+		if (cmp == 0) {
+			big_count[i] += count;
+			return;
+		}
+		if (cmp < 0)
+			break;
+	}
+	if (n_big_factors >= MAX_BIG_FACTORS) {
+		error_bug("Too many factors in add_big_factor().");
+	}
+	for (j = n_big_factors; j > i; j--) {
+		big_factor[j] = big_factor[j-1];
+		big_count[j] = big_count[j-1];
+	}
+	big_factor[i] = *pp;
+	big_count[i] = count;
+	n_big_factors++;
+}
+
+/*
+ * Completely factor *np, which is larger than 1 and has no small factors.
+ *
+ * Return false if a composite factor could not be split,
+ * in which case it is stored as if it were prime.
+ */
+static int
+big_split(np)
+big_type	*np;
+{
+	int		i, rv;
+	double		d;
+	big_type	t, q;
+
+	d = big_to_double(np);
+	if (d < MAX_K_INTEGER) {
+		if (!factor_one(d)) {
+			error_bug("Internal error factoring integers.");
+		}
+		for (i = 0; i < uno; i++) {
+			if (unique[i] > 1.0) {
+				big_from_double(&t, unique[i]);
+				add_big_factor(&t, ucnt[i]);
+			}
+		}
+		return true;
+	}
+	if (big_is_prime(np)) {
+		add_big_factor(np, 1);
+		return true;
+	}
+	if (!pollard_rho(np, &t)) {
+		add_big_factor(np, 1);
+		return false;
+	}
+	big_divmod(&q, NULL, np, &t);
+	rv = big_split(&t);
+	rv = big_split(&q) && rv;
+	return rv;
+}
+
+/*
+ * Store the decimal digits of a big integer in "buf",
+ * which must hold at least BIG_STRING_SIZE characters.
+ */
+static void
+big_string(ap, buf)
+big_type	*ap;
+char		*buf;
+{
+	int	i;
+
+	if (ap->n == 0) {
+		strcpy(buf, "0");
+		return;
+	}
+	buf += sprintf(buf, "%.0f", ap->limb[ap->n-1]);
+	for (i = ap->n - 2; i >= 0; i--) {
+		buf += sprintf(buf, "%0*.0f", BIG_BASE_DIGITS, ap->limb[i]);
+	}
+}
+
+/*
+ * Display a big integer.
+ */
+static void
+big_display(ap)
+big_type	*ap;
+{
+	char	buf[BIG_STRING_SIZE];
+
+	big_string(ap, buf);
+	fprintf(gfp, "%s", buf);
+}
+
+/*
+ * Factor the decimal integer of "len" characters at "cp",
+ * which may have too many digits for factor_one(),
+ * and display the prime factors the same way as display_unique().
+ *
+ * Return true if successful.
+ */
+int
+factor_big_number(cp, len)
+char	*cp;	/* optional sign followed by decimal digits */
+int	len;	/* number of characters at cp */
+{
+	int		i, j, k;
+	int		negative = false, count;
+	double		d;
+	big_type	n, q, t;
+
+	if (len > 0 && (*cp == '-' || *cp == '+')) {
+		negative = (*cp == '-');
+		cp++;
+		len--;
+	}
+	for (; len > 1 && *cp == '0'; cp++, len--)
+		;
+	if (len <= 0) {
+		error(_("Integer expected."));
+		return false;
+	}
+	for (i = 0; i < len; i++) {
+		if (!isdigit(cp[i])) {
+			error(_("Integer expected."));
+			return false;
+		}
+	}
+	if (len > BIG_MAX_DIGITS) {
+		error(_("Number too large to factor."));
+		return false;
+	}
+	big_from_string(&n, cp, len);
+	if (n.n == 0) {
+		error(_("Number too large to factor or not a non-zero integer."));
+		return false;
+	}
+	fprintf(gfp, "%s", negative ? "-" : "");
+	big_display(&n);
+	fprintf(gfp, " = ");
+	n_big_factors = 0;
+/* trial division by small numbers: */
+	for (d = 2.0; d <= TRIAL_DIVISION_LIMIT && (n.n > 4 || big_to_double(&n) >= MAX_K_INTEGER); d += ((d == 2.0) ? 1.0 : 2.0)) {
+		for (count = 0; big_divmod_small(&q, &n, d) == 0.0; count++) {
+			n = q;
+		}
+		if (count) {
+			big_from_double(&t, d);
+			add_big_factor(&t, count);
+		}
+	}
+	i = true;
+	if (n.n > 1 || big_to_double(&n) > 1.0) {
+		i = big_split(&n);
+	}
+/* make sure the factors multiply back to the original value: */
+	big_from_double(&q, 1.0);
+	for (j = 0; j < n_big_factors; j++) {
+		for (k = 0; k < big_count[j]; k++) {
+			big_mul(&t, &q, &big_factor[j]);
+			q = t;
+		}
+	}
+	big_from_string(&n, cp, len);
+	if (big_cmp(&q, &n) != 0) {
+		error_bug("Internal error factoring integers.");
+	}
+	for (j = 0; j < n_big_factors; j++) {
+		if (j)
+			fprintf(gfp, " * ");
+		big_display(&big_factor[j]);
+		if (big_count[j] > 1) {
+			fprintf(gfp, "^%d", big_count[j]);
+		}
+	}
+	if (negative) {
+		fprintf(gfp, " * -1");
+	}
+	fprintf(gfp, "\n");
+	if (!i) {
+		warning(_("Unable to completely factor; one of the factors shown is composite."));
+	} else if (!negative && n_big_factors == 1 && big_count[0] == 1) {
+		debug_string(0, _("Prime number!"));
+	}
+	return true;
+}
+
+/*
+ * Forget all remembered exact integers.
+ * Only call this when no expression uses them anymore.
+ */
+void
+clear_exact(void)
+{
+	int	i;
+
+	for (i = 0; i < exact_slots; i++) {
+		if (exact_table[i].key != 0.0) {
+			free(exact_table[i].bp);
+			exact_table[i].key = 0.0;
+		}
+	}
+	n_exact = 0;
+	exact_collect_at = EXACT_MIN_SLOTS / 2;
+}
+
+/*
+ * Return the exact_table[] slot for key d,
+ * which is either the slot holding d or the unused slot where it belongs.
+ * exact_table[] must be allocated.
+ */
+static exact_type *
+exact_slot(d)
+double	d;
+{
+	unsigned long long	h;
+	int			i;
+
+	memcpy(&h, &d, sizeof(h));
+	h *= 0x9e3779b97f4a7c15ULL;
+	for (i = (int) (h >> 40) & (exact_slots - 1);; i = (i + 1) & (exact_slots - 1)) {
+		if (exact_table[i].key == d || exact_table[i].key == 0.0)
+			return &exact_table[i];
+	}
+}
+
+/*
+ * Return the exact_table[] entry for the absolute value of the constant d, or NULL if there is none.
+ */
+static exact_type *
+exact_lookup(d)
+double	d;
+{
+	exact_type	*ep;
+
+	d = fabs(d);
+	if (exact_slots == 0 || d < EXACT_LIMIT)
+		return NULL;
+	ep = exact_slot(d);
+	if (ep->key == 0.0)
+		return NULL;
+	return ep;
+}
+
+/*
+ * Allocate a new exact_table[] of "size" slots and move all entries into it.
+ * Aborts the current operation if out of memory.
+ */
+static void
+exact_resize(size)
+int	size;
+{
+	int		i, old_slots;
+	exact_type	*old_table;
+
+	old_table = exact_table;
+	old_slots = exact_slots;
+	if ((exact_table = (exact_type *) calloc(size, sizeof(exact_type))) == NULL) {
+		exact_table = old_table;
+		error(_("Out of memory (can't malloc(3))."));
+		longjmp(jmp_save, 2);
+	}
+	exact_slots = size;
+	for (i = 0; i < old_slots; i++) {
+		if (old_table[i].key != 0.0) {
+			*exact_slot(old_table[i].key) = old_table[i];
+		}
+	}
+	free(old_table);
+}
+
+/*
+ * Set the live mark of exactly the exact_table[] entries used by the equation spaces.
+ */
+static void
+exact_mark_live(void)
+{
+	int		i, j, n, en;
+	token_type	*p1;
+	exact_type	*ep;
+
+	for (i = 0; i < exact_slots; i++)
+		exact_table[i].live = false;
+	for (en = 0; en < n_equations; en++) {
+		for (j = 0; j < 2; j++) {
+			p1 = j ? rhs[en] : lhs[en];
+			n = j ? n_rhs[en] : n_lhs[en];
+			for (i = 0; i < n; i += 2) {
+				if (p1[i].kind == CONSTANT && (ep = exact_lookup(p1[i].token.constant)) != NULL)
+					ep->live = true;
+			}
+		}
+	}
+}
+
+/*
+ * Forget the exact integers that are no longer used by any equation space.
+ * Must only be called between commands, when nothing else holds constants.
+ */
+void
+exact_collect(void)
+{
+	int	i;
+
+	if (n_exact < exact_collect_at)
+		return;
+	exact_mark_live();
+	for (i = 0; i < exact_slots; i++) {
+		if (exact_table[i].key != 0.0 && !exact_table[i].live) {
+			free(exact_table[i].bp);
+			exact_table[i].key = 0.0;
+			n_exact--;
+		}
+	}
+	exact_resize(exact_slots);	/* rehash, because open addressing can't simply delete */
+	clear_solve_memo();		/* it may hold constants that were forgotten */
+	exact_collect_at = max(EXACT_MIN_SLOTS / 2, n_exact * 2);
+}
+
+/*
+ * Return the correctly rounded value of the constant d, for floating point arithmetic,
+ * which differs from d when d stands for an exact integer that had to be given a different double.
+ */
+double
+exact_float(d)
+double	d;
+{
+	exact_type	*ep;
+
+	if ((ep = exact_lookup(d)) == NULL)
+		return d;
+	return((d < 0.0) ? -ep->rounded : ep->rounded);
+}
+
+/*
+ * Set *ap to the exact absolute value of the integer constant d.
+ *
+ * Return true if the exact value is known.
+ */
+static int
+exact_get(ap, d)
+big_type	*ap;
+double		d;
+{
+	exact_type	*ep;
+
+	d = fabs(d);
+	if (!isfinite(d) || floor(d) != d)
+		return false;
+	if (d < EXACT_LIMIT) {
+		big_from_double(ap, d);
+		return true;
+	}
+	if ((ep = exact_lookup(d)) == NULL)
+		return false;
+	*ap = *ep->bp;
+	return true;
+}
+
+/*
+ * Remember the exact value of the non-negative integer *ap,
+ * which correctly rounds to the double d.
+ * Aborts the current operation if out of memory.
+ *
+ * Return the double that stands for *ap from now on.
+ */
+static double
+exact_remember(ap, d)
+big_type	*ap;
+double		d;
+{
+	double		key, up, down;
+	exact_type	*ep;
+
+	if (d < EXACT_LIMIT)
+		return d;
+	if ((n_exact + 1) * 2 > exact_slots) {
+		exact_resize(exact_slots ? (exact_slots * 2) : EXACT_MIN_SLOTS);
+	}
+/* Look for *ap, or the nearest free key, alternately above and below d. */
+	for (up = down = d;;) {
+		ep = exact_slot(key = up);
+		if (ep->key == 0.0 || big_cmp(ep->bp, ap) == 0)
+			break;
+		down = nextafter(down, 0.0);
+		if (down >= EXACT_LIMIT) {
+			ep = exact_slot(key = down);
+			if (ep->key == 0.0 || big_cmp(ep->bp, ap) == 0)
+				break;
+		}
+		up = nextafter(up, HUGE_VAL);
+	}
+	if (ep->key != 0.0)
+		return key;
+	if ((ep->bp = (big_type *) malloc(sizeof(big_type))) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		longjmp(jmp_save, 2);
+	}
+	*ep->bp = *ap;
+	ep->key = key;
+	ep->rounded = d;
+	n_exact++;
+	return ep->key;
+}
+
+/*
+ * Return the double that stands for the integer *ap, negated if "negative" is true.
+ */
+static double
+exact_put(ap, negative)
+big_type	*ap;
+int		negative;
+{
+	char	buf[BIG_STRING_SIZE];
+	double	d;
+
+	big_string(ap, buf);
+	d = exact_remember(ap, strtod(buf, NULL));	/* rounds the same as the parser */
+	return(negative ? -d : d);
+}
+
+/*
+ * Remember the exact value of the "len" decimal digits at "cp",
+ * which the parser converted to the double d.
+ * Called for integer constants with more digits than a double holds.
+ *
+ * Return the double to store in the expression.
+ */
+double
+exact_constant(cp, len, d)
+char	*cp;
+int	len;
+double	d;
+{
+	big_type	n;
+
+	if (!exact_integers || len > BIG_MAX_LIMBS * BIG_BASE_DIGITS || d < EXACT_LIMIT)
+		return d;
+	big_from_string(&n, cp, len);
+	return exact_remember(&n, d);
+}
+
+/*
+ * Store the exact decimal digits of the integer constant d in "buf",
+ * if it is too large to be exact as a double and its exact value is known.
+ *
+ * Return true if done.
+ */
+int
+exact_string(d, buf, size)
+double	d;
+char	*buf;
+int	size;
+{
+	big_type	n;
+
+	if (!exact_integers || fabs(d) < EXACT_LIMIT || !exact_get(&n, d))
+		return false;
+	if (n.n * BIG_BASE_DIGITS + 2 > size)
+		return false;
+	if (d < 0.0)
+		*buf++ = '-';
+	big_string(&n, buf);
+	return true;
+}
+
+/*
+ * Append the key of every exact integer used by the equation spaces to "keys",
+ * and its null terminated decimal digits to "digits", for save_binary().
+ *
+ * Return the number of exact integers appended.
+ */
+int
+exact_save(keys, digits)
+strbuf_type	*keys, *digits;
+{
+	int	i, count = 0;
+	char	buf[BIG_STRING_SIZE];
+
+	exact_mark_live();
+	for (i = 0; i < exact_slots; i++) {
+		if (exact_table[i].key != 0.0 && exact_table[i].live) {
+			big_string(exact_table[i].bp, buf);
+			strbuf_appendn(keys, (char *) &exact_table[i].key, sizeof(double));
+			strbuf_appendn(digits, buf, strlen(buf) + 1);
+			count++;
+		}
+	}
+	return count;
+}
+
+/*
+ * Return true if "key" and the null terminated string "digits" from a binary file
+ * can be given to exact_restore().
+ */
+int
+exact_restore_ok(key, digits)
+double	key;
+char	*digits;
+{
+	int	len;
+
+	len = strlen(digits);
+	return(isfinite(key) && key >= EXACT_LIMIT && len > 0 && len <= BIG_MAX_LIMBS * BIG_BASE_DIGITS
+	    && strspn(digits, "0123456789") == len);
+}
+
+/*
+ * Remember that "key" stands for the integer with decimal "digits", for read_binary().
+ * exact_restore_ok() must be true, and "key" must not already be in use.
+ * Aborts the current operation if out of memory.
+ */
+void
+exact_restore(key, digits)
+double	key;
+char	*digits;
+{
+	big_type	n;
+	exact_type	*ep;
+
+	big_from_string(&n, digits, strlen(digits));
+	if ((n_exact + 1) * 2 > exact_slots) {
+		exact_resize(exact_slots ? (exact_slots * 2) : EXACT_MIN_SLOTS);
+	}
+	ep = exact_slot(key);
+	if (ep->key != 0.0)
+		return;
+	if ((ep->bp = (big_type *) malloc(sizeof(big_type))) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		longjmp(jmp_save, 2);
+	}
+	*ep->bp = n;
+	ep->key = key;
+	ep->rounded = strtod(digits, NULL);
+	n_exact++;
+}
+
+/*
+ * Do the exact integer arithmetic k1 op k2 for calc(),
+ * when an operand or the result is too large to be exact as a double
+ * and the exact values of both operands are known.
+ * op is PLUS, MINUS, TIMES, DIVIDE, IDIVIDE, or POWER.
+ *
+ * Return 1 with the result in *dp if done,
+ * 0 if floating point arithmetic should be used instead,
+ * or -1 if the result is a fraction, which should be left alone to remain exact.
+ */
+int
+exact_calc(op, k1, k2, dp)
+int	op;
+double	k1, k2;
+double	*dp;
+{
+	int		negative;
+	double		a1, a2, e;
+	big_type	a, b, r, x, t;
+
+	if (!exact_integers)
+		return 0;
+	a1 = fabs(k1);
+	a2 = fabs(k2);
+	switch (op) {
+	case PLUS:
+	case MINUS:
+		if (a1 < EXACT_LIMIT && a2 < EXACT_LIMIT && a1 + a2 < EXACT_LIMIT)
+			return 0;
+		break;
+	case TIMES:
+		if (a1 < EXACT_LIMIT && a2 < EXACT_LIMIT && a1 * a2 < EXACT_LIMIT)
+			return 0;
+		break;
+	case DIVIDE:
+	case IDIVIDE:
+		if ((a1 < EXACT_LIMIT && a2 < EXACT_LIMIT) || k2 == 0.0)
+			return 0;
+		break;
+	case POWER:
+		if (k2 < 0.0 || a1 < 2.0 || (a1 < EXACT_LIMIT && pow(a1, k2) < EXACT_LIMIT))
+			return 0;
+		break;
+	default:
+		return 0;
+	}
+	if (!exact_get(&a, k1) || !exact_get(&b, k2))
+		return 0;
+	switch (op) {
+	case MINUS:
+		k2 = -k2;
+	case PLUS:
+		if ((k1 < 0.0) == (k2 < 0.0)) {
+			if (max(a.n, b.n) >= BIG_MAX_LIMBS)
+				return 0;
+			big_add(&r, &a, &b);
+			negative = (k1 < 0.0);
+		} else if (big_cmp(&a, &b) >= 0) {
+			big_sub(&r, &a, &b);
+			negative = (k1 < 0.0);
+		} else {
+			big_sub(&r, &b, &a);
+			negative = (k2 < 0.0);
+		}
+		break;
+	case TIMES:
+		if (a.n + b.n > BIG_MAX_LIMBS)
+			return 0;
+		big_mul(&r, &a, &b);
+		negative = ((k1 < 0.0) != (k2 < 0.0));
+		break;
+	case DIVIDE:
+		big_divmod(&r, &t, &a, &b);
+		if (t.n != 0)
+			return -1;
+		negative = ((k1 < 0.0) != (k2 < 0.0));
+		break;
+	case IDIVIDE:
+		big_divmod(&r, NULL, &a, &b);
+		negative = ((k1 < 0.0) != (k2 < 0.0));
+		break;
+	case POWER:
+/* binary exponentiation, giving up if the result gets too large: */
+		big_from_double(&r, 1.0);
+		x = a;
+		for (e = k2; e > 0.0;) {
+			if (fmod(e, 2.0) != 0.0) {
+				if (r.n + x.n > BIG_MAX_LIMBS)
+					return 0;
+				big_mul(&t, &r, &x);
+				r = t;
+			}
+			e = floor(e / 2.0);
+			if (e > 0.0) {
+				if (x.n * 2 > BIG_MAX_LIMBS)
+					return 0;
+				big_mul(&t, &x, &x);
+				x = t;
+			}
+		}
+		negative = (k1 < 0.0 && fmod(k2, 2.0) != 0.0);
+		break;
+	default:
+		return 0;
+	}
+	if (r.n == 0)
+		negative = false;
+	*dp = exact_put(&r, negative);
+	return 1;
+}
@@ -35,6 +35,13 @@ enum spf_function {
 static int sum_product(char *cp, enum spf_function current_function);
 static int complex_func(char *cp, int imag_flag);
 static int elim_sub(int i, long v);
+static int elim_collect(long *va);
+static int elim_pick(long *va, int vc, char *used, int order);
+
+/* Elimination orders for "eliminate all". */
+#define	ELIM_NUMBER	0	/* highest variable number first, the original order */
+#define	ELIM_FEWEST	1	/* fewest occurrences first */
+#define	ELIM_DEGREE	2	/* minimum degree first */
 
 /* Global variables for the optimize command. */
 static int	opt_en[N_EQUATIONS+1];
@@ -288,6 +295,10 @@ version_report(void)
 	} else {
 		fprintf(gfp, _("making the maximum memory usage approximately %ld kilobytes.\n"), l);
 	}
+	fprintf(gfp, _("Integer factorization cache: %ld hits out of %ld lookups.\n"), factor_cache_hits, factor_cache_lookups);
+	fprintf(gfp, _("GCD cache: %ld hits out of %ld lookups.\n"), gcd_cache_hits, gcd_cache_lookups);
+	fprintf(gfp, _("Fraction conversion cache: %ld hits out of %ld lookups.\n"), fraction_cache_hits, fraction_cache_lookups);
+	fprintf(gfp, _("Polynomial index: %ld hits out of %ld lookups.\n"), poly_index_hits, poly_index_lookups);
 #if	SECURE
 	fprintf(gfp, _("Compiled for maximum security.\n"));
 #else
@@ -329,6 +340,9 @@ char	*cp;
 	token_type	want;
 	int		rv = 0;
 
+	if (strcmp_tospace(cp, "linear") == 0) {
+		return solve_linear(skip_param(cp));
+	}
 	cp_start = cp;
 	if (strcmp_tospace(cp, "verify") == 0) {
 		verify_flag = true;
@@ -662,6 +676,29 @@ enum spf_function	current_function;
 	}
 }
 
+/*
+ * Create the next unused "temp" variable, for holding a repeated subexpression.
+ * Used by the optimize command and "derivative optimize".
+ *
+ * Return true with the variable in "*vp" if successful.
+ */
+int
+new_temp_var(vp)
+long	*vp;
+{
+	char	var_name_buf[MAX_VAR_LEN];
+
+	snprintf(var_name_buf, sizeof(var_name_buf), "temp%.0d", last_temp_var);
+	if (parse_var(vp, var_name_buf) == NULL) {
+		return false;
+	}
+	last_temp_var++;
+	if (last_temp_var < 0) {
+		last_temp_var = 0;
+	}
+	return true;
+}
+
 /*
  * This function is for the "optimize" command.
  * It finds and substitutes all occurrences of the RHS of "en" in "equation".
@@ -733,7 +770,6 @@ int		*np;
 	int	diff_sign;
 	int	found_se, found_se1;	/* found sub-expression flags */
 	long	v;			/* Mathomatic variable */
-	char	var_name_buf[MAX_VAR_LEN];
 
 	if (*np <= 0) {
 		return false;
@@ -764,14 +800,9 @@ int		*np;
 					k1 = i1 - 1;
 					if ((jj1 - k1) >= OPT_MIN_SIZE
 					    && se_compare(&equation[k], j - k, &equation[k1], jj1 - k1, &diff_sign)) {
-						snprintf(var_name_buf, sizeof(var_name_buf), "temp%.0d", last_temp_var);
-						if (parse_var(&v, var_name_buf) == NULL) {
+						if (!new_temp_var(&v)) {
 							return false;	/* can't create "temp" variable */
 						}
-						last_temp_var++;
-						if (last_temp_var < 0) {
-							last_temp_var = 0;
-						}
 						i2 = next_espace();
 						lhs[i2][0].level = 1;
 						lhs[i2][0].kind = VARIABLE;
@@ -1127,10 +1158,17 @@ FILE	*ofp;	/* output file pointer */
 	}
 	fprintf(ofp, "rationalize_denominators\n");
 
+	if (!exact_integers) {
+		fprintf(ofp, "no ");
+	}
+	fprintf(ofp, "exact_integers\n");
+
 	fprintf(ofp, "modulus_mode = %d\n", modulus_mode);
 
 	fprintf(ofp, "finance = %d\n", finance_option);
 
+	fprintf(ofp, "solve_steps = %d\n", max_solve_steps);
+
 	if (!factor_int_flag) {
 		fprintf(ofp, "no ");
 	}
@@ -1252,6 +1290,7 @@ try_next_param:
 	negate = skip_no(&cp);
 	option_string = cp;
 	cp = skip_param(cp);
+	clear_solve_memo();	/* any option might change what can be solved */
 #if	!SILENT
 	if (strncasecmp(option_string, "debug", 5) == 0) {
 		if (negate) {
@@ -1430,6 +1469,10 @@ try_next_param:
 		rationalize_denominators = !negate;
 		goto try_next_param;
 	}
+	if (strncasecmp(option_string, "exact_integers", 5) == 0) {
+		exact_integers = !negate;
+		goto try_next_param;
+	}
 	if (strncasecmp(option_string, "modulus_mode", 3) == 0) {
 		if (negate) {
 			modulus_mode = 0;
@@ -1483,6 +1526,21 @@ try_next_param:
 		}
 		goto check_return;
 	}
+	if (strncasecmp(option_string, "solve_steps", 5) == 0) {
+		if (negate) {
+			max_solve_steps = 0;
+		} else {
+			i = decstrtol(cp, &cp1);
+			if (i < 0 || cp1 == NULL || cp == cp1) {
+				error(_("Please specify the maximum number of solve steps; 0 = no limit."));
+				printf(_("Current value is %d.\n"), max_solve_steps);
+				return false;
+			}
+			cp = cp1;
+			max_solve_steps = i;
+		}
+		goto check_return;
+	}
 	if (strncasecmp(option_string, "factor_integers", 6) == 0) {
 		factor_int_flag = !negate;
 		goto try_next_param;
@@ -1883,6 +1941,8 @@ char	*cp;
 	int		diff_sign;
 	char		buf[MAX_CMD_LEN];
 	int		factor_flag = false, value_entered;
+	subst_type	subs[MAX_VARS];		/* the entered values, substituted all at once */
+	int		n_subs;
 
 	for (;; cp = skip_param(cp)) {
 		if (strcmp_tospace(cp, "factor") == 0 || strcmp_tospace(cp, "factorize") == 0) {
@@ -1935,6 +1995,8 @@ calc_again:
 		}
 		n_trhs = n;
 		blt(trhs, source, n_trhs * sizeof(token_type));
+		n_subs = 0;
+		n_tes = 0;
 		last_v = 0;
 		for (;;) {
 			v = -1;
@@ -1957,17 +2019,23 @@ calc_again:
 				continue;
 			}
 			value_entered = true;
-			/* Disguise all variables in the entered expression by making them negative. */
-			/* That way they won't be improperly substituted in the future. */
-			for (k1 = 0; k1 < n_tlhs; k1 += 2)
-				if (tlhs[k1].kind == VARIABLE)
-					tlhs[k1].token.variable = -tlhs[k1].token.variable;
-			subst_var_with_exp(trhs, &n_trhs, tlhs, n_tlhs, v);
-		}
-		/* Restore disguised variables: */
-		for (k1 = 0; k1 < n_trhs; k1 += 2)
-			if (trhs[k1].kind == VARIABLE && trhs[k1].token.variable < 0)
-				trhs[k1].token.variable = -trhs[k1].token.variable;
+			/* Save the entered expression in tes[], to be substituted with all the others. */
+			if (n_subs >= ARR_CNT(subs)) {
+				error(_("Too many variables."));
+				return false;
+			}
+			if (n_tes + n_tlhs > n_tokens) {
+				error_huge();
+			}
+			blt(&tes[n_tes], tlhs, n_tlhs * sizeof(token_type));
+			subs[n_subs].v = v;
+			subs[n_subs].expression = &tes[n_tes];
+			subs[n_subs].len = n_tlhs;
+			n_subs++;
+			n_tes += n_tlhs;
+		}
+		/* Substituting all at once won't substitute the variables in the entered expressions. */
+		subst_vars_with_exps(trhs, &n_trhs, subs, n_subs);
 		if (it_v) {
 			/* Handle the iteration option, where the simplified result is repeatedly plugged into variable it_v. */
 			list_var(it_v, 0);
@@ -2594,10 +2662,16 @@ int
 eliminate_cmd(cp)
 char	*cp;
 {
-	long	v, last_v, v1, va[MAX_VARS];		/* Mathomatic variables */
+	long	v, va[MAX_VARS];			/* Mathomatic variables */
 	int	vc = 0;					/* variable count */
-	int	i = 0, n;
+	int	i = 0, k, n;
 	int	success_flag = false, did_something = false, using_flag;
+	int	order = ELIM_NUMBER;
+#if	!SILENT
+	int	all_flag = false;
+#endif
+	int	n_done = 0, peak = 0;
+	long	done[MAX_VARS];				/* the variables eliminated, in order */
 	char	used[N_EQUATIONS];
 	char	*cp_start;
 	char	buf[MAX_CMD_LEN];
@@ -2616,40 +2690,35 @@ char	*cp;
 	cp_start = cp;
 next_var:
 	if (vc) {
-		v = va[--vc];
+		if (order == ELIM_NUMBER) {
+			v = va[--vc];
+		} else {
+/* Pick the cheapest variable to eliminate next, with the current sizes of all equations. */
+			if ((k = elim_pick(va, vc, used, order)) < 0) {
+				vc = 0;
+				goto next_var;
+			}
+			v = va[k];
+			vc--;
+			blt(&va[k], &va[k+1], (vc - k) * sizeof(*va));
+		}
 	} else if (*cp) {
 		if (is_all(cp)) {
 			cp = skip_param(cp);
-			vc = 0;
-			last_v = 0;
-			for (;;) {
-				v1 = -1;
-				for (i = 0; i < n_lhs[cur_equation]; i += 2) {
-					if (lhs[cur_equation][i].kind == VARIABLE
-					    && lhs[cur_equation][i].token.variable > last_v) {
-						if (v1 == -1 || lhs[cur_equation][i].token.variable < v1) {
-							v1 = lhs[cur_equation][i].token.variable;
-						}
-					}
-				}
-				for (i = 0; i < n_rhs[cur_equation]; i += 2) {
-					if (rhs[cur_equation][i].kind == VARIABLE
-					    && rhs[cur_equation][i].token.variable > last_v) {
-						if (v1 == -1 || rhs[cur_equation][i].token.variable < v1) {
-							v1 = rhs[cur_equation][i].token.variable;
-						}
-					}
-				}
-				if (v1 == -1)
-					break;
-				last_v = v1;
-				if ((v1 & VAR_MASK) > SIGN) {
-					if (vc >= ARR_CNT(va)) {
-						break;
-					}
-					va[vc++] = v1;
-				}
+#if	!SILENT
+			all_flag = true;
+#endif
+			if (strcmp_tospace(cp, "fewest") == 0) {
+				order = ELIM_FEWEST;
+				cp = skip_param(cp);
+			} else if (strcmp_tospace(cp, "degree") == 0) {
+				order = ELIM_DEGREE;
+				cp = skip_param(cp);
+			} else if (strcmp_tospace(cp, "number") == 0) {
+				order = ELIM_NUMBER;
+				cp = skip_param(cp);
 			}
+			vc = elim_collect(va);
 			goto next_var;
 		}
 		cp = parse_var2(&v, cp);
@@ -2670,6 +2739,16 @@ next_var:
 			if (n_rhs[cur_equation] > 0) {
 				simpa_side(rhs[cur_equation], &n_rhs[cur_equation], false, false);
 			}
+#endif
+#if	!SILENT
+			if (all_flag && debug_level >= 0) {
+				fprintf(gfp, _("Elimination order:"));
+				for (k = 0; k < n_done; k++) {
+					list_var(done[k], 0);
+					fprintf(gfp, " %s", var_str);
+				}
+				fprintf(gfp, _("; the current equation peaked at %d tokens.\n"), peak);
+			}
 #endif
 			did_something = return_result(cur_equation);
 		} else {
@@ -2719,9 +2798,140 @@ next_var:
 	success_flag = true;
 	did_something = true;
 	used[i] = true;
+	if (n_done < ARR_CNT(done))
+		done[n_done++] = v;
+	n = n_lhs[cur_equation] + n_rhs[cur_equation];
+	peak = max(peak, n);
+#if	!SILENT
+	if (debug_level >= 1) {
+		fprintf(gfp, _("The current equation is now %d tokens.\n"), n);
+	}
+#endif
 	goto next_var;
 }
 
+/*
+ * Compare function for qsort(3) of Mathomatic variables.
+ */
+static int
+var_cmp(p1, p2)
+long	*p1, *p2;
+{
+	if (*p1 < *p2)
+		return -1;
+	return(*p1 > *p2);
+}
+
+/*
+ * Store all normal variables in the current equation in "va", in ascending order.
+ *
+ * Return the number of variables.
+ */
+static int
+elim_collect(va)
+long	*va;
+{
+	int		i, j, k, lo, hi, n, vc = 0;
+	long		v;
+	token_type	*p1;
+
+	for (j = 0; j < 2; j++) {
+		p1 = j ? rhs[cur_equation] : lhs[cur_equation];
+		n = j ? n_rhs[cur_equation] : n_lhs[cur_equation];
+		for (i = 0; i < n; i += 2) {
+			if (p1[i].kind != VARIABLE || (p1[i].token.variable & VAR_MASK) <= SIGN)
+				continue;
+			v = p1[i].token.variable;
+/* binary search for v, so only distinct variables are stored */
+			for (lo = 0, hi = vc; lo < hi;) {
+				k = (lo + hi) / 2;
+				if (va[k] < v)
+					lo = k + 1;
+				else
+					hi = k;
+			}
+			if (lo < vc && va[lo] == v)
+				continue;
+			if (vc >= MAX_VARS)
+				return vc;
+			blt(&va[lo+1], &va[lo], (vc - lo) * sizeof(*va));
+			va[lo] = v;
+			vc++;
+		}
+	}
+	return vc;
+}
+
+/*
+ * Return the index into "va" (sorted) of the variable to eliminate next from the current equation,
+ * or -1 if none of them can be eliminated.
+ * The occurrences of each variable in all unused equations are counted from the variable index,
+ * so only the equations written since they were last indexed are scanned.
+ * For ELIM_FEWEST, the variable with the fewest occurrences in all of these equations is chosen.
+ * For ELIM_DEGREE, each equation a variable is in adds the number of other variables in it,
+ * and the variable with the fewest neighbors, so the least fill-in, is chosen.
+ */
+static int
+elim_pick(va, vc, used, order)
+long	*va;
+int	vc;
+char	*used;
+int	order;
+{
+	int		i, k, m, n, e, best = -1;
+	int		occ[MAX_VARS], degree[MAX_VARS], n_sources[MAX_VARS], present[MAX_VARS];
+	char		in_current[MAX_VARS];
+	long		*vp;
+	sort_type	*sp;
+
+	for (k = 0; k < vc; k++) {
+		occ[k] = degree[k] = n_sources[k] = 0;
+		in_current[k] = false;
+	}
+	for (e = 0; e < n_equations; e++) {
+		if (e != cur_equation && (used[e] || n_lhs[e] <= 0 || n_rhs[e] <= 0))
+			continue;
+		if ((n = espace_var_list(e, &sp)) < 0)
+			return -1;
+		m = 0;
+		for (i = 0; i < n; i++) {
+			vp = (long *) bsearch(&sp[i].v, va, vc, sizeof(*va), var_cmp);
+			if (vp == NULL)
+				continue;
+			k = vp - va;
+			occ[k] += sp[i].count;
+			present[m++] = k;
+		}
+		for (i = 0; i < m; i++) {
+			k = present[i];
+			degree[k] += m - 1;
+			if (e == cur_equation)
+				in_current[k] = true;
+			else
+				n_sources[k]++;
+		}
+	}
+	for (k = 0; k < vc; k++) {
+		if (!in_current[k] || n_sources[k] == 0)
+			continue;
+		if (best < 0) {
+			best = k;
+		} else if (order == ELIM_DEGREE) {
+			if (degree[k] < degree[best] || (degree[k] == degree[best] && occ[k] < occ[best]))
+				best = k;
+		} else if (occ[k] < occ[best]) {
+			best = k;
+		}
+	}
+#if	!SILENT
+	if (best >= 0 && debug_level >= 1) {
+		list_var(va[best], 0);
+		fprintf(gfp, _("Eliminating (%s) next, with %d occurrences and degree %d.\n"), var_str, occ[best], degree[best]);
+	}
+#endif
+	return best;
+}
+
 /*
  * Solve equation number i for v and substitute the RHS
  * into all occurrences of v in the current equation, then simplify.
@@ -2748,7 +2958,9 @@ long	v;	/* Mathomatic variable */
 		fprintf(gfp, _("Solving equation #%d for (%s) and substituting into the current equation...\n"), i + 1, var_str);
 	}
 #endif
+	espace_written(cur_equation);
 	if (!solved) {
+		espace_written(i);
 		want.level = 1;
 		want.kind = VARIABLE;
 		want.token.variable = v;
@@ -2871,6 +3083,9 @@ char	*cp;
 	} else if (strncasecmp(cp, "hexadecimal", 3) == 0) {
 		export_flag = 4;
 		cp = skip_param(cp);
+	} else if (strncasecmp(cp, "json", 4) == 0) {
+		export_flag = 5;
+		cp = skip_param(cp);
 #if     SHELL_OUT
 	} else if (strncasecmp(cp, "primes", 5) == 0) {
 		primes_flag = true;
@@ -2932,7 +3147,7 @@ char	*cp;
 {
 	int			i, j, k;
 	enum language_list	language = C;
-	int			int_flag = false, displayed = false;
+	int			int_flag = false, displayed = false, gradient_flag = false;
 	char			*cp1;
 
 	for (;; cp = skip_param(cp)) {
@@ -2952,8 +3167,16 @@ char	*cp;
 			int_flag = true;
 			continue;
 		}
+		if (strcmp_tospace(cp, "gradient") == 0) {
+			gradient_flag = true;
+			continue;
+		}
 		break;
 	}
+	if (int_flag && gradient_flag) {
+		error(_("Gradient code can't use integer arithmetic."));
+		return false;
+	}
 	do {
 		cp1 = cp;
 		if (!get_range(&cp, &i, &j)) {
@@ -2966,6 +3189,29 @@ char	*cp;
 		for (k = i; k <= j; k++) {
 			if (n_lhs[k] <= 0)
 				continue;
+			if (gradient_flag) {
+/* Generate a function that computes the value and gradient by reverse-mode automatic differentiation. */
+				simp_i(lhs[k], &n_lhs[k]);
+				if (n_rhs[k] > 0) {
+					simp_i(rhs[k], &n_rhs[k]);
+				}
+				if ((cp1 = string_code_gradient(k, language)) == NULL)
+					return false;
+#if	LIBRARY
+				free_result_str();
+				result_str = cp1;
+				result_en = k;
+				displayed = true;
+				if (gfp == stdout)
+					continue;
+#endif
+				fprintf(gfp, "%s", cp1);
+				displayed = true;
+#if	!LIBRARY
+				free(cp1);
+#endif
+				continue;
+			}
 			if (n_rhs[k] == 0 || n_lhs[k] != 1 || lhs[k][0].kind != VARIABLE) {
 				warning(_("Can't make assignment statement because this is not an equation."));
 			} else if (!solved_equation(k)) {
@@ -3243,12 +3489,14 @@ int
 replace_cmd(cp)
 char	*cp;
 {
-	int	i, j;
-	int	n;
-	long	last_v, v, va[MAX_VARS];	/* Mathomatic variables */
-	int	vc;				/* variable count */
-	char	*cp_start, *cp1;
-	int	found;
+	int		i, j;
+	int		n;
+	long		last_v, v, va[MAX_VARS];	/* Mathomatic variables */
+	int		vc;				/* variable count */
+	char		*cp_start, *cp1;
+	int		found;
+	subst_type	subs[MAX_VARS];			/* the replacements, substituted all at once */
+	int		n_subs = 0;
 
 	cp_start = cp;
 	if (current_not_defined()) {
@@ -3277,6 +3525,7 @@ char	*cp;
 	blt(tlhs, lhs[i], n_tlhs * sizeof(token_type));
 	n_trhs = n_rhs[i];
 	blt(trhs, rhs[i], n_trhs * sizeof(token_type));
+	n_tes = 0;
 	last_v = 0;
 	for (;;) {
 		v = -1;
@@ -3324,23 +3573,25 @@ char	*cp;
 			continue;
 		}
 do_this:
-		/* Disguise all variables in the entered expression by making them negative; */
-		/* That way they won't be improperly substituted later, allowing variable interchange. */
-		for (j = 0; j < n; j += 2) {
-			if (scratch[j].kind == VARIABLE) {
-				scratch[j].token.variable = -scratch[j].token.variable;
-			}
-		}
-		subst_var_with_exp(tlhs, &n_tlhs, scratch, n, v);
-		subst_var_with_exp(trhs, &n_trhs, scratch, n, v);
-	}
-	/* Restore disguised variables: */
-	for (j = 0; j < n_tlhs; j += 2)
-		if (tlhs[j].kind == VARIABLE && tlhs[j].token.variable < 0)
-			tlhs[j].token.variable = -tlhs[j].token.variable;
-	for (j = 0; j < n_trhs; j += 2)
-		if (trhs[j].kind == VARIABLE && trhs[j].token.variable < 0)
-			trhs[j].token.variable = -trhs[j].token.variable;
+		/* Save the entered expression in tes[], to be substituted with all the others. */
+		if (n_subs >= ARR_CNT(subs)) {
+			error(_("Too many variables."));
+			return false;
+		}
+		if (n_tes + n > n_tokens) {
+			error_huge();
+		}
+		blt(&tes[n_tes], scratch, n * sizeof(token_type));
+		subs[n_subs].v = v;
+		subs[n_subs].expression = &tes[n_tes];
+		subs[n_subs].len = n;
+		n_subs++;
+		n_tes += n;
+	}
+	/* Substituting all at once won't substitute the variables in the entered expressions, */
+	/* allowing variable interchange. */
+	subst_vars_with_exps(tlhs, &n_tlhs, subs, n_subs);
+	subst_vars_with_exps(trhs, &n_trhs, subs, n_subs);
 	n_lhs[i] = n_tlhs;
 	blt(lhs[i], tlhs, n_tlhs * sizeof(token_type));
 	n_rhs[i] = n_trhs;
@@ -3526,6 +3777,7 @@ char	*cp;
 	int	count_down;
 	char	*cp1, *cp2;
 	double	d, ed;
+	char	digits[300];			/* exact digits of a large integer */
 #if	!LIBRARY
 	char	buf[MAX_CMD_LEN];
 #endif
@@ -3581,7 +3833,17 @@ retry:
 				if (cp == cp1 || errno) {
 					goto try_parsing;
 				}
+				cp2 = cp;
 				cp = skip_space(cp);
+				if (fabs(d) >= MAX_K_INTEGER && *cp != '-' && (*cp2 == '\0' || isspace(*cp2))
+				    && strspn(cp1, "+-0123456789") >= (size_t) (cp2 - cp1)) {
+/* too large for factor_one(), so use arbitrary precision: */
+					if (!factor_big_number(cp1, cp2 - cp1)) {
+						rv = false;
+						break;
+					}
+					continue;
+				}
 				if (*cp && !isdigit(*cp)) {
 					if (*cp == '-') {
 						cp2 = cp = skip_space(++cp);
@@ -3609,6 +3871,14 @@ try_parsing:
 						cp = skip_space(cp);
 					}
 				}
+				if (ed == d && fabs(d) >= MAX_K_INTEGER && exact_string(d, digits, sizeof(digits))) {
+/* the calculated integer is too large for factor_one(), but its exact value is known: */
+					if (!factor_big_number(digits, strlen(digits))) {
+						rv = false;
+						break;
+					}
+					continue;
+				}
 				count_down = (ed < d);
 				for (; count_down ? (d >= ed) : (d <= ed); count_down ? (d -= 1.0) : (d += 1.0)) {
 					if (!factor_one(d)) {
@@ -3903,23 +4173,44 @@ read_cmd(cp)
 char	*cp;
 {
 	int	rv;
+	int	continue_flag = false;
 
 	if (security_level >= 3) {
 		error(_("Command disabled by security level."));
 		return false;
 	}
+	if (strcmp_tospace(cp, "binary") == 0) {
+		cp = skip_param(cp);
+		if (*cp == '\0') {
+			error(_("No file name specified."));
+			return false;
+		}
+		return read_binary(cp);
+	}
+	if (strcmp_tospace(cp, "continue") == 0) {
+		cp = skip_param(cp);
+		continue_flag = true;
+	}
 	if (!repeat_flag) {
-		return read_file(cp);
+		return read_file(cp, continue_flag);
 	}
 	do {
-		rv = read_file(cp);
+		rv = read_file(cp, continue_flag);
 	} while (rv);
 	return rv;
 }
 
+/*
+ * Read and process the Mathomatic script file "cp",
+ * or standard input if "cp" is "-".
+ * If continue_flag is true, continue after any line that fails, then display a summary.
+ *
+ * Return true if no line failed.
+ */
 int
-read_file(cp)
+read_file(cp, continue_flag)
 char	*cp;
+int	continue_flag;
 {
 	int	rv;
 	FILE	*fp;
@@ -3933,8 +4224,10 @@ char	*cp;
 		error(_("File name too long."));
 		return false;
 	}
-	fp = fopen(buf, "r");
-	if (fp == NULL) {
+	if (strcmp(cp, "-") == 0) {
+		my_strlcpy(buf, _("standard input"), sizeof(buf));
+		fp = stdin;
+	} else if ((fp = fopen(buf, "r")) == NULL) {
 		buf[strlen(cp)] = '\0';
 		fp = fopen(buf, "r");
 		if (fp == NULL) {
@@ -3943,16 +4236,22 @@ char	*cp;
 			return false;
 		}
 	}
-	rv = read_sub(fp);
+	rv = read_sub(fp, continue_flag);
 	show_usage = false;
-	if (fclose(fp)) {
+	if (fp == stdin) {
+		clearerr(fp);
+	} else if (fclose(fp)) {
 		perror(buf);
 		rv = 1;
 	}
 #if	!SILENT
 	if (rv) {
-		printf(_("Reading of file \"%s\" aborted due to failure return status\n"), buf);
-		printf(_("of a command or expression parsing, or some other error listed above.\n"));
+		if (continue_flag) {
+			printf(_("Finished reading file \"%s\", with the errors listed above.\n"), buf);
+		} else {
+			printf(_("Reading of file \"%s\" aborted due to failure return status\n"), buf);
+			printf(_("of a command or expression parsing, or some other error listed above.\n"));
+		}
 	} else {
 		if (!quiet_mode && debug_level >= 0) {
 			printf(_("Successfully finished reading file \"%s\".\n"), buf);
@@ -3962,38 +4261,274 @@ char	*cp;
 	return(!rv);
 }
 
+#define	READ_CHUNK	65536	/* number of bytes read from a script at a time */
+
+typedef struct {		/* state of a script being read by read_sub() */
+	FILE		*fp;		/* the script */
+	char		*raw;		/* buffer for reading the script, READ_CHUNK bytes */
+	char		*ip, *ie;	/* the script bytes not yet used */
+	int		eof;		/* true if there are no more script bytes to read */
+	int		gzip;		/* true if the script is gzip compressed */
+#if	ZLIB
+	z_stream	z;		/* gzip decompression state */
+	int		in_member;	/* true if in the middle of a gzip member */
+	char		*text;		/* buffer for decompressed text, READ_CHUNK bytes */
+#endif
+	char		*tp, *te;	/* the text not yet split into lines */
+	char		*line;		/* the current line, null terminated */
+	long		line_size;	/* allocated size of line */
+	long		line_number;	/* number of lines read */
+	long		n_failed;	/* number of lines that failed */
+	long		first_failed;	/* line number of the first line that failed */
+	int		continue_flag;	/* true to continue after lines that fail */
+} script_type;
+
+/*
+ * Read the next script bytes into rp->ip and rp->ie.
+ *
+ * Return false if there are no more.
+ */
+static int
+script_read(rp)
+script_type	*rp;
+{
+	size_t	n;
+
+	if (rp->eof)
+		return false;
+	n = fread(rp->raw, 1, READ_CHUNK, rp->fp);
+	if (n == 0) {
+		rp->eof = true;
+		return false;
+	}
+	rp->ip = rp->raw;
+	rp->ie = &rp->raw[n];
+	return true;
+}
+
+/*
+ * Make more script text available in rp->tp and rp->te, decompressing if necessary.
+ *
+ * Return false if there is no more.
+ */
+static int
+script_text(rp)
+script_type	*rp;
+{
+#if	ZLIB
+	int	ret;
+#endif
+
+	if (!rp->gzip) {
+		if (rp->ip >= rp->ie && !script_read(rp))
+			return false;
+		rp->tp = rp->ip;
+		rp->te = rp->ie;
+		rp->ip = rp->ie;
+		return true;
+	}
+#if	ZLIB
+	for (;;) {
+		if (rp->ip >= rp->ie && !script_read(rp)) {
+			if (rp->in_member) {
+				rp->in_member = false;
+				error(_("Gzip compressed script is truncated."));
+				longjmp(jmp_save, 3);
+			}
+			return false;
+		}
+		rp->z.next_in = (Bytef *) rp->ip;
+		rp->z.avail_in = rp->ie - rp->ip;
+		rp->z.next_out = (Bytef *) rp->text;
+		rp->z.avail_out = READ_CHUNK;
+		ret = inflate(&rp->z, Z_NO_FLUSH);
+		rp->ip = (char *) rp->z.next_in;
+		if (ret == Z_STREAM_END) {
+			rp->in_member = false;
+			inflateReset(&rp->z);	/* there may be another gzip member following */
+		} else if (ret == Z_OK || ret == Z_BUF_ERROR) {
+			rp->in_member = true;
+		} else {
+			rp->in_member = false;	/* already reported, not truncated */
+			rp->eof = true;		/* don't continue with the rest of the script */
+			rp->ip = rp->ie;
+			error(_("Error decompressing gzip compressed script."));
+			longjmp(jmp_save, 3);
+		}
+		if (rp->z.avail_out < READ_CHUNK) {
+			rp->tp = rp->text;
+			rp->te = rp->text + (READ_CHUNK - rp->z.avail_out);
+			return true;
+		}
+	}
+#else
+	return false;
+#endif
+}
+
+/*
+ * Read the next line of the script into rp->line, without its newline.
+ * A line too long to be an expression is skipped with an error.
+ *
+ * Return false if there are no more lines.
+ */
+static int
+script_line(rp)
+script_type	*rp;
+{
+	long	len = 0, n, size, max_len;
+	char	*cp, *nl;
+	int	too_long = false;
+
+	max_len = n_tokens * sizeof(token_type);
+	rp->line_number++;
+	for (;;) {
+		if (rp->tp >= rp->te && !script_text(rp)) {
+			if (len == 0 && !too_long) {
+				rp->line_number--;
+				return false;
+			}
+			break;
+		}
+		nl = memchr(rp->tp, '\n', rp->te - rp->tp);
+		n = (nl ? nl : rp->te) - rp->tp;
+		if (len + n >= max_len) {
+			too_long = true;
+		}
+		if (!too_long) {
+			if (len + n >= rp->line_size) {
+				for (size = max(rp->line_size, 1024); len + n >= size; size *= 2)
+					;
+				if ((cp = (char *) realloc(rp->line, size)) == NULL) {
+					error(_("Out of memory (can't malloc(3))."));
+					longjmp(jmp_save, 3);
+				}
+				rp->line = cp;
+				rp->line_size = size;
+			}
+			blt(&rp->line[len], rp->tp, n);
+			len += n;
+		}
+		rp->tp += n;
+		if (nl) {
+			rp->tp++;
+			break;
+		}
+	}
+	if (too_long) {
+		error(_("Script line too long, skipped."));
+		longjmp(jmp_save, 3);
+	}
+	if (len > 0 && rp->line[len-1] == '\r')
+		len--;
+	rp->line[len] = '\0';
+	return true;
+}
+
 /*
- * Read and process Mathomatic input from a file pointer.
+ * Process all lines of the script, trapping errors.
  *
  * Return zero if no error, non-zero if aborted.
  */
-int
-read_sub(fp)
-FILE	*fp;
+static int
+script_process(rp)
+script_type	*rp;
 {
 	int	rv;
 	jmp_buf	save_save;
-	char	*cp;
 
-	if (fp == NULL) {
-		return -1;
-	}
 	blt(save_save, jmp_save, sizeof(jmp_save));
-	if ((rv = setjmp(jmp_save)) != 0) {	/* trap errors */
-		clean_up();
-		if (rv == 14) {
-			error(_("Expression too large."));
+	for (;;) {
+		if ((rv = setjmp(jmp_save)) != 0) {	/* trap errors */
+			clean_up();
+			if (rv == 14) {
+				error(_("Expression too large."));
+			}
+			if (rp->n_failed++ == 0)
+				rp->first_failed = rp->line_number;
+#if	!SILENT
+			printf(_("Line %ld of the script failed.\n"), rp->line_number);
+#endif
+			if (rp->continue_flag && rv != 13) {	/* always stop on critical errors */
+				continue;
+			}
+			break;
 		}
-	} else {
-		while ((cp = fgets((char *) tlhs, n_tokens * sizeof(token_type), fp)) != NULL) {
-			if (!display_process(cp)) {
+		while (script_line(rp)) {
+			if (!display_process(rp->line)) {
 				longjmp(jmp_save, 3);	/* jump to the above error trap */
 			}
 		}
+		break;
 	}
 	blt(jmp_save, save_save, sizeof(jmp_save));
 	return rv;
 }
+
+/*
+ * Read and process Mathomatic input from a file pointer,
+ * in large blocks that are split into lines, so the lines can be of any length.
+ * The script is read with fread(3), not memory mapped, because a mapped file
+ * that shrinks while it is being read crashes with SIGBUS.
+ * Gzip compressed scripts are decompressed
+ * if Mathomatic was compiled with zlib (make ZLIB=1).
+ * If continue_flag is true, continue after any line that fails.
+ *
+ * Return zero if no error, non-zero if aborted or any line failed.
+ */
+int
+read_sub(fp, continue_flag)
+FILE	*fp;
+int	continue_flag;
+{
+	int		rv = 0;
+	script_type	script, *rp = &script;
+
+	if (fp == NULL) {
+		return -1;
+	}
+	memset(rp, 0, sizeof(*rp));
+	rp->fp = fp;
+	rp->continue_flag = continue_flag;
+	if ((rp->raw = (char *) malloc(READ_CHUNK)) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		return -1;
+	}
+	script_read(rp);
+	if (rp->ie - rp->ip >= 2 && (unsigned char) rp->ip[0] == 0x1f && (unsigned char) rp->ip[1] == 0x8b) {
+#if	ZLIB
+		rp->gzip = true;
+		if ((rp->text = (char *) malloc(READ_CHUNK)) == NULL || inflateInit2(&rp->z, 15 + 32) != Z_OK) {
+			error(_("Out of memory (can't malloc(3))."));
+			rv = -1;
+			rp->gzip = false;
+		}
+#else
+		error(_("Script is gzip compressed; Mathomatic must be compiled with zlib (make ZLIB=1) to read it."));
+		rv = -1;
+#endif
+	}
+	if (rv == 0) {
+		rv = script_process(rp);
+	}
+#if	!SILENT
+	if (continue_flag && rp->n_failed) {
+		printf(_("%ld of %ld script lines failed; the first to fail was line %ld.\n"),
+		    rp->n_failed, rp->line_number, rp->first_failed);
+	}
+#endif
+	if (rp->n_failed)
+		rv = 3;
+#if	ZLIB
+	if (rp->gzip) {
+		inflateEnd(&rp->z);
+	}
+	free(rp->text);
+#endif
+	free(rp->raw);
+	free(rp->line);
+	return rv;
+}
 #endif
 
 #if	SHELL_OUT
@@ -4104,12 +4639,16 @@ char	*cp;
 {
 	FILE	*fp;
 	int	rv;
+	int	binary_flag;
 
 	if (security_level >= 2) {
 		error(_("Command disabled by security level."));
 		return false;
 	}
 	clean_up();	/* end any redirection */
+	if ((binary_flag = (strcmp_tospace(cp, "binary") == 0))) {
+		cp = skip_param(cp);
+	}
 	if (*cp == '\0') {
 		error(_("No file name specified."));
 		return false;
@@ -4129,6 +4668,14 @@ char	*cp;
 		}
 	}
 #endif
+	if (binary_flag) {
+		if (!save_binary(cp))
+			return false;
+#if	!SILENT
+		printf(_("All equations saved in binary file \"%s\".\n"), cp);
+#endif
+		return true;
+	}
 	fp = fopen(cp, "w");
 	if (fp == NULL) {
 		perror(cp);
@@ -4154,3 +4701,419 @@ char	*cp;
 	return rv;
 }
 #endif
+
+/*
+ * Binary snapshot files of the whole session: every equation space as raw token arrays,
+ * the variable name table, and the set options.
+ * The file is only readable by a Mathomatic of the same version on the same type of computer,
+ * and is fully validated before anything is changed.
+ *
+ * The file layout is a binary_header, the int options, the null terminated strings
+ * (variable names, then special_variable_characters and plot_prefix),
+ * then each non-empty equation space as a binary_space followed by its LHS and RHS tokens,
+ * then the keys of the exact integers used (see exact_save()) followed by their null terminated digits.
+ * Each part is padded to a multiple of BINARY_ALIGN bytes, so the tokens can be used in place.
+ */
+#define	BINARY_MAGIC	"Mathomatic bin\n"	/* first 16 bytes of a binary snapshot file */
+#define	BINARY_VERSION	2			/* increment whenever the format changes */
+#define	BINARY_ALIGN	sizeof(double)
+#define	BINARY_PAD(n)	((((n) + BINARY_ALIGN - 1) / BINARY_ALIGN) * BINARY_ALIGN)
+
+struct binary_header {
+	char		magic[16];	/* BINARY_MAGIC */
+	int		version;	/* BINARY_VERSION */
+	int		byte_order;	/* 0x01020304 in the byte order of the writer */
+	int		token_size;	/* sizeof(token_type) */
+	int		n_options;	/* number of int options */
+	int		n_var_names;	/* number of variable names */
+	int		strings_size;	/* size in bytes of all the strings */
+	int		n_spaces;	/* number of non-empty equation spaces */
+	int		cur_equation;	/* current equation space number */
+	int		n_exact;	/* number of exact integers */
+	int		exact_size;	/* size in bytes of all their digit strings */
+	unsigned long	size;		/* total size of the file in bytes */
+	unsigned long	checksum;	/* binary_checksum() of everything after the header */
+};
+
+struct binary_space {
+	int		en;		/* equation space number */
+	int		n_lhs, n_rhs;	/* number of tokens in each side */
+	int		unused;
+};
+
+/* the int set options saved in binary snapshot files */
+static int	*binary_options[] = {
+	&precision, &autosolve, &autocalc, &autodelete, &autoselect, &case_sensitive_flag,
+	&display2d, &fractions_display, &preserve_surds, &rationalize_denominators,
+	&modulus_mode, &finance_option, &factor_int_flag, &right_associative_power, &max_solve_steps,
+	&exact_integers
+};
+
+#define	N_BINARY_OPTIONS	(sizeof(binary_options) / sizeof(binary_options[0]))
+
+/*
+ * Return a checksum of "size" bytes at "cp", which must be aligned and a multiple of BINARY_ALIGN.
+ */
+static unsigned long
+binary_checksum(cp, size)
+char		*cp;
+unsigned long	size;
+{
+	unsigned long	h = 14695981039346656037UL, w;
+	unsigned long	i;
+
+	for (i = 0; i < size; i += sizeof(w)) {
+		memcpy(&w, &cp[i], sizeof(w));
+		h = (h ^ w) * 1099511628211UL;
+		h ^= h >> 29;
+	}
+	return h;
+}
+
+/*
+ * Append "n" bytes at "cp" to string buffer "sb", then zero bytes up to the next multiple of BINARY_ALIGN.
+ */
+static void
+binary_append(sb, cp, n)
+strbuf_type	*sb;
+char		*cp;
+int		n;
+{
+	static char	zeros[BINARY_ALIGN];
+
+	strbuf_appendn(sb, cp, n);
+	strbuf_appendn(sb, zeros, BINARY_PAD(sb->len) - sb->len);
+}
+
+/*
+ * Save all equation spaces, variable names, and set options in binary snapshot file "filename",
+ * with a single write.
+ *
+ * Return true if successful.
+ */
+int
+save_binary(filename)
+char	*filename;
+{
+	strbuf_type		sb, keys, digits;
+	struct binary_header	header;
+	struct binary_space	space;
+	int			i, options[N_BINARY_OPTIONS];
+	char			*cp;
+	FILE			*fp;
+	int			rv = true;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+	header.version = BINARY_VERSION;
+	header.byte_order = 0x01020304;
+	header.token_size = sizeof(token_type);
+	header.n_options = N_BINARY_OPTIONS;
+	header.cur_equation = cur_equation;
+	strbuf_init(&sb);
+	binary_append(&sb, (char *) &header, sizeof(header));
+	for (i = 0; i < N_BINARY_OPTIONS; i++) {
+		options[i] = *binary_options[i];
+	}
+	binary_append(&sb, (char *) options, sizeof(options));
+	i = sb.len;
+	for (header.n_var_names = 0; var_names[header.n_var_names]; header.n_var_names++) {
+		strbuf_appendn(&sb, var_names[header.n_var_names], strlen(var_names[header.n_var_names]) + 1);
+	}
+	strbuf_appendn(&sb, special_variable_characters, strlen(special_variable_characters) + 1);
+	strbuf_appendn(&sb, plot_prefix, strlen(plot_prefix) + 1);
+	header.strings_size = sb.len - i;
+	binary_append(&sb, "", 0);
+	for (i = 0; i < n_equations; i++) {
+		if (n_lhs[i] <= 0)
+			continue;
+		memset(&space, 0, sizeof(space));
+		space.en = i;
+		space.n_lhs = n_lhs[i];
+		space.n_rhs = n_rhs[i];
+		binary_append(&sb, (char *) &space, sizeof(space));
+		binary_append(&sb, (char *) lhs[i], n_lhs[i] * sizeof(token_type));
+		binary_append(&sb, (char *) rhs[i], n_rhs[i] * sizeof(token_type));
+		header.n_spaces++;
+	}
+	strbuf_init(&keys);
+	strbuf_init(&digits);
+	header.n_exact = exact_save(&keys, &digits);
+	header.exact_size = digits.len;
+	if (header.n_exact) {
+		binary_append(&sb, keys.str, keys.len);
+		binary_append(&sb, digits.str, digits.len);
+	}
+	sb.failed |= (keys.failed || digits.failed);
+	free(keys.str);
+	free(digits.str);
+	if ((cp = strbuf_finish(&sb)) == NULL)
+		return false;
+	header.size = sb.len;
+	header.checksum = binary_checksum(&cp[BINARY_PAD(sizeof(header))], sb.len - BINARY_PAD(sizeof(header)));
+	memcpy(cp, &header, sizeof(header));
+	fp = fopen(filename, "wb");
+	if (fp == NULL) {
+		perror(filename);
+		error(_("Can't create specified save file."));
+		free(cp);
+		return false;
+	}
+	if (fwrite(cp, 1, sb.len, fp) != sb.len)
+		rv = false;
+	if (fclose(fp))
+		rv = false;
+	free(cp);
+	if (!rv) {
+		perror(filename);
+		error(_("Error encountered while saving equations."));
+	}
+	return rv;
+}
+
+/*
+ * Compare function for qsort(3) of doubles.
+ */
+static int
+double_cmp(p1, p2)
+const void	*p1, *p2;
+{
+	double	d1 = *(const double *) p1, d2 = *(const double *) p2;
+
+	return((d1 > d2) - (d1 < d2));
+}
+
+/*
+ * Return true if the "n" doubles at "keys" are all different.
+ */
+static int
+binary_keys_unique(keys, n)
+double	*keys;
+int	n;
+{
+	int	i, rv = true;
+	double	*sorted;
+
+	if (n < 2)
+		return true;
+	if ((sorted = (double *) malloc(n * sizeof(double))) == NULL)
+		return false;
+	blt(sorted, keys, n * sizeof(double));
+	qsort(sorted, n, sizeof(double), double_cmp);
+	for (i = 1; i < n; i++) {
+		if (sorted[i] == sorted[i-1])
+			rv = false;
+	}
+	free(sorted);
+	return rv;
+}
+
+/*
+ * Return true if the "n" tokens at "p1" are a valid expression using "n_names" variable names.
+ */
+static int
+binary_expression_ok(p1, n, n_names)
+token_type	*p1;
+int		n;
+int		n_names;
+{
+	int	i;
+	long	v;
+
+	if (n < 0 || n > n_tokens || (n & 1) == 0)
+		return(n == 0);
+	for (i = 0; i < n; i++) {
+		if (p1[i].level < 1 || p1[i].level > n_tokens)
+			return false;
+		if ((i & 1) == 0) {
+			switch (p1[i].kind) {
+			case CONSTANT:
+				break;
+			case VARIABLE:
+				v = p1[i].token.variable & VAR_MASK;
+				if (p1[i].token.variable < 0 || v == V_NULL || (v >= VAR_OFFSET && v - VAR_OFFSET >= n_names))
+					return false;
+				break;
+			default:
+				return false;
+			}
+		} else if (p1[i].kind != OPERATOR || p1[i].token.operatr < PLUS || p1[i].token.operatr > FACTORIAL
+		    || p1[i].token.operatr == NEGATE) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Replace the whole session (all equation spaces, variable names, and set options)
+ * with binary snapshot file "filename", written by save_binary().
+ * The file is memory mapped where possible, and completely validated first,
+ * so nothing is changed if it is not a valid snapshot file.
+ *
+ * Return true if successful.
+ */
+int
+read_binary(filename)
+char	*filename;
+{
+	FILE			*fp;
+	char			*image = NULL, *cp, *ep, *strings, *exact_digits;
+	double			*exact_keys;
+	long			size;
+	struct binary_header	header;
+	struct binary_space	space;
+	int			i, j, *options;
+	int			rv = false;
+#if	!MINGW
+	struct stat		st;
+#endif
+
+	fp = fopen(filename, "rb");
+	if (fp == NULL) {
+		perror(filename);
+		error(_("Can't open requested file to read."));
+		return false;
+	}
+#if	MINGW
+	if (fseek(fp, 0L, SEEK_END) == 0 && (size = ftell(fp)) > 0 && fseek(fp, 0L, SEEK_SET) == 0) {
+		image = (char *) malloc(size);
+		if (image && fread(image, 1, size, fp) != size) {
+			free(image);
+			image = NULL;
+		}
+	}
+#else
+	if (fstat(fileno(fp), &st) == 0 && (size = st.st_size) > 0) {
+		image = (char *) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+		if (image == (char *) MAP_FAILED)
+			image = NULL;
+	}
+#endif
+	fclose(fp);
+	if (image == NULL) {
+		error(_("Unable to read binary file."));
+		return false;
+	}
+	if (size < BINARY_PAD(sizeof(header)))
+		goto invalid;
+	memcpy(&header, image, sizeof(header));
+	if (memcmp(header.magic, BINARY_MAGIC, sizeof(header.magic)) != 0)
+		goto invalid;
+	if (header.version != BINARY_VERSION || header.byte_order != 0x01020304
+	    || header.token_size != sizeof(token_type) || header.n_options != N_BINARY_OPTIONS) {
+		error(_("Binary file is from a different version of Mathomatic or type of computer."));
+		goto done;
+	}
+	if (header.size != (unsigned long) size || (size % BINARY_ALIGN) != 0
+	    || header.checksum != binary_checksum(&image[BINARY_PAD(sizeof(header))], size - BINARY_PAD(sizeof(header))))
+		goto invalid;
+/* validate everything before changing anything */
+	cp = &image[BINARY_PAD(sizeof(header))];
+	ep = &image[size];
+	options = (int *) cp;
+	cp += BINARY_PAD(N_BINARY_OPTIONS * sizeof(int));
+	strings = cp;
+	if (header.n_var_names < 0 || header.n_var_names >= MAX_VAR_NAMES
+	    || header.strings_size <= 0 || header.strings_size > ep - cp || cp[header.strings_size-1] != '\0')
+		goto invalid;
+	for (i = 0; i < header.n_var_names + 2; i++) {
+		if (cp >= &strings[header.strings_size])
+			goto invalid;
+		if (i < header.n_var_names && (cp[0] == '\0' || strlen(cp) > MAX_VAR_LEN))
+			goto invalid;
+		cp += strlen(cp) + 1;
+	}
+	if (cp != &strings[header.strings_size])
+		goto invalid;
+	cp = &strings[BINARY_PAD(header.strings_size)];
+	for (i = 0, j = -1; i < header.n_spaces; i++) {
+		if (ep - cp < BINARY_PAD(sizeof(space)))
+			goto invalid;
+		memcpy(&space, cp, sizeof(space));
+		cp += BINARY_PAD(sizeof(space));
+		if (space.en <= j || space.en >= N_EQUATIONS || space.n_lhs <= 0
+		    || space.n_lhs > n_tokens || space.n_rhs < 0 || space.n_rhs > n_tokens
+		    || ep - cp < BINARY_PAD(space.n_lhs * sizeof(token_type)) + BINARY_PAD(space.n_rhs * sizeof(token_type))
+		    || !binary_expression_ok((token_type *) cp, space.n_lhs, header.n_var_names))
+			goto invalid;
+		cp += BINARY_PAD(space.n_lhs * sizeof(token_type));
+		if (!binary_expression_ok((token_type *) cp, space.n_rhs, header.n_var_names))
+			goto invalid;
+		cp += BINARY_PAD(space.n_rhs * sizeof(token_type));
+		j = space.en;
+	}
+	if (header.n_exact < 0 || header.exact_size < 0
+	    || ep - cp < BINARY_PAD(header.n_exact * sizeof(double)) + BINARY_PAD(header.exact_size))
+		goto invalid;
+	exact_keys = (double *) cp;
+	cp += BINARY_PAD(header.n_exact * sizeof(double));
+	exact_digits = cp;
+	if (header.exact_size > 0 && cp[header.exact_size-1] != '\0')
+		goto invalid;
+	for (i = 0; i < header.n_exact; i++) {
+		if (cp >= &exact_digits[header.exact_size] || !exact_restore_ok(exact_keys[i], cp))
+			goto invalid;
+		cp += strlen(cp) + 1;
+	}
+	if (cp != &exact_digits[header.exact_size] || !binary_keys_unique(exact_keys, header.n_exact))
+		goto invalid;
+	cp = &exact_digits[BINARY_PAD(header.exact_size)];
+	if (cp != ep || header.cur_equation < 0 || header.cur_equation >= N_EQUATIONS
+	    || (j >= 0 && !alloc_to_espace(j)) || !alloc_to_espace(header.cur_equation)) {
+		goto invalid;
+	}
+/* the file is good, replace the session with it */
+	clear_all();
+	cp = strings;
+	for (i = 0; i < header.n_var_names; i++) {
+		if ((var_names[i] = strdup(cp)) == NULL) {
+			error(_("Out of memory (can't malloc(3) variable name)."));
+			clear_all();
+			goto done;
+		}
+		cp += strlen(cp) + 1;
+	}
+	var_names[i] = NULL;
+	my_strlcpy(special_variable_characters, cp, sizeof(special_variable_characters));
+	cp += strlen(cp) + 1;
+	my_strlcpy(plot_prefix, cp, sizeof(plot_prefix));
+	for (i = 0; i < N_BINARY_OPTIONS; i++) {
+		*binary_options[i] = options[i];
+	}
+	clear_solve_memo();
+	for (i = 0, cp = exact_digits; i < header.n_exact; i++) {
+		exact_restore(exact_keys[i], cp);
+		cp += strlen(cp) + 1;
+	}
+	cp = &strings[BINARY_PAD(header.strings_size)];
+	for (i = 0; i < header.n_spaces; i++) {
+		memcpy(&space, cp, sizeof(space));
+		cp += BINARY_PAD(sizeof(space));
+		blt(lhs[space.en], cp, space.n_lhs * sizeof(token_type));
+		n_lhs[space.en] = space.n_lhs;
+		cp += BINARY_PAD(space.n_lhs * sizeof(token_type));
+		blt(rhs[space.en], cp, space.n_rhs * sizeof(token_type));
+		n_rhs[space.en] = space.n_rhs;
+		cp += BINARY_PAD(space.n_rhs * sizeof(token_type));
+	}
+	cur_equation = header.cur_equation;
+	set_sign_array();
+	rv = true;
+#if	!SILENT
+	if (debug_level >= 0) {
+		printf(_("%d equation spaces loaded from binary file \"%s\".\n"), header.n_spaces, filename);
+	}
+#endif
+	goto done;
+
+invalid:
+	error(_("Not a valid Mathomatic binary file."));
+done:
+#if	MINGW
+	free(image);
+#else
+	munmap(image, size);
+#endif
+	return rv;
+}
@@ -0,0 +1,863 @@
+/*
+ * Mathomatic expression DAG routines.
+ * Expressions are hash-consed into a directed acyclic graph of unique nodes,
+ * so that repeated subexpressions are stored and processed only once.
+ * Used for differentiating expressions with a lot of repeated subexpressions.
+ *
+ * Copyright (C) 1987-2012 George Gesslein II.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+The chief copyright holder can be contacted at gesslein@mathomatic.org, or
+George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
+
+ */
+
+#include "includes.h"
+
+#define	DAG_MAX_NODES	1000000	/* maximum number of unique nodes, about 64 megabytes */
+#define	DAG_MIN_TEMP	7	/* minimum size (in tokens) of shared subexpressions to put in temp variables */
+
+typedef struct {
+	enum kind_list	kind;	/* CONSTANT, VARIABLE, or OPERATOR */
+	storage_type	token;	/* the constant, variable, or operator */
+	int		left;	/* left operand node, if an operator */
+	int		right;	/* right operand node, if an operator */
+	int		next;	/* next node in the same hash bucket, or -1 */
+	long		deriv_v;	/* variable the derivative memo is for, or 0 */
+	int		deriv;	/* memoized derivative node, or -1 if not possible */
+	long		dep_v;	/* variable the dependence memo is for, or 0 */
+	int		dep;	/* true if this node contains variable dep_v */
+	int		size;	/* number of tokens when flattened, limited to n_tokens + 1 */
+	int		mark;	/* traversal marker */
+	int		refs;	/* number of references from other nodes */
+	long		temp_v;	/* temp variable holding this node, or 0 */
+} dag_node_type;
+
+static dag_node_type	*dag;		/* the node store */
+static int		dag_n;		/* number of nodes in use */
+static int		dag_size;	/* number of nodes allocated */
+static int		*dag_bucket;	/* hash table heads */
+static int		dag_n_buckets;	/* size of the hash table, a power of 2 */
+static int		dag_mark;	/* current traversal marker */
+
+static int	add_node(enum kind_list kind, storage_type *tp, int left, int right);
+static int	add_node_op(int op, int a, int b);
+
+/*
+ * Remove all nodes, so a new DAG can be built.
+ * The allocated memory is kept for reuse.
+ */
+void
+dag_clear(void)
+{
+	int	i;
+
+	dag_n = 0;
+	for (i = 0; i < dag_n_buckets; i++)
+		dag_bucket[i] = -1;
+}
+
+/*
+ * Return the number of unique nodes in the DAG.
+ */
+int
+dag_count(void)
+{
+	return dag_n;
+}
+
+static unsigned long
+hash_node(kind, tp, left, right)
+enum kind_list	kind;
+storage_type	*tp;
+int		left, right;
+{
+	unsigned long	h;
+	unsigned char	*cp;
+	int		i;
+
+	h = (unsigned long) kind * 31UL + (unsigned long) left * 1000003UL + (unsigned long) right * 998244353UL;
+	switch (kind) {
+	case CONSTANT:
+		cp = (unsigned char *) &tp->constant;
+		for (i = 0; i < sizeof(tp->constant); i++)
+			h = h * 131UL + cp[i];
+		break;
+	case VARIABLE:
+		h = h * 131UL + (unsigned long) tp->variable;
+		break;
+	case OPERATOR:
+		h = h * 131UL + (unsigned long) tp->operatr;
+		break;
+	}
+	return h ^ (h >> 17);
+}
+
+/*
+ * Double the size of the hash table and rehash all nodes.
+ *
+ * Return true if successful.
+ */
+static int
+grow_buckets(void)
+{
+	int	i, n, *ip;
+	unsigned long	h;
+
+	n = dag_n_buckets ? dag_n_buckets * 2 : 1024;
+	if ((ip = (int *) realloc(dag_bucket, n * sizeof(int))) == NULL)
+		return false;
+	dag_bucket = ip;
+	dag_n_buckets = n;
+	for (i = 0; i < n; i++)
+		dag_bucket[i] = -1;
+	for (i = 0; i < dag_n; i++) {
+		h = hash_node(dag[i].kind, &dag[i].token, dag[i].left, dag[i].right) & (n - 1);
+		dag[i].next = dag_bucket[h];
+		dag_bucket[h] = i;
+	}
+	return true;
+}
+
+/*
+ * Return the unique node with the specified contents, creating it if it doesn't exist.
+ *
+ * Return -1 if out of memory.
+ */
+static int
+add_node(kind, tp, left, right)
+enum kind_list	kind;
+storage_type	*tp;
+int		left, right;
+{
+	int		i;
+	unsigned long	h;
+	dag_node_type	*dp;
+
+	if (kind == CONSTANT && tp->constant == 0.0)
+		tp->constant = 0.0;	/* don't distinguish negative zero */
+	if (dag_n_buckets == 0 && !grow_buckets())
+		return -1;
+	h = hash_node(kind, tp, left, right) & (dag_n_buckets - 1);
+	for (i = dag_bucket[h]; i >= 0; i = dag[i].next) {
+		dp = &dag[i];
+		if (dp->kind != kind || dp->left != left || dp->right != right)
+			continue;
+		switch (kind) {
+		case CONSTANT:
+			if (memcmp(&dp->token.constant, &tp->constant, sizeof(tp->constant)) == 0)
+				return i;
+			break;
+		case VARIABLE:
+			if (dp->token.variable == tp->variable)
+				return i;
+			break;
+		case OPERATOR:
+			if (dp->token.operatr == tp->operatr)
+				return i;
+			break;
+		}
+	}
+	if (dag_n >= DAG_MAX_NODES) {
+		error_huge();
+	}
+	if (dag_n >= dag_size) {
+		i = dag_size ? dag_size * 2 : 1024;
+		if ((dp = (dag_node_type *) realloc(dag, i * sizeof(dag_node_type))) == NULL)
+			return -1;
+		dag = dp;
+		dag_size = i;
+	}
+	if (dag_n >= dag_n_buckets) {
+		if (!grow_buckets())
+			return -1;
+		h = hash_node(kind, tp, left, right) & (dag_n_buckets - 1);
+	}
+	dp = &dag[dag_n];
+	memset(dp, 0, sizeof(*dp));
+	dp->kind = kind;
+	dp->token = *tp;
+	dp->left = left;
+	dp->right = right;
+	dp->deriv = -1;
+	if (kind == OPERATOR) {
+		dp->size = dag[left].size + dag[right].size + 1;
+		if (dp->size > n_tokens)
+			dp->size = n_tokens + 1;
+	} else {
+		dp->size = 1;
+	}
+	dp->next = dag_bucket[h];
+	dag_bucket[h] = dag_n;
+	return dag_n++;
+}
+
+/*
+ * Store the token of node "x" in "*tp", and its operand nodes
+ * in "*leftp" and "*rightp", which are -1 if "x" is not an operator.
+ */
+void
+dag_node(x, tp, leftp, rightp)
+int		x;
+token_type	*tp;
+int		*leftp, *rightp;
+{
+	tp->level = 1;
+	tp->kind = dag[x].kind;
+	tp->token = dag[x].token;
+	*leftp = dag[x].left;
+	*rightp = dag[x].right;
+}
+
+/*
+ * Return the node for constant "d".
+ */
+int
+dag_constant(d)
+double	d;
+{
+	storage_type	t;
+
+	t.constant = d;
+	return add_node(CONSTANT, &t, -1, -1);
+}
+
+/*
+ * Return the node for variable "v".
+ */
+int
+dag_variable(v)
+long	v;
+{
+	storage_type	t;
+
+	t.variable = v;
+	return add_node(VARIABLE, &t, -1, -1);
+}
+
+/*
+ * Return the node for "a op b", without any simplification.
+ */
+static int
+add_node_op(op, a, b)
+int	op, a, b;
+{
+	storage_type	t;
+
+	t.operatr = op;
+	return add_node(OPERATOR, &t, a, b);
+}
+
+/*
+ * Return true if node "x" is the constant "d".
+ */
+static int
+is_constant(x, d)
+int	x;
+double	d;
+{
+	return(dag[x].kind == CONSTANT && dag[x].token.constant == d);
+}
+
+/*
+ * Return the node for "a op b", doing trivial simplifications,
+ * like folding constants and removing multiplications by 1.
+ * PLUS and TIMES operands are put in a canonical order,
+ * so "a+b" and "b+a" are the same node.
+ *
+ * Return -1 if either operand is -1 or out of memory.
+ */
+int
+dag_op(op, a, b)
+int	op, a, b;
+{
+	int		i;
+	double		d;
+
+	if (a < 0 || b < 0)
+		return -1;
+	if (dag[a].kind == CONSTANT && dag[b].kind == CONSTANT) {
+		d = dag[a].token.constant;
+		switch (op) {
+		case PLUS:
+			d += dag[b].token.constant;
+			break;
+		case MINUS:
+			d -= dag[b].token.constant;
+			break;
+		case TIMES:
+			d *= dag[b].token.constant;
+			break;
+		case DIVIDE:
+			d /= dag[b].token.constant;
+			break;
+		case POWER:
+			if (fmod(dag[b].token.constant, 1.0) != 0.0)
+				return add_node_op(op, a, b);	/* keep roots exact */
+			d = pow(d, dag[b].token.constant);
+			break;
+		default:
+			d = NAN;
+			break;
+		}
+		if (isfinite(d))
+			return dag_constant(d);
+	}
+	switch (op) {
+	case PLUS:
+		if (is_constant(a, 0.0))
+			return b;
+		if (is_constant(b, 0.0))
+			return a;
+		break;
+	case MINUS:
+		if (is_constant(b, 0.0))
+			return a;
+		if (a == b)
+			return dag_constant(0.0);
+		break;
+	case TIMES:
+		if (is_constant(a, 0.0) || is_constant(b, 0.0))
+			return dag_constant(0.0);
+		if (is_constant(a, 1.0))
+			return b;
+		if (is_constant(b, 1.0))
+			return a;
+		break;
+	case DIVIDE:
+		if (is_constant(a, 0.0) && !is_constant(b, 0.0))
+			return a;
+		if (is_constant(b, 1.0))
+			return a;
+		break;
+	case POWER:
+		if (is_constant(b, 0.0))
+			return dag_constant(1.0);
+		if (is_constant(b, 1.0))
+			return a;
+		break;
+	}
+	if ((op == PLUS || op == TIMES) && a > b) {
+		i = a;
+		a = b;
+		b = i;
+	}
+	return add_node_op(op, a, b);
+}
+
+/*
+ * Return the precedence class of operator "op",
+ * higher numbers are done first.
+ */
+static int
+precedence(op)
+int	op;
+{
+	switch (op) {
+	case PLUS:
+	case MINUS:
+		return 1;
+	case TIMES:
+	case DIVIDE:
+	case MODULUS:
+	case IDIVIDE:
+		return 2;
+	case POWER:
+		return 3;
+	default:
+		return 4;
+	}
+}
+
+/*
+ * Recursively add the expression in p1 starting at "loc" to the DAG.
+ * The current level of parentheses is "level".
+ *
+ * Return the node, or -1 if the expression can't be represented.
+ */
+static int
+build_recurse(p1, n, loc, level)
+token_type	*p1;
+int		n, loc, level;
+{
+	int	i, x, y;
+	int	op, last_op;
+
+	if (p1[loc].level < level) {
+		switch (p1[loc].kind) {
+		case CONSTANT:
+			return dag_constant(p1[loc].token.constant);
+		case VARIABLE:
+			return dag_variable(p1[loc].token.variable);
+		default:
+			return -1;
+		}
+	}
+	if ((x = build_recurse(p1, n, loc, level + 1)) < 0)
+		return -1;
+	last_op = 0;
+	for (i = loc + 1; i < n && p1[i].level >= level; i += 2) {
+		if (p1[i].level != level)
+			continue;
+		op = p1[i].token.operatr;
+		if (last_op && (precedence(op) != precedence(last_op) || precedence(op) > 2)) {
+			return -1;	/* unparenthesized operators of different precedence */
+		}
+		last_op = op;
+		if ((y = build_recurse(p1, n, i + 1, level + 1)) < 0)
+			return -1;
+		if (op == FACTORIAL || op == MODULUS || op == IDIVIDE) {
+			x = add_node_op(op, x, y);
+		} else {
+			x = dag_op(op, x, y);
+		}
+		if (x < 0)
+			return -1;
+	}
+	return x;
+}
+
+/*
+ * Add the expression in p1 to the DAG.
+ * Repeated subexpressions are only stored once.
+ *
+ * Return the root node, or -1 if not possible.
+ */
+int
+dag_build(p1, n)
+token_type	*p1;	/* expression pointer */
+int		n;	/* expression length */
+{
+	if (n <= 0)
+		return -1;
+	return build_recurse(p1, n, 0, 1);
+}
+
+/*
+ * Return true if node "x" contains the variable "v".
+ * v can be MATCH_ANY to match any normal variable.
+ */
+int
+dag_depends(x, v)
+int	x;
+long	v;
+{
+	int	rv;
+
+	if (dag[x].dep_v == v)
+		return dag[x].dep;
+	switch (dag[x].kind) {
+	case VARIABLE:
+		rv = (dag[x].token.variable == v || (v == MATCH_ANY && (dag[x].token.variable & VAR_MASK) > SIGN));
+		break;
+	case OPERATOR:
+		rv = (dag_depends(dag[x].left, v) || dag_depends(dag[x].right, v));
+		break;
+	default:
+		rv = false;
+		break;
+	}
+	dag[x].dep_v = v;
+	dag[x].dep = rv;
+	return rv;
+}
+
+/*
+ * Flatten node "x" into the expression buffer at "*np" with parentheses level "level".
+ * Nodes stored in temp variables are replaced by the variable, except for node "skip".
+ */
+static void
+flatten_recurse(x, skip, level, dest, np)
+int		x, skip, level;
+token_type	*dest;
+int		*np;
+{
+	int	op, sub_op;
+
+	if (dag[x].kind != OPERATOR || (dag[x].temp_v && x != skip)) {
+		if (*np >= n_tokens) {
+			error_huge();
+		}
+		dest[*np].level = level;
+		if (dag[x].kind == OPERATOR) {
+			dest[*np].kind = VARIABLE;
+			dest[*np].token.variable = dag[x].temp_v;
+		} else {
+			dest[*np].kind = dag[x].kind;
+			dest[*np].token = dag[x].token;
+		}
+		(*np)++;
+		return;
+	}
+	op = dag[x].token.operatr;
+/* Operators of the same kind are left associative and need no parentheses on the left. */
+	sub_op = (dag[dag[x].left].kind == OPERATOR && !dag[dag[x].left].temp_v) ? dag[dag[x].left].token.operatr : 0;
+	if (((op == PLUS || op == MINUS) && (sub_op == PLUS || sub_op == MINUS))
+	    || ((op == TIMES || op == DIVIDE) && (sub_op == TIMES || sub_op == DIVIDE))) {
+		flatten_recurse(dag[x].left, skip, level, dest, np);
+	} else {
+		flatten_recurse(dag[x].left, skip, level + 1, dest, np);
+	}
+	if (*np >= n_tokens) {
+		error_huge();
+	}
+	dest[*np].level = level;
+	dest[*np].kind = OPERATOR;
+	dest[*np].token.operatr = op;
+	(*np)++;
+	sub_op = (dag[dag[x].right].kind == OPERATOR && !dag[dag[x].right].temp_v) ? dag[dag[x].right].token.operatr : 0;
+	if ((op == PLUS && (sub_op == PLUS || sub_op == MINUS))
+	    || (op == TIMES && (sub_op == TIMES || sub_op == DIVIDE))) {
+		flatten_recurse(dag[x].right, skip, level, dest, np);
+	} else {
+		flatten_recurse(dag[x].right, skip, level + 1, dest, np);
+	}
+}
+
+/*
+ * Store node "x" as a regular expression in dest,
+ * expanding all shared subexpressions.
+ * Aborts with error_huge() if the result is too large.
+ */
+void
+dag_flatten(x, dest, np)
+int		x;
+token_type	*dest;
+int		*np;
+{
+	*np = 0;
+	flatten_recurse(x, -1, 1, dest, np);
+}
+
+/*
+ * Numerically evaluate node "x", with variable "v" set to "value".
+ * Nodes are created after their operands, so evaluating all nodes up to "x"
+ * in the order they were created is a simple, fast, non-recursive evaluation,
+ * with each shared subexpression evaluated only once.
+ * Other variables and imaginary results evaluate to NaN.
+ *
+ * Return the value of node "x", or NaN if out of memory.
+ */
+double
+dag_eval(x, v, value)
+int	x;
+long	v;
+double	value;
+{
+	static double	*vals;		/* the value of each node */
+	static int	vals_size;	/* number of values allocated */
+
+	int		i;
+	double		*dp, d1, d2;
+	dag_node_type	*np;
+
+	if (x >= vals_size) {
+		if ((dp = (double *) realloc(vals, dag_size * sizeof(double))) == NULL)
+			return NAN;
+		vals = dp;
+		vals_size = dag_size;
+	}
+	for (i = 0; i <= x; i++) {
+		np = &dag[i];
+		switch (np->kind) {
+		case CONSTANT:
+			vals[i] = np->token.constant;
+			continue;
+		case VARIABLE:
+			if (np->token.variable == v)
+				vals[i] = value;
+			else
+				vals[i] = NAN;
+			continue;
+		default:
+			break;
+		}
+		d1 = vals[np->left];
+		d2 = vals[np->right];
+		switch (np->token.operatr) {
+		case PLUS:
+			vals[i] = d1 + d2;
+			break;
+		case MINUS:
+			vals[i] = d1 - d2;
+			break;
+		case TIMES:
+			vals[i] = d1 * d2;
+			break;
+		case DIVIDE:
+			vals[i] = d1 / d2;
+			break;
+		case IDIVIDE:
+			modf(d1 / d2, &vals[i]);
+			break;
+		case MODULUS:
+			vals[i] = fixed_fmod(d1, d2);
+			if (modulus_mode && vals[i] < 0.0)
+				vals[i] += fabs(d2);
+			if (modulus_mode == 1 && d2 < 0.0 && vals[i] > 0.0)
+				vals[i] += d2;
+			break;
+		case POWER:
+			vals[i] = pow(d1, d2);
+			break;
+		case FACTORIAL:
+			if (!calc(NULL, &d1, FACTORIAL, 0.0))
+				d1 = NAN;
+			vals[i] = d1;
+			break;
+		default:
+			vals[i] = NAN;
+			break;
+		}
+	}
+	return vals[x];
+}
+
+/*
+ * Recursive differentiation routine for DAG nodes.
+ * Each node is only differentiated once for each variable,
+ * the result is remembered and reused.
+ *
+ * Return the derivative node, or -1 if not possible.
+ */
+static int
+diff_recurse(x, v)
+int	x;
+long	v;
+{
+	int		a, b, da, db, r, n;
+	complexs	c;
+
+	if (dag[x].deriv_v == v)
+		return dag[x].deriv;
+	a = dag[x].left;
+	b = dag[x].right;
+	switch (dag[x].kind) {
+	case CONSTANT:
+		r = dag_constant(0.0);
+		break;
+	case VARIABLE:
+		r = dag_constant(dag_depends(x, v) ? 1.0 : 0.0);
+		break;
+	default:
+		if (!dag_depends(x, v)) {
+			r = dag_constant(0.0);
+			break;
+		}
+		switch (dag[x].token.operatr) {
+		case PLUS:
+		case MINUS:
+/* d(u+v) = d(u) + d(v) */
+			r = dag_op(dag[x].token.operatr, diff_recurse(a, v), diff_recurse(b, v));
+			break;
+		case TIMES:
+/* d(u*v) = u*d(v) + v*d(u) */
+			da = diff_recurse(a, v);
+			db = diff_recurse(b, v);
+			r = dag_op(PLUS, dag_op(TIMES, a, db), dag_op(TIMES, b, da));
+			break;
+		case DIVIDE:
+/* d(u/v) = (v*d(u) - u*d(v))/v^2 */
+			da = diff_recurse(a, v);
+			db = diff_recurse(b, v);
+			if (db >= 0 && is_constant(db, 0.0)) {
+				r = dag_op(DIVIDE, da, b);
+			} else {
+				r = dag_op(DIVIDE, dag_op(MINUS, dag_op(TIMES, b, da), dag_op(TIMES, a, db)),
+				    dag_op(POWER, b, dag_constant(2.0)));
+			}
+			break;
+		case POWER:
+			if (!dag_depends(b, v)) {
+/* d(u^c) = c*u^(c-1)*d(u) */
+				r = dag_op(TIMES, dag_op(TIMES, b, dag_op(POWER, a, dag_op(MINUS, b, dag_constant(1.0)))),
+				    diff_recurse(a, v));
+				break;
+			}
+/* d(c^u) = c^u*ln(c)*d(u), only if c is a constant */
+			r = -1;
+			if (!dag_depends(a, MATCH_ANY) && dag[a].size <= n_tokens) {
+				n = 0;
+				flatten_recurse(a, -1, 1, scratch, &n);
+				if (parse_complex(scratch, n, &c)) {
+					c = complex_log(c);
+					r = dag_op(TIMES, dag_op(TIMES, x, dag_op(PLUS, dag_constant(c.re),
+					    dag_op(TIMES, dag_constant(c.im), dag_variable(IMAGINARY)))), diff_recurse(b, v));
+				}
+			}
+			break;
+		default:
+			r = -1;
+			break;
+		}
+		break;
+	}
+	dag[x].deriv_v = v;
+	dag[x].deriv = r;
+	return r;
+}
+
+/*
+ * Return the derivative of node "x" with respect to variable "v",
+ * which may be MATCH_ANY to differentiate with respect to all normal variables.
+ *
+ * Return -1 if not possible.
+ */
+int
+dag_diff(x, v)
+int	x;
+long	v;
+{
+	if (x < 0)
+		return -1;
+	return diff_recurse(x, v);
+}
+
+/*
+ * Count the references to each node reachable from node "x".
+ */
+static void
+count_refs(x)
+int	x;
+{
+	if (dag[x].mark == dag_mark) {
+		dag[x].refs++;
+		return;
+	}
+	dag[x].mark = dag_mark;
+	dag[x].refs = 1;
+	if (dag[x].kind == OPERATOR) {
+		count_refs(dag[x].left);
+		count_refs(dag[x].right);
+	}
+}
+
+/*
+ * Append all nodes reachable from node "x" that should go in temp variables
+ * to the list "list", children first.
+ */
+static void
+list_temps(x, list, np)
+int	x, *list, *np;
+{
+	if (dag[x].kind != OPERATOR || dag[x].mark == dag_mark)
+		return;
+	dag[x].mark = dag_mark;
+	list_temps(dag[x].left, list, np);
+	list_temps(dag[x].right, list, np);
+	if (dag[x].refs > 1 && dag[x].size >= DAG_MIN_TEMP) {
+		list[(*np)++] = x;
+	}
+}
+
+/*
+ * qsort(3) comparison function for ordering temp variable candidates
+ * by the number of tokens saved, largest first.
+ */
+static int
+temp_cmp(p1, p2)
+const void	*p1, *p2;
+{
+	double	d1, d2;
+
+	d1 = (double) dag[*(const int *) p1].size * (dag[*(const int *) p1].refs - 1);
+	d2 = (double) dag[*(const int *) p2].size * (dag[*(const int *) p2].refs - 1);
+	if (d1 > d2)
+		return -1;
+	if (d1 < d2)
+		return 1;
+	return(*(const int *) p1 - *(const int *) p2);
+}
+
+static int
+int_cmp(p1, p2)
+const void	*p1, *p2;
+{
+	return(*(const int *) p1 - *(const int *) p2);
+}
+
+/*
+ * Store node "x" as a regular expression in dest,
+ * like dag_flatten(), but every subexpression used more than once
+ * is put in a new equation space as "tempN = subexpression",
+ * like the optimize command does.
+ * The temp equations are simplified if "simplify_flag" is true, and displayed.
+ *
+ * Return the number of temp variables created.
+ */
+int
+dag_temps(x, dest, np, simplify_flag)
+int		x;
+token_type	*dest;
+int		*np;
+int		simplify_flag;
+{
+	int	i, k, n, n_free;
+	int	*list;
+	long	v;
+
+	for (i = 0; i < dag_n; i++) {
+		dag[i].temp_v = 0;
+	}
+	dag_mark++;
+	count_refs(x);
+	dag[x].refs = 0;
+	if ((list = (int *) malloc(dag_n * sizeof(int))) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		longjmp(jmp_save, 2);
+	}
+	n = 0;
+	dag_mark++;
+	list_temps(x, list, &n);
+	for (i = 0, n_free = 0; i < N_EQUATIONS; i++) {
+		if (empty_equation_space(i))
+			n_free++;
+	}
+	if (n > n_free) {
+		qsort(list, n, sizeof(int), temp_cmp);
+		n = n_free;
+		qsort(list, n, sizeof(int), int_cmp);	/* children have lower node numbers */
+	}
+	for (i = 0; i < n; i++) {
+		if (!new_temp_var(&v)) {
+			break;	/* can't create "temp" variable */
+		}
+		dag[list[i]].temp_v = v;
+	}
+	n = i;
+	for (i = 0; i < n; i++) {
+		k = next_espace();
+		lhs[k][0].level = 1;
+		lhs[k][0].kind = VARIABLE;
+		lhs[k][0].token.variable = dag[list[i]].temp_v;
+		n_lhs[k] = 1;
+		n_rhs[k] = 0;
+		flatten_recurse(list[i], list[i], 1, rhs[k], &n_rhs[k]);
+		if (simplify_flag) {
+			simpa_repeat_side(rhs[k], &n_rhs[k], true, false);
+		} else {
+			elim_loop(rhs[k], &n_rhs[k]);
+		}
+		list_sub(k);
+	}
+	free(list);
+	*np = 0;
+	flatten_recurse(x, -1, 1, dest, np);
+	for (i = 0; i < dag_n; i++) {
+		dag[i].temp_v = 0;
+	}
+	return n;
+}
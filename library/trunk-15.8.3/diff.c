@@ -313,14 +313,24 @@ char	*cp;
 	token_type	*source, *dest;
 	int		n1, *nps, *np;
 	int		simplify_flag = true, solved;
+	int		dag_flag = false, temps_flag = false;
+	int		x = -1;		/* DAG node of the derivative */
 
 	if (current_not_defined()) {
 		return false;
 	}
 	solved = solved_equation(cur_equation);
-	if (strcmp_tospace(cp, "nosimplify") == 0) {
-		simplify_flag = false;
-		cp = skip_param(cp);
+	for (;; cp = skip_param(cp)) {
+		if (strcmp_tospace(cp, "nosimplify") == 0) {
+			simplify_flag = false;
+		} else if (strcmp_tospace(cp, "dag") == 0) {
+			dag_flag = true;
+		} else if (strcmp_tospace(cp, "optimize") == 0) {
+			dag_flag = true;
+			temps_flag = true;
+		} else {
+			break;
+		}
 	}
 	i = next_espace();
 	if (n_rhs[cur_equation]) {
@@ -394,8 +404,41 @@ char	*cp;
 #endif
 	blt(dest, source, *nps * sizeof(token_type));
 	n1 = *nps;
+	if (dag_flag) {
+/* Differentiate each unique subexpression only once, using a DAG. */
+		organize(dest, &n1);
+		dag_clear();
+		x = dag_build(dest, n1);
+		for (l1 = 0; l1 < order && x >= 0; l1++) {
+			x = dag_diff(x, v);
+		}
+		if (x < 0) {
+			warning(_("DAG differentiation not possible here, using the regular method..."));
+			n1 = *nps;
+			blt(dest, source, n1 * sizeof(token_type));
+		} else {
+#if	!SILENT
+			if (debug_level >= 1) {
+				fprintf(gfp, _("The DAG has %d unique nodes.\n"), dag_count());
+			}
+#endif
+			if (temps_flag) {
+				n1 = 1;		/* temporary, so this equation space is in use */
+				dest[0].level = 1;
+				dest[0].kind = CONSTANT;
+				dest[0].token.constant = 0.0;
+			} else {
+				dag_flatten(x, dest, &n1);
+				if (simplify_flag) {
+					simpa_repeat_side(dest, &n1, true, false);
+				} else {
+					elim_loop(dest, &n1);
+				}
+			}
+		}
+	}
 /* do the actual differentiating and simplifying: */
-	for (l1 = 0; l1 < order; l1++) {
+	for (l1 = 0; x < 0 && l1 < order; l1++) {
 		if (order != 1) {
 			if (n1 == 1 && dest[0].kind == CONSTANT && dest[0].token.constant == 0.0) {
 				fprintf(gfp, _("0 reached after %ld derivatives taken.\n"), l1);
@@ -428,10 +471,254 @@ char	*cp;
 			}
 		}
 	}
+	if (temps_flag && x >= 0) {
+/* Now that the result equation space is in use, put the shared subexpressions in new ones. */
+		dag_temps(x, dest, &n1, simplify_flag);
+		if (simplify_flag) {
+			simpa_repeat_side(dest, &n1, true, false);
+		} else {
+			elim_loop(dest, &n1);
+		}
+		*np = n1;
+	}
 	cur_equation = i;
 	return return_result(cur_equation);
 }
 
+/*
+ * Store the variable named "d<y>_d<x>" in "*vp",
+ * for the LHS of the partial derivative of equation "y = ..." with respect to "x".
+ *
+ * Return true if successful.
+ */
+static int
+partial_var(y, x, vp)
+long	y, x;
+long	*vp;
+{
+	char	buf[MAX_VAR_LEN], name[MAX_VAR_LEN];
+
+	list_var(y, 0);
+	my_strlcpy(buf, var_str, sizeof(buf));
+	list_var(x, 0);
+	if (snprintf(name, sizeof(name), "d%s_d%s", buf, var_str) >= (MAX_VAR_LEN - 1))
+		return false;
+	return(parse_var(vp, name) != NULL);
+}
+
+#if	LIBRARY
+/*
+ * Return the Jacobian matrix in equation spaces "ens" as a malloc()ed text string,
+ * one row per line, with the entries separated by commas.
+ */
+static char *
+matrix_string(ens, n_rows, n_cols)
+int	*ens, n_rows, n_cols;
+{
+	int	k, len = 0;
+	char	*cp, *mp, *str = NULL;
+
+	for (k = 0; k < n_rows * n_cols; k++) {
+		if (n_rhs[ens[k]])
+			cp = list_expression(rhs[ens[k]], n_rhs[ens[k]], false);
+		else
+			cp = list_expression(lhs[ens[k]], n_lhs[ens[k]], false);
+		if (cp == NULL || (mp = (char *) realloc(str, len + strlen(cp) + 3)) == NULL) {
+			free(cp);
+			free(str);
+			return NULL;
+		}
+		str = mp;
+		strcpy(&str[len], cp);
+		len += strlen(cp);
+		free(cp);
+		if ((k + 1) % n_cols) {
+			str[len++] = ',';
+			str[len++] = ' ';
+		} else if (k + 1 < n_rows * n_cols) {
+			str[len++] = '\n';
+		}
+		str[len] = '\0';
+	}
+	return str;
+}
+#endif
+
+/*
+ * The jacobian command.
+ * Computes the matrix of partial derivatives of a range of equation spaces
+ * with respect to a list of variables, all in one pass.
+ * Every expression is put in the same DAG, so each unique subexpression
+ * is only differentiated once for each variable.
+ */
+int
+jacobian_cmd(cp)
+char	*cp;
+{
+	int		i, j, k, r;
+	int		start, stop;
+	int		n_rows = 0, n_cols = 0, n_free = 0, n1;
+	int		rows[N_EQUATIONS], roots[N_EQUATIONS];
+	int		nodes[N_EQUATIONS], ens[N_EQUATIONS];
+	long		va[N_EQUATIONS], v, last_v, v1;
+	int		simplify_flag = true;
+	token_type	*source, *dest;
+	int		n;
+
+	if (strcmp_tospace(cp, "nosimplify") == 0) {
+		simplify_flag = false;
+		cp = skip_param(cp);
+	}
+	if (!get_range(&cp, &start, &stop)) {
+		return false;
+	}
+	for (i = start; i <= stop; i++) {
+		if (n_lhs[i] > 0) {
+			rows[n_rows++] = i;
+		}
+	}
+	while (*cp) {
+		if ((cp = parse_var2(&v, cp)) == NULL) {
+			return false;
+		}
+		if (n_cols >= ARR_CNT(va)) {
+			error(_("Too many variables specified."));
+			return false;
+		}
+		va[n_cols++] = v;
+	}
+	show_usage = false;
+	if (n_cols == 0) {
+/* Use all normal variables, in order. */
+		for (last_v = 0;;) {
+			v1 = -1;
+			for (r = 0; r < n_rows; r++) {
+				i = rows[r];
+				source = n_rhs[i] ? rhs[i] : lhs[i];
+				n = n_rhs[i] ? n_rhs[i] : n_lhs[i];
+				for (j = 0; j < n; j += 2) {
+					if (source[j].kind == VARIABLE && (source[j].token.variable & VAR_MASK) > SIGN
+					    && source[j].token.variable > last_v
+					    && (v1 == -1 || source[j].token.variable < v1)) {
+						v1 = source[j].token.variable;
+					}
+				}
+			}
+			if (v1 == -1)
+				break;
+			if (n_cols >= ARR_CNT(va)) {
+				error(_("Too many variables."));
+				return false;
+			}
+			va[n_cols++] = last_v = v1;
+		}
+		if (n_cols == 0) {
+			error(_("No variables found."));
+			return false;
+		}
+	}
+	for (i = 0; i < N_EQUATIONS; i++) {
+		if (empty_equation_space(i))
+			n_free++;
+	}
+	if (n_rows * n_cols > n_free) {
+		error(_("Not enough free equation spaces to hold the matrix."));
+		return false;
+	}
+#if	!SILENT
+	if (debug_level >= 0) {
+		fprintf(gfp, _("Differentiating %d expression%s with respect to %d variable%s"),
+		    n_rows, (n_rows == 1) ? "" : "s", n_cols, (n_cols == 1) ? "" : "s");
+		if (simplify_flag) {
+			fprintf(gfp, _(" and simplifying"));
+		}
+		fprintf(gfp, "...\n");
+	}
+#endif
+/* Put every expression in one DAG, then take all the partial derivatives, one variable at a time. */
+	dag_clear();
+	for (r = 0; r < n_rows; r++) {
+		i = rows[r];
+		if (n_rhs[i]) {
+			blt(tes, rhs[i], n_rhs[i] * sizeof(token_type));
+			n_tes = n_rhs[i];
+		} else {
+			blt(tes, lhs[i], n_lhs[i] * sizeof(token_type));
+			n_tes = n_lhs[i];
+		}
+		organize(tes, &n_tes);
+		roots[r] = dag_build(tes, n_tes);
+	}
+	for (j = 0; j < n_cols; j++) {
+		for (r = 0; r < n_rows; r++) {
+			nodes[r*n_cols+j] = dag_diff(roots[r], va[j]);
+		}
+	}
+#if	!SILENT
+	if (debug_level >= 1) {
+		fprintf(gfp, _("The DAG has %d unique nodes.\n"), dag_count());
+	}
+#endif
+/* Store each matrix entry in a new equation space, in row order. */
+	for (k = 0; k < n_rows * n_cols; k++) {
+		r = k / n_cols;
+		j = k % n_cols;
+		i = rows[r];
+		ens[k] = next_espace();
+		if (solved_equation(i) && partial_var(lhs[i][0].token.variable, va[j], &v)) {
+			lhs[ens[k]][0].level = 1;
+			lhs[ens[k]][0].kind = VARIABLE;
+			lhs[ens[k]][0].token.variable = v;
+			n_lhs[ens[k]] = 1;
+			dest = rhs[ens[k]];
+		} else {
+			dest = lhs[ens[k]];
+		}
+		if (nodes[k] >= 0) {
+			dag_flatten(nodes[k], dest, &n1);
+		} else {
+/* The DAG rules can't do this one, so use the regular method. */
+			source = n_rhs[i] ? rhs[i] : lhs[i];
+			n1 = n_rhs[i] ? n_rhs[i] : n_lhs[i];
+			blt(dest, source, n1 * sizeof(token_type));
+			if (!differentiate(dest, &n1, va[j])) {
+				error(_("Differentiation failed."));
+				for (; k >= 0; k--) {
+					n_lhs[ens[k]] = 0;
+					n_rhs[ens[k]] = 0;
+				}
+				return false;
+			}
+		}
+		if (simplify_flag) {
+			simpa_repeat_side(dest, &n1, true, false);
+		} else {
+			elim_loop(dest, &n1);
+		}
+		if (dest == lhs[ens[k]]) {
+			n_lhs[ens[k]] = n1;
+		} else {
+			n_rhs[ens[k]] = n1;
+		}
+	}
+#if	!LIBRARY
+	for (k = 0; k < n_rows * n_cols - 1; k++) {
+		list_sub(ens[k]);
+	}
+#endif
+	cur_equation = ens[n_rows*n_cols-1];
+	if (!return_result(cur_equation)) {
+		return false;
+	}
+#if	LIBRARY
+	free_result_str();
+	result_str = matrix_string(ens, n_rows, n_cols);
+	return(result_str != NULL);
+#else
+	return true;
+#endif
+}
+
 /*
  * The extrema command.
  */
@@ -522,6 +809,364 @@ char	*cp;
 	return return_result(cur_equation);
 }
 
+/*
+ * Truncated power series routines for the "taylor series" command follow.
+ * A series is stored as an array of its first series_len coefficients,
+ * the coefficient of (v-point)^k being element k.
+ * The expression is evaluated only once at the expansion point,
+ * using series arithmetic on these coefficient arrays, instead of repeatedly differentiating.
+ */
+
+static int	series_len;		/* number of coefficients in each series, order + 1 */
+static long	series_v;		/* the expansion variable */
+static double	series_point;		/* the numeric expansion point */
+
+/*
+ * Multiply series a by series b, putting the truncated result in r.
+ * r must not overlap a or b.
+ */
+static void
+series_times(r, a, b)
+double	*r, *a, *b;
+{
+	int	i, j;
+
+	for (i = 0; i < series_len; i++) {
+		r[i] = 0.0;
+		for (j = 0; j <= i; j++)
+			r[i] += a[j] * b[i-j];
+	}
+}
+
+/*
+ * Divide series a by series b, putting the result in r.
+ * r must not overlap a or b.
+ *
+ * Return false if b has a zero constant term.
+ */
+static int
+series_divide(r, a, b)
+double	*r, *a, *b;
+{
+	int	i, j;
+	double	d;
+
+	if (b[0] == 0.0)
+		return false;
+	for (i = 0; i < series_len; i++) {
+		d = a[i];
+		for (j = 1; j <= i; j++)
+			d -= b[j] * r[i-j];
+		r[i] = d / b[0];
+	}
+	return true;
+}
+
+/*
+ * Set r to e raised to the power of series a.
+ * r must not overlap a.
+ */
+static void
+series_exp(r, a)
+double	*r, *a;
+{
+	int	i, j;
+	double	d;
+
+	r[0] = exp(a[0]);
+	for (i = 1; i < series_len; i++) {
+		d = 0.0;
+		for (j = 1; j <= i; j++)
+			d += j * a[j] * r[i-j];
+		r[i] = d / i;
+	}
+}
+
+/*
+ * Set r to the natural logarithm of series a.
+ * r must not overlap a.
+ *
+ * Return false if the constant term of a is not positive.
+ */
+static int
+series_log(r, a)
+double	*r, *a;
+{
+	int	i, j;
+	double	d;
+
+	if (a[0] <= 0.0)
+		return false;
+	r[0] = log(a[0]);
+	for (i = 1; i < series_len; i++) {
+		d = 0.0;
+		for (j = 1; j < i; j++)
+			d += j * r[j] * a[i-j];
+		r[i] = (a[i] - d / i) / a[0];
+	}
+	return true;
+}
+
+/*
+ * Raise series a to the constant power p, putting the result in r.
+ * r must not overlap a.
+ *
+ * Return false if the result is not a real power series.
+ */
+static int
+series_power(r, a, p)
+double	*r, *a;
+double	p;
+{
+	int	i, j;
+	double	d, *t;
+
+	if (a[0] == 0.0 || (a[0] < 0.0 && fmod(p, 1.0) != 0.0)) {
+		if (p < 0.0 || fmod(p, 1.0) != 0.0 || p > series_len)
+			return false;
+/* Use repeated multiplication for a small non-negative integer power of a series without a constant term. */
+		if ((t = (double *) malloc(series_len * sizeof(double))) == NULL)
+			return false;
+		for (i = 0; i < series_len; i++)
+			r[i] = 0.0;
+		r[0] = 1.0;
+		for (; p > 0.0; p -= 1.0) {
+			blt(t, r, series_len * sizeof(double));
+			series_times(r, t, a);
+		}
+		free(t);
+		return true;
+	}
+/* J.C.P. Miller's recurrence for powers of a power series: */
+	r[0] = pow(a[0], p);
+	for (i = 1; i < series_len; i++) {
+		d = 0.0;
+		for (j = 1; j <= i; j++)
+			d += ((p + 1.0) * j - i) * a[j] * r[i-j];
+		r[i] = d / (i * a[0]);
+	}
+	return true;
+}
+
+/*
+ * Raise series a to the power of series b, putting the result in a.
+ *
+ * Return false if the result is not a real power series.
+ */
+static int
+series_raise(a, b)
+double	*a, *b;
+{
+	int	i;
+	int	rv = false;
+	double	*t1, *t2;
+
+	if ((t1 = (double *) malloc(2 * series_len * sizeof(double))) == NULL)
+		return false;
+	t2 = &t1[series_len];
+	for (i = 1; i < series_len; i++) {
+		if (b[i] != 0.0)
+			break;
+	}
+	if (i >= series_len) {
+		rv = series_power(t1, a, b[0]);
+	} else if (series_log(t2, a)) {
+		series_times(t1, t2, b);
+		series_exp(t2, t1);
+		blt(t1, t2, series_len * sizeof(double));
+		rv = true;
+	}
+	if (rv)
+		blt(a, t1, series_len * sizeof(double));
+	free(t1);
+	return rv;
+}
+
+/*
+ * Recursively compute the truncated power series of the expression in p1 starting at "loc".
+ * The current level of parentheses is "level".
+ * The result is stored in r, which must have room for series_len coefficients.
+ *
+ * Return true if successful.
+ * Return false if the expression has no real power series at the expansion point,
+ * or contains anything other than the expansion variable, constants, and the operators
+ * + - * / and ^.
+ */
+static int
+series_recurse(p1, n, loc, level, r)
+token_type	*p1;
+int		n, loc, level;
+double		*r;
+{
+	int	i, j;
+	int	op, last_op;
+	int	rv = false;
+	double	*t1, *t2;
+
+	if (p1[loc].level < level) {
+		for (i = 0; i < series_len; i++)
+			r[i] = 0.0;
+		switch (p1[loc].kind) {
+		case CONSTANT:
+			r[0] = p1[loc].token.constant;
+			return true;
+		case VARIABLE:
+			if (p1[loc].token.variable == series_v) {
+				r[0] = series_point;
+				if (series_len > 1)
+					r[1] = 1.0;
+				return true;
+			}
+			return var_is_const(p1[loc].token.variable, &r[0]);
+		default:
+			return false;
+		}
+	}
+	if ((t1 = (double *) malloc(2 * series_len * sizeof(double))) == NULL)
+		return false;
+	t2 = &t1[series_len];
+	if (!series_recurse(p1, n, loc, level + 1, r))
+		goto done;
+	last_op = 0;
+	for (i = loc + 1; i < n && p1[i].level >= level; i += 2) {
+		if (p1[i].level != level)
+			continue;
+		op = p1[i].token.operatr;
+		if (last_op && ((op == PLUS || op == MINUS) != (last_op == PLUS || last_op == MINUS)
+		    || op == POWER || last_op == POWER)) {
+			goto done;	/* unparenthesized operators of different precedence */
+		}
+		last_op = op;
+		if (!series_recurse(p1, n, i + 1, level + 1, t1))
+			goto done;
+		switch (op) {
+		case PLUS:
+			for (j = 0; j < series_len; j++)
+				r[j] += t1[j];
+			break;
+		case MINUS:
+			for (j = 0; j < series_len; j++)
+				r[j] -= t1[j];
+			break;
+		case TIMES:
+			series_times(t2, r, t1);
+			blt(r, t2, series_len * sizeof(double));
+			break;
+		case DIVIDE:
+			if (!series_divide(t2, r, t1))
+				goto done;
+			blt(r, t2, series_len * sizeof(double));
+			break;
+		case POWER:
+			if (!series_raise(r, t1))
+				goto done;
+			break;
+		default:
+			goto done;
+		}
+	}
+	for (j = 0; j < series_len; j++) {
+		if (!isfinite(r[j]))
+			goto done;
+	}
+	rv = true;
+done:
+	free(t1);
+	return rv;
+}
+
+/*
+ * Compute the Taylor series of order "order" of expression "source" in variable v
+ * around "point", using truncated power series arithmetic.
+ * The expansion point must evaluate to a real constant.
+ *
+ * Return true with the series in dest and *np if successful,
+ * return false if the expression has no real power series at the point
+ * or cannot be computed this way.
+ */
+static int
+taylor_series(source, n, v, point, n_point, order, dest, np)
+token_type	*source;	/* expression to expand */
+int		n;		/* length of source */
+long		v;		/* expansion variable */
+token_type	*point;		/* expansion point expression */
+int		n_point;	/* length of point */
+long		order;		/* order of the series */
+token_type	*dest;		/* where to store the result, must be an equation side */
+int		*np;		/* pointer to returned length of dest */
+{
+	int	i, j, k;
+	int	n1, level;
+	double	*coef;
+	int	rv;
+
+	if (order < 0 || order >= n_tokens || !get_constant(point, n_point, &series_point) || !isfinite(series_point))
+		return false;
+	series_len = order + 1;
+	series_v = v;
+	if ((coef = (double *) malloc(series_len * sizeof(double))) == NULL)
+		return false;
+	rv = series_recurse(source, n, 0, 1, coef);
+	if (rv) {
+		n1 = 0;
+		for (k = 0; k < series_len; k++) {
+			if (coef[k] == 0.0)
+				continue;
+			if (n1 + 8 + n_point > n_tokens) {
+				free(coef);
+				error_huge();
+			}
+			if (n1 > 0) {
+				dest[n1].level = 1;
+				dest[n1].kind = OPERATOR;
+				dest[n1].token.operatr = PLUS;
+				n1++;
+			}
+			dest[n1].level = (k == 0) ? 1 : 2;
+			dest[n1].kind = CONSTANT;
+			dest[n1].token.constant = coef[k];
+			n1++;
+			if (k == 0)
+				continue;
+			level = (k == 1) ? 3 : 4;
+			dest[n1].level = 2;
+			dest[n1].kind = OPERATOR;
+			dest[n1].token.operatr = TIMES;
+			n1++;
+			dest[n1].level = level;
+			dest[n1].kind = VARIABLE;
+			dest[n1].token.variable = v;
+			n1++;
+			dest[n1].level = level;
+			dest[n1].kind = OPERATOR;
+			dest[n1].token.operatr = MINUS;
+			n1++;
+			j = n1;
+			blt(&dest[n1], point, n_point * sizeof(token_type));
+			n1 += n_point;
+			for (i = j; i < n1; i++)
+				dest[i].level += level;
+			if (k == 1)
+				continue;
+			dest[n1].level = 3;
+			dest[n1].kind = OPERATOR;
+			dest[n1].token.operatr = POWER;
+			n1++;
+			dest[n1].level = 3;
+			dest[n1].kind = CONSTANT;
+			dest[n1].token.constant = k;
+			n1++;
+		}
+		if (n1 == 0) {
+			dest[0] = zero_token;
+			n1 = 1;
+		}
+		*np = n1;
+	}
+	free(coef);
+	return rv;
+}
+
 /*
  * The taylor command.
  */
@@ -539,15 +1184,22 @@ char	*cp;
 	int		our_nlhs, our_nrhs;
 	token_type	*ep, *source, *dest;
 	int		n1, *nps, *np;
-	int		simplify_flag = true;
+	int		simplify_flag = true, series_flag = false;
 
 	cp_start = cp;
 	if (current_not_defined()) {
 		return false;
 	}
-	if (strcmp_tospace(cp, "nosimplify") == 0) {
-		simplify_flag = false;
-		cp = skip_param(cp);
+	for (;; cp = skip_param(cp)) {
+		if (strcmp_tospace(cp, "nosimplify") == 0) {
+			simplify_flag = false;
+			continue;
+		}
+		if (strcmp_tospace(cp, "series") == 0) {
+			series_flag = true;
+			continue;
+		}
+		break;
 	}
 	i = next_espace();
 	blt(lhs[i], lhs[cur_equation], n_lhs[cur_equation] * sizeof(token_type));
@@ -597,11 +1249,13 @@ char	*cp;
 	}
 	blt(rhs[our], source, *nps * sizeof(token_type));
 	our_nrhs = *nps;
+	if (!series_flag) {
 /* Simplify and take the first derivative: */
-	uf_simp(rhs[our], &our_nrhs);
-	if (!differentiate(rhs[our], &our_nrhs, v)) {
-		error(_("Differentiation failed."));
-		return false;
+		uf_simp(rhs[our], &our_nrhs);
+		if (!differentiate(rhs[our], &our_nrhs, v)) {
+			error(_("Differentiation failed."));
+			return false;
+		}
 	}
 	if (*cp) {
 		input_column += (cp - cp_start);
@@ -643,11 +1297,39 @@ char	*cp;
 	if (n_rhs[cur_equation]) {
 		fprintf(gfp, _(" of the RHS"));
 	}
+	if (series_flag) {
+		fprintf(gfp, _(" using power series arithmetic"));
+	}
 	if (simplify_flag) {
 		fprintf(gfp, _(" and simplifying"));
 	}
 	fprintf(gfp, "...\n");
 #endif
+	if (series_flag) {
+		if (order < (LONG_MAX - 1L) && taylor_series(source, *nps, v, lhs[our], our_nlhs, order, dest, &n1)) {
+			if (simplify_flag) {
+				uf_simp(dest, &n1);
+			}
+			side_debug(1, dest, n1);
+			if (exp_contains_infinity(dest, n1)) {
+				error(_("Result invalid because it contains infinity or NaN."));
+				return false;
+			}
+#if	!SILENT
+			fprintf(gfp, _("Order %ld truncated power series computed.\n"), order);
+#endif
+			goto finish;
+		}
+#if	!SILENT
+		fprintf(gfp, _("Power series arithmetic not possible here, taking derivatives instead...\n"));
+#endif
+/* Fall back to the symbolic method: simplify and take the first derivative. */
+		uf_simp(rhs[our], &our_nrhs);
+		if (!differentiate(rhs[our], &our_nrhs, v)) {
+			error(_("Differentiation failed."));
+			return false;
+		}
+	}
 	n = 0;
 	i1 = 0;
 	blt(dest, source, *nps * sizeof(token_type));
@@ -748,6 +1430,7 @@ loop_again:
 #if	!SILENT
 	fprintf(gfp, _("%ld derivative%s applied.\n"), n, (n == 1) ? "" : "s");
 #endif
+finish:
 	if (n_rhs[cur_equation]) {
 		n_lhs[i] = n_lhs[cur_equation];
 	}
@@ -756,6 +1439,275 @@ loop_again:
 	return return_result(cur_equation);
 }
 
+#define	LIMIT_POINTS	24	/* number of points in the sequence approaching the limit point, for "limit numeric" */
+#define	LIMIT_TOLERANCE	1e-7	/* maximum relative estimated error of a numeric limit */
+
+/*
+ * Estimate the limit of the sequence s[0..n-1] by Richardson extrapolation,
+ * assuming the error is a power series in a step size that is halved each time.
+ * Like Ridders' method, the estimate with the smallest estimated error in the whole
+ * extrapolation table is used, and extrapolation stops when roundoff makes things worse.
+ *
+ * Return the estimate, with its estimated error in "*errp".
+ */
+static double
+richardson(s, n, errp)
+double	*s;	/* the sequence */
+int	n;	/* length of the sequence */
+double	*errp;	/* estimated error return */
+{
+	double	t[LIMIT_POINTS][LIMIT_POINTS];
+	double	fac, errt, est;
+	int	i, j;
+
+	est = s[n-1];
+	*errp = INFINITY;
+	for (i = 0; i < n; i++) {
+		t[i][0] = s[i];
+		fac = 1.0;
+		for (j = 1; j <= i; j++) {
+			fac *= 2.0;
+			t[i][j] = t[i][j-1] + (t[i][j-1] - t[i-1][j-1]) / (fac - 1.0);
+			errt = max(fabs(t[i][j] - t[i][j-1]), fabs(t[i][j] - t[i-1][j-1]));
+			if (errt <= *errp) {
+				*errp = errt;
+				est = t[i][j];
+			}
+		}
+		if (i > 0 && fabs(t[i][i] - t[i-1][i-1]) >= 2.0 * *errp)
+			break;
+	}
+	return est;
+}
+
+/*
+ * Estimate the limit of the sequence s[0..n-1] with Wynn's epsilon algorithm,
+ * which also handles errors that aren't a power series in the step size.
+ *
+ * Return the estimate, with its estimated error in "*errp".
+ */
+static double
+wynn_epsilon(s, n, errp)
+double	*s;	/* the sequence */
+int	n;	/* length of the sequence */
+double	*errp;	/* estimated error return */
+{
+	double	e[LIMIT_POINTS+1][LIMIT_POINTS];	/* e[j+1][k] is column j of the epsilon table */
+	double	d1, d2, errt, est;
+	int	j, k;
+
+	est = s[n-1];
+	*errp = INFINITY;
+	for (k = 0; k < n; k++) {
+		e[0][k] = 0.0;
+		e[1][k] = s[k];
+	}
+	for (j = 1; j < n; j++) {
+		for (k = 0; k < n - j; k++) {
+			e[j+1][k] = e[j-1][k+1] + 1.0 / (e[j][k+1] - e[j][k]);
+		}
+		if ((j & 1) == 0) {
+			/* even columns are estimates of the limit */
+			for (k = 1; k < n - j; k++) {
+				d1 = fabs(e[j+1][k] - e[j+1][k-1]);
+				d2 = fabs(e[j+1][k] - e[j-1][k+1]);
+				if (!isfinite(d1) || !isfinite(d2))
+					continue;	/* the table broke down here */
+				errt = max(d1, d2);
+				if (errt <= *errp) {
+					*errp = errt;
+					est = e[j+1][k];
+				}
+			}
+		}
+	}
+	return est;
+}
+
+/*
+ * Numerically estimate the one-sided limit of DAG node "x" as variable "v" goes to "a"
+ * from direction "dir" (1 for above, -1 for below), or to "a" = +/- infinity.
+ * The node is evaluated along a geometric sequence approaching the limit point,
+ * which is then extrapolated.
+ *
+ * Return false if the expression can't be evaluated near the limit point.
+ * Otherwise return true, with the estimate in "*estp" (infinity if the sequence diverges)
+ * and its estimated error in "*errp", which is INFINITY if the sequence didn't converge.
+ */
+static int
+limit_side(x, v, a, dir, estp, errp, methodp)
+int	x;		/* DAG node */
+long	v;		/* limit variable */
+double	a;		/* limit point */
+int	dir;		/* direction of approach */
+double	*estp, *errp;	/* estimate and estimated error return */
+char	**methodp;	/* name of the extrapolation method used return */
+{
+	double	s[LIMIT_POINTS];
+	double	h, est2, err2;
+	int	i, n, n_all;
+
+	h = isfinite(a) ? max(1.0, fabs(a)) / 8.0 : 8.0;
+	for (n = 0; n < LIMIT_POINTS; n++) {
+		if (isfinite(a)) {
+			s[n] = dag_eval(x, v, a + dir * h);
+			h /= 2.0;
+		} else {
+			s[n] = dag_eval(x, v, (a > 0.0) ? h : -h);
+			h *= 2.0;
+		}
+		if (!isfinite(s[n]))
+			break;
+	}
+#if	!SILENT
+	if (debug_level >= 1) {
+		if (isfinite(a)) {
+			fprintf(gfp, _("Sequence approaching the limit from %s:\n"), (dir > 0) ? _("above") : _("below"));
+		} else {
+			fprintf(gfp, _("Sequence approaching the limit:\n"));
+		}
+		for (i = 0; i < n; i++) {
+			fprintf(gfp, "%.*g\n", precision, s[i]);
+		}
+	}
+#endif
+	if (n < 3)
+		return false;
+/* drop the points where roundoff error takes over, the differences stop shrinking steadily there: */
+	n_all = n;
+	for (i = 2; i < n - 1; i++) {
+		if (fabs(s[i+1] - s[i]) >= fabs(s[i] - s[i-1]) || (s[i+1] - s[i]) * (s[i] - s[i-1]) < 0.0) {
+			n = i + 1;
+			break;
+		}
+	}
+	*estp = richardson(s, n, errp);
+	*methodp = _("Richardson");
+	est2 = wynn_epsilon(s, n, &err2);
+	if (err2 < *errp) {
+		*estp = est2;
+		*errp = err2;
+		*methodp = _("Wynn epsilon");
+	}
+	if (*errp <= LIMIT_TOLERANCE * max(1.0, fabs(*estp))) {
+/* round off the digits that are probably noise, since the error estimate is usually optimistic: */
+		h = pow(10.0, ceil(log10(10.0 * max(*errp, 1e-13 * max(1.0, fabs(*estp))))));
+		*estp = h * my_round(*estp / h);
+		return true;
+	}
+/* didn't converge, see if the sequence is going to infinity: */
+	for (i = n_all - 8; i > 0 && i < n_all; i++) {
+		if (s[i] * s[i-1] <= 0.0 || fabs(s[i]) < 1.1 * fabs(s[i-1]))
+			break;
+	}
+	if (i == n_all) {
+		*estp = (s[n_all-1] > 0.0) ? INFINITY : -INFINITY;
+		*errp = 0.0;
+		*methodp = _("a diverging sequence");
+		return true;
+	}
+	*errp = INFINITY;
+	return true;
+}
+
+/*
+ * Numerically take the limit of the RHS of the current equation as "v" goes to the
+ * constant expression in tes[], placing the result in equation space "i".
+ * This is much faster than symbolic limit taking, since there is no simplification,
+ * and works on many more expressions, but it is approximate.
+ *
+ * Return true if successful.
+ */
+static int
+limit_numeric(i, v)
+int	i;	/* result equation space */
+long	v;	/* limit variable */
+{
+	int	j, x;
+	int	above_ok, below_ok = false;
+	double	a, est, err, est2 = 0.0, err2 = 0.0;
+	char	*method, *method2 = NULL;
+
+	subst_constants(tes, &n_tes);
+	simp_loop(tes, &n_tes);
+	if (n_tes != 1 || tes[0].kind != CONSTANT || isnan(tes[0].token.constant)) {
+		error(_("The limit point must be a real number or infinity for a numeric limit."));
+		return false;
+	}
+	a = tes[0].token.constant;
+	n_trhs = n_rhs[cur_equation];
+	blt(trhs, rhs[cur_equation], n_trhs * sizeof(token_type));
+	subst_constants(trhs, &n_trhs);
+	for (j = 0; j < n_trhs; j += 2) {
+		if (trhs[j].kind == VARIABLE && trhs[j].token.variable != v) {
+			error(_("All variables other than the limit variable must be eliminated for a numeric limit."));
+			return false;
+		}
+	}
+	organize(trhs, &n_trhs);
+	dag_clear();
+	if ((x = dag_build(trhs, n_trhs)) < 0) {
+		error(_("Expression can't be evaluated numerically."));
+		return false;
+	}
+	above_ok = limit_side(x, v, a, (a == -INFINITY) ? -1 : 1, &est, &err, &method);
+	if (isfinite(a)) {
+		below_ok = limit_side(x, v, a, -1, &est2, &err2, &method2);
+	}
+	if (!above_ok) {
+		if (!below_ok) {
+			error(_("Expression can't be evaluated near the limit point."));
+			return false;
+		}
+		est = est2;
+		err = err2;
+		method = method2;
+		below_ok = false;
+	}
+	if (!isfinite(err) || (below_ok && !isfinite(err2))) {
+		error(_("Numeric limit did not converge; the limit might not exist."));
+		return false;
+	}
+	if (below_ok) {
+		if (isinf(est) || isinf(est2)) {
+			j = (est != est2);
+		} else {
+			j = (fabs(est - est2) > err + err2 + LIMIT_TOLERANCE * max(1.0, max(fabs(est), fabs(est2))));
+		}
+		if (j) {
+#if	!SILENT
+			fprintf(gfp, _("Limit from below is %.*g, limit from above is %.*g.\n"), precision, est2, precision, est);
+#endif
+			error(_("The one-sided limits differ, so the limit does not exist."));
+			return false;
+		}
+		if (err2 < err) {
+			est = est2;
+			err = err2;
+			method = method2;
+		}
+	}
+#if	!SILENT
+	if (debug_level >= 0) {
+		fprintf(gfp, _("Numeric limit found by %s"), method);
+		if (isfinite(a) && !below_ok) {
+			fprintf(gfp, _(" from %s only"), above_ok ? _("above") : _("below"));
+		}
+		if (isfinite(est)) {
+			fprintf(gfp, _(", estimated error %.3g"), err);
+		}
+		fprintf(gfp, ".\n");
+	}
+#endif
+	blt(lhs[i], lhs[cur_equation], n_lhs[cur_equation] * sizeof(token_type));
+	n_lhs[i] = n_lhs[cur_equation];
+	rhs[i][0].level = 1;
+	rhs[i][0].kind = CONSTANT;
+	rhs[i][0].token.constant = est;
+	n_rhs[i] = 1;
+	return return_result(i);
+}
+
 /*
  * The limit command.
  */
@@ -767,12 +1719,17 @@ char	*cp;
 	long		v = 0;			/* Mathomatic variable */
 	token_type	solved_v, want;
 	char		*cp_start;
+	int		numeric_flag;
 
 	cp_start = cp;
 	if (current_not_defined()) {
 		return false;
 	}
 	i = next_espace();
+	numeric_flag = (strcmp_tospace(cp, "numeric") == 0);
+	if (numeric_flag) {
+		cp = skip_param(cp);
+	}
 	if (n_rhs[cur_equation] == 0) {
 /* make expression into an equation: */
 		blt(rhs[cur_equation], lhs[cur_equation], n_lhs[cur_equation] * sizeof(token_type));
@@ -834,6 +1791,9 @@ char	*cp;
 		fprintf(gfp, "\n");
 	}
 #endif
+	if (numeric_flag) {
+		return limit_numeric(i, v);
+	}
 /* copy the current equation to a new equation space, then simplify and work on the copy: */
 	copy_espace(cur_equation, i);
 	simpa_side(rhs[i], &n_rhs[i], false, false);
@@ -53,10 +53,12 @@ extern int		fractions_display;
 extern int		approximate_roots;
 extern int		preserve_surds;
 extern int		rationalize_denominators;
+extern int		exact_integers;
 extern int		modulus_mode;
 extern volatile int	screen_columns;
 extern volatile int	screen_rows;
 extern int		finance_option;
+extern int		max_solve_steps;
 extern int		autosolve;
 extern int		autocalc;
 extern int		autodelete;
@@ -105,7 +107,17 @@ extern double		unique[];
 extern int		ucnt[];
 extern int		uno;
 
+extern long		factor_cache_lookups;
+extern long		factor_cache_hits;
+extern long		gcd_cache_lookups;
+extern long		gcd_cache_hits;
+extern long		fraction_cache_lookups;
+extern long		fraction_cache_hits;
+extern long		poly_index_lookups;
+extern long		poly_index_hits;
+
 extern sign_array_type	sign_array;
+extern int		sign_array_stale;
 extern FILE		*default_out;
 extern FILE		*gfp;
 extern char		*gfp_filename;
@@ -126,8 +138,7 @@ extern int		point_flag;
 
 extern char		*result_str;
 extern int		result_en;
+extern int		no_result_str;
 extern const char	*error_str;
 extern const char	*warning_str;
 
-extern char		*vscreen[TEXT_ROWS];
-extern int		current_columns;
@@ -38,9 +38,22 @@ static double skip_multiples[] = {	/* Additive array that skips over multiples o
 	 2, 6, 4, 2, 4, 2,10, 2
 };	/* sum of all numbers = 210 = (2*3*5*7) */
 
+/* Bounded, direct-mapped cache of previous factor_one() results, indexed by value: */
+#define	MAX_CACHED_FACTORS	16	/* 16 is more than the number of unique factors of any integer below MAX_K_INTEGER */
+
+typedef struct {
+	double	value;				/* the factored integer */
+	int	uno;				/* number of unique factors, 0 if this entry is unused */
+	double	unique[MAX_CACHED_FACTORS];	/* the unique prime factors */
+	int	ucnt[MAX_CACHED_FACTORS];	/* number of times each factor occurs */
+} factor_cache_type;
+
+static factor_cache_type factor_cache[INT_CACHE_SIZE];
+
 /*
  * Factor the integer in "value".
  * Store the prime factors in the unique[] array.
+ * Previous results are remembered in factor_cache[].
  *
  * Return true if successful.
  */
@@ -48,8 +61,9 @@ int
 factor_one(value)
 double	value;
 {
-	int	i;
-	double	d;
+	int			i;
+	double			d;
+	factor_cache_type	*fcp;
 
 	uno = 0;
 	nn = value;
@@ -64,6 +78,17 @@ double	value;
 		/* not an integer */
 		return false;
 	}
+	fcp = &factor_cache[int_cache_index(value, 0.0)];
+	factor_cache_lookups++;
+	if (fcp->uno > 0 && fcp->value == value) {
+		factor_cache_hits++;
+		uno = fcp->uno;
+		for (i = 0; i < uno; i++) {
+			unique[i] = fcp->unique[i];
+			ucnt[i] = fcp->ucnt[i];
+		}
+		return true;
+	}
 	sqrt_value = 1.0 + sqrt(fabs(nn));
 	try_factor(2.0);
 	try_factor(3.0);
@@ -88,6 +113,14 @@ double	value;
 	if (nn != 1.0 || value != multiply_out_unique()) {
 		error_bug("Internal error factoring integers.");
 	}
+	if (uno <= MAX_CACHED_FACTORS) {
+		fcp->value = value;
+		fcp->uno = uno;
+		for (i = 0; i < uno; i++) {
+			fcp->unique[i] = unique[i];
+			fcp->ucnt[i] = ucnt[i];
+		}
+	}
 	return true;
 }
 
@@ -29,6 +29,37 @@ George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
 
 #include "includes.h"
 
+static int f_to_fraction_sub(double d, double *numeratorp, double *denominatorp);
+
+#if	ULONG_MAX > 0xffffffffUL
+/*
+ * Integer Euclidean GCD, used by gcd() when both operands are exact integers
+ * that fit in an unsigned long.
+ * Uses exactly the same termination rules as the floating point loop in gcd(),
+ * so the results are identical, it is just faster than calling fmod(3).
+ */
+static double
+integer_gcd(larger, divisor, lower_limit)
+unsigned long	larger, divisor;
+double		lower_limit;
+{
+	int		count;
+	unsigned long	remainder1;
+
+	for (count = 1; count < 50; count++) {
+		remainder1 = larger % divisor;
+		if (remainder1 <= lower_limit || (divisor - remainder1) <= lower_limit) {
+			if (remainder1 != 0 && divisor <= (100.0 * lower_limit))
+				return 0.0;
+			return (double) divisor;
+		}
+		larger = divisor;
+		divisor = remainder1;
+	}
+	return 0.0;
+}
+#endif
+
 /*
  * Floating point GCD function.
  *
@@ -38,6 +69,7 @@ George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
  * The GCD is defined as the largest positive number that evenly divides both d1 and d2.
  * This should always works perfectly and exactly with two integers up to MAX_K_INTEGER.
  * Will usually work with non-integers, but there may be some floating point error.
+ * Exact integer operands are handled quickly by integer_gcd().
  *
  * Returns 0 on failure, otherwise returns the positive GCD.
  */
@@ -70,6 +102,11 @@ double	d1, d2;
 	if (divisor <= lower_limit || larger >= MAX_K_INTEGER) {
 		return 0.0;	/* out of range, result would be too inaccurate */
 	}
+#if	ULONG_MAX > 0xffffffffUL
+	if ((double) (unsigned long) larger == larger && (double) (unsigned long) divisor == divisor) {
+		return integer_gcd((unsigned long) larger, (unsigned long) divisor, lower_limit);
+	}
+#endif
 	for (count = 1; count < 50; count++) {
 		remainder1 = fabs(fmod(larger, divisor));
 		if (remainder1 <= lower_limit || fabs(divisor - remainder1) <= lower_limit) {
@@ -83,6 +120,28 @@ double	d1, d2;
 	return 0.0;
 }
 
+/* Bounded, direct-mapped cache of previous gcd_verified() results: */
+static struct {
+	double	larger;		/* absolute value of the larger operand, 0 if this entry is unused */
+	double	smaller;	/* absolute value of the smaller operand */
+	double	result;		/* the verified GCD of the two operands */
+} gcd_cache[INT_CACHE_SIZE];
+
+/*
+ * Return the index into a result cache of INT_CACHE_SIZE entries
+ * for the finite operands d1 and d2.
+ * The multipliers spread out the fractional parts of non-integers, too.
+ */
+int
+int_cache_index(d1, d2)
+double	d1, d2;
+{
+	double	d;
+
+	d = fmod(fabs(d1), (double) INT_CACHE_SIZE) * 65599.0 + fmod(fabs(d2), (double) INT_CACHE_SIZE) * 31.0;
+	return((int) fmod(d, (double) INT_CACHE_SIZE));
+}
+
 /*
  * Verified floating point GCD function.
  *
@@ -90,21 +149,50 @@ double	d1, d2;
  *
  * Returns 0 on failure or inexactness, otherwise returns the verified positive GCD result.
  * Result is not necessarily integer unless both d1 and d2 are integer.
+ *
+ * Results are remembered in gcd_cache[], because the same coefficients
+ * are usually compared over and over during simplification.
  */
 double
 gcd_verified(d1, d2)
 double	d1, d2;
 {
 	double	divisor, d3, d4;
+	double	larger, smaller = 0.0;
+	int	i = 0;
 
+	if (isfinite(d1) && isfinite(d2)) {
+		larger = fabs(d1);
+		smaller = fabs(d2);
+		if (larger < smaller) {
+			larger = smaller;
+			smaller = fabs(d1);
+		}
+		if (larger != 0.0) {
+			i = int_cache_index(larger, smaller);
+			gcd_cache_lookups++;
+			if (gcd_cache[i].larger == larger && gcd_cache[i].smaller == smaller) {
+				gcd_cache_hits++;
+				return gcd_cache[i].result;
+			}
+		}
+	} else {
+		larger = 0.0;
+	}
 	divisor = gcd(d1, d2);
 	if (divisor != 0.0) {
 		d3 = d1 / divisor;
 		d4 = d2 / divisor;
-		if (fmod(d3, 1.0) != 0.0 || fmod(d4, 1.0) != 0.0)
-			return 0.0;
-		if (gcd(d3, d4) != 1.0)
-			return 0.0;
+		if (fmod(d3, 1.0) != 0.0 || fmod(d4, 1.0) != 0.0) {
+			divisor = 0.0;
+		} else if (gcd(d3, d4) != 1.0) {
+			divisor = 0.0;
+		}
+	}
+	if (larger != 0.0) {
+		gcd_cache[i].larger = larger;
+		gcd_cache[i].smaller = smaller;
+		gcd_cache[i].result = divisor;
 	}
 	return divisor;
 }
@@ -126,6 +214,14 @@ double	d1;	/* value to round */
 	return d1;
 }
 
+/* Bounded, direct-mapped cache of previous f_to_fraction() results for non-integers: */
+static struct {
+	double	d;		/* the converted value, 0 if this entry is unused */
+	int	rv;		/* the return value of f_to_fraction() */
+	double	numerator;	/* the returned numerator */
+	double	denominator;	/* the returned denominator */
+} fraction_cache[INT_CACHE_SIZE];
+
 /*
  * Convert the passed double d to an equivalent fully reduced fraction.
  * This done by the following simple algorithm:
@@ -139,6 +235,7 @@ double	d1;	/* value to round */
  * Otherwise returns false with numerator = d and denominator = 1.0
  *
  * True return indicates d is rational and finite, otherwise d is probably irrational.
+ * Results for non-integers are remembered in fraction_cache[].
  */
 int
 f_to_fraction(d, numeratorp, denominatorp)
@@ -146,9 +243,7 @@ double	d;		/* floating point number to convert */
 double	*numeratorp;	/* returned numerator */
 double	*denominatorp;	/* returned denominator */
 {
-	double	divisor;
-	double	numerator, denominator;
-	double	k3, k4;
+	int	i, rv;
 
 	*numeratorp = d;
 	*denominatorp = 1.0;
@@ -159,6 +254,35 @@ double	*denominatorp;	/* returned denominator */
 	if (fmod(d, 1.0) == 0.0) {
 		return true;
 	}
+	i = int_cache_index(d, 0.0);
+	fraction_cache_lookups++;
+	if (fraction_cache[i].d == d) {
+		fraction_cache_hits++;
+		*numeratorp = fraction_cache[i].numerator;
+		*denominatorp = fraction_cache[i].denominator;
+		return fraction_cache[i].rv;
+	}
+	rv = f_to_fraction_sub(d, numeratorp, denominatorp);
+	fraction_cache[i].d = d;
+	fraction_cache[i].rv = rv;
+	fraction_cache[i].numerator = *numeratorp;
+	fraction_cache[i].denominator = *denominatorp;
+	return rv;
+}
+
+/*
+ * The uncached part of f_to_fraction(), for non-integer, finite values of d.
+ */
+static int
+f_to_fraction_sub(d, numeratorp, denominatorp)
+double	d;		/* floating point number to convert */
+double	*numeratorp;	/* returned numerator */
+double	*denominatorp;	/* returned denominator */
+{
+	double	divisor;
+	double	numerator, denominator;
+	double	k3, k4;
+
 	k3 = fabs(d) * small_epsilon;
 	k4 = my_round(d);
 	if (k4 != 0.0 && fabs(k4 - d) <= k3) {
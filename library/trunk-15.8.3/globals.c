@@ -64,10 +64,12 @@ int		display2d = true;			/* "set display2d" flag for 2D display */
 int		fractions_display = 1;			/* "set fraction" mode */
 int		preserve_surds = true;			/* set option to preserve roots like (2^.5) */
 int		rationalize_denominators = true;	/* try to rationalize denominators if true */
+int		exact_integers;				/* "set exact_integers" for exact arithmetic on large integer constants */
 int		modulus_mode = 2;				/* true for mathematically correct modulus */
 volatile int	screen_columns = STANDARD_SCREEN_COLUMNS;	/* screen width of the terminal; 0 = infinite */
 volatile int	screen_rows = STANDARD_SCREEN_ROWS;		/* screen height of the terminal; 0 = infinite */
 int		finance_option;				/* for displaying dollars and cents */
+int		max_solve_steps = 1000;			/* "set solve_steps" limit on passes through the solve loop; 0 = no limit */
 int		autosolve = true;			/* Allows solving by typing the variable name at the main prompt */
 int		autocalc = true;			/* Allows automatically calculating a numerical expression */
 int		autodelete = true;			/* Automatically deletes the previous calculated numerical expression when a new one is entered */
@@ -126,8 +128,19 @@ double		unique[64];		/* storage for the unique prime factors */
 int		ucnt[64];		/* number of times the factor occurs */
 int		uno;			/* number of unique factors stored in unique[] */
 
+/* Statistics for the integer factorization, GCD, and fraction result caches: */
+long		factor_cache_lookups;	/* number of factor_one() calls that looked in the cache */
+long		factor_cache_hits;	/* number of those lookups that were found in the cache */
+long		gcd_cache_lookups;	/* number of gcd_verified() calls that looked in the cache */
+long		gcd_cache_hits;		/* number of those lookups that were found in the cache */
+long		fraction_cache_lookups;	/* number of f_to_fraction() calls that looked in the cache */
+long		fraction_cache_hits;	/* number of those lookups that were found in the cache */
+long		poly_index_lookups;	/* number of times a polynomial index was asked for */
+long		poly_index_hits;	/* number of those times the expression was already indexed */
+
 /* misc. variables */
 sign_array_type	sign_array;		/* for keeping track of unique "sign" variables */
+int		sign_array_stale;	/* true if the sign variables in the equation spaces are not yet in sign_array[] */
 FILE		*default_out;		/* file pointer where all gfp output goes by default */
 FILE		*gfp;			/* global output file pointer, for dynamically redirecting Mathomatic output */
 char		*gfp_filename;		/* filename associated with gfp if redirection is happening */
@@ -158,9 +171,6 @@ int		point_flag;		/* point to location of parse error if true */
 /* library variables go here */
 char		*result_str;		/* returned result text string when using as library */
 int		result_en = -1;		/* equation number of the returned result, if stored in an equation space */
+int		no_result_str;		/* if true, return_result() only sets result_en, for the handle API */
 const char	*error_str;		/* last error string */
 const char	*warning_str;		/* last warning string */
-
-/* Screen character array, for buffering page-at-a-time string output: */
-char		*vscreen[TEXT_ROWS];
-int		current_columns;
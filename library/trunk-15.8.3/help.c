@@ -59,6 +59,7 @@ typedef	struct {
 
 /*
  * The Mathomatic command table follows.  It should be in alphabetical order.
+ * Commands are looked up through com_index[] below, built from this table.
  */
 static com_type com_list[] = {
 /*	command name,	alternate name,		function,		usage,							information */
@@ -67,17 +68,17 @@ static com_type com_list[] = {
 {	"calculate",	NULL,			calculate_cmd,		"[\"factor\"] [equation-number-range] [variable iterations]",	"Temporarily plug in values for variables and approximate.", "This command may be preceded with \"repeat\"." },
 #endif
 {	"clear",	NULL,			clear_cmd,		"[equation-number-ranges]",				"Delete expressions stored in memory so equation spaces can be reused.", "Tip: Use \"clear all\" to quickly restart Mathomatic." },
-{	"code",		NULL,			code_cmd,		"[\"c\" or \"java\" or \"python\" or \"integer\"] [equation-number-ranges]",	"Output C, Java, or Python code for the specified equations.", "Related commands: simplify, optimize, and variables" },
+{	"code",		NULL,			code_cmd,		"[\"c\" or \"java\" or \"python\" or \"integer\"] [\"gradient\"] [equation-number-ranges]",	"Output C, Java, or Python code for the specified equations.", "Related commands: simplify, optimize, and variables" },
 {	"compare",	NULL,			compare_cmd,		"[\"symbolic\" \"approx\"] equation-number [\"with\" equation-number]",	"Compare two equation spaces for mathematical equivalence.", "This command may be preceded with \"repeat\"." },
 {	"copy",		NULL,			copy_cmd,		"[equation-number-ranges]",				"Duplicate the contents of the specified equation spaces." },
-{	"derivative",	"differentiate",	derivative_cmd,		"[\"nosimplify\"] variable or \"all\" [order]",		"Symbolically differentiate and simplify, order times." },
+{	"derivative",	"differentiate",	derivative_cmd,		"[\"nosimplify\" \"dag\" \"optimize\"] variable or \"all\" [order]",	"Symbolically differentiate and simplify, order times." },
 {	"display",	NULL,			display_cmd,		"[\"factor\" \"mixed\"] [equation-number-ranges]",	"Display equation spaces in pretty, 2D multi-line fraction format." },
 {	"divide",	NULL,			divide_cmd,		"[base-variable] [dividend divisor]",			"Divide 2 numbers or polynomials. Give detailed result and GCD.", "This command may be preceded with \"repeat\"." },
 {	"echo",		NULL,			echo_cmd,		"[text]",						"Output a line of text, followed by a newline.", "This command may be preceded with \"repeat\"." },
 #if	SHELL_OUT
 {	"edit",		NULL,			edit_cmd,		"[file-name]",						"Edit all equation spaces or an input file, then read them in.", "Editor name in EDITOR environment variable." },
 #endif
-{	"eliminate",	NULL,			eliminate_cmd,		"variables or \"all\" [\"using\" equation-number]",	"Substitute the specified variables with solved equations.", "This command may be preceded with \"repeat\"." },
+{	"eliminate",	NULL,			eliminate_cmd,		"variables or \"all\" [\"fewest\" or \"degree\" or \"number\"] [\"using\" equation-number]",	"Substitute the specified variables with solved equations.", "This command may be preceded with \"repeat\"." },
 {	"extrema",	NULL,			extrema_cmd,		"[variable] [order]",					"Show where the slope of the current equation equals zero.", "Helps with finding the minimums and maximums." },
 {	"factor",	"collect",		factor_cmd,		"[\"number\" [integers]] or [\"power\"] [equation-number-range] [variables]",	"Factor variables in equation spaces or factorize given integers." },
 {	"for",		NULL,			for_cmd,		"variable start end [step-size]",			"Evaluate and display the current expression for each value of variable.", "Same syntax as the sum and product commands." },
@@ -87,15 +88,17 @@ static com_type com_list[] = {
 #endif
 {	"imaginary",	NULL,			imaginary_cmd,		"[variable]",						"Copy the imaginary part of the current expression.", "Related command: real" },
 {	"integrate",	"integral",		integrate_cmd,		"[\"constant\" or \"definite\"] variable [order]",	"Symbolically integrate polynomials order times, then simplify." },
+{	"jacobian",	"gradient",		jacobian_cmd,		"[\"nosimplify\"] [equation-number-range] [variables]",	"Compute the matrix of all partial derivatives in one pass.", "Each entry is stored in a new equation space." },
 {	"laplace",	NULL,			laplace_cmd,		"[\"inverse\"] variable",				"Compute the Laplace or inverse Laplace transform of polynomials.", "This command only works with polynomials." },
-{	"limit",	NULL,			limit_cmd,		"variable expression",					"Take the limit as variable goes to expression.", "This limit command is experimental." },
-{	"list",		NULL,			list_cmd,		"[\"export\" or \"maxima\" or \"gnuplot\" or \"hex\"] [equation-number-ranges]",	"Display equation spaces in single-line (one-dimensional) format.", "Options to export expressions to other math programs." },
+{	"limit",	NULL,			limit_cmd,		"[\"numeric\"] variable expression",				"Take the limit as variable goes to expression.", "This limit command is experimental." },
+{	"list",		NULL,			list_cmd,		"[\"export\" or \"maxima\" or \"gnuplot\" or \"hex\" or \"json\"] [equation-number-ranges]",	"Display equation spaces in single-line (one-dimensional) format.", "Options to export expressions to other math programs." },
 {	"nintegrate",	NULL,			nintegrate_cmd,		"[\"trapezoid\"] variable [partitions [lower-bound upper-bound]]",	"Do numerical definite integration using Simpson's rule.", "This command cannot integrate over singularities." },
 {	"optimize",	NULL,			optimize_cmd,		"[equation-number-range]",				"Split up equations into smaller, more efficient equations." },
 {	"pause",	NULL,			pause_cmd,		"[text]",						"Display a line of text and wait for user to press the Enter key." },
 #if	SHELL_OUT
 {	"plot",		NULL,			plot_cmd,		"[equation-number-ranges] [xyz-ranges] [expressions,]",	"Automatically plot expressions in 2D or 3D with gnuplot.", "Plots variable x; if expression contains y, do a 3D surface plot." },
 #endif
+{	"polynomial",	NULL,			polynomial_cmd,		"[variable]",						"Tell what type and degree of polynomial the current expression is.", "Shows the leading coefficient for each polynomial variable." },
 {	"product",	NULL,			product_cmd,		"variable start end [step-size]",			"Compute the product as variable goes from start to end.", "Related command: sum" },
 #if	READLINE
 {	"push",		NULL,			push_cmd,		"[equation-number-ranges or text-to-push]",		"Push equation spaces or text into readline history for editing.", "Available only if readline is enabled." },
@@ -104,27 +107,76 @@ static com_type com_list[] = {
 {	"quit",		"exit",			quit_cmd,		"[exit-value]",						"Terminate this program without saving." },
 #endif
 #if	!SECURE
-{	"read",		NULL,			read_cmd,		"file-name",						"Read in a text file as if it was typed in.", "This command may be preceded with \"repeat\"." },
+{	"read",		NULL,			read_cmd,		"[\"binary\" or \"continue\"] file-name",			"Read in a text file as if it was typed in.", "\"read binary\" restores a session saved with \"save binary\"; \"read continue\" doesn't stop on errors; this command may be preceded with \"repeat\"." },
 #endif
 {	"real",		NULL,			real_cmd,		"[variable]",						"Copy the real part of the current expression.", "Related command: imaginary" },
 {	"replace",	NULL,			replace_cmd,		"[variables [\"with\" expression]]",			"Substitute variables in the current equation with expressions." },
 {	"roots",	NULL,			roots_cmd,		"root real-part imaginary-part",			"Display all the roots of a complex number.", "This command may be preceded with \"repeat\"." },
 #if	!SECURE
-{	"save",		NULL,			save_cmd,		"file-name",						"Save all equation spaces in a text file.", "Related command: read" },
+{	"save",		NULL,			save_cmd,		"[\"binary\"] file-name",					"Save all equation spaces in a text file.", "\"save binary\" saves the whole session in a quickly loaded binary file; related command: read" },
 #endif
 {	"set",		NULL,			set_cmd,		"[[\"no\"] option [value]] ...",			"Display, set, or save current session options.", "\"set\" by itself will show all current option settings." },
 {	"simplify",	NULL,			simplify_cmd,		"[\"sign\" \"symbolic\" \"quick[est]\" \"fraction\"] [equation-number-ranges]",	"Completely simplify expressions.", "This command may be preceded with \"repeat\"." },
-{	"solve",	NULL,			solve_cmd,		"[\"verify\"] [equation-number-range] [\"for\"] variable or \"0\"",	"Solve the specified equations for a variable or for zero.", "The verify option checks all displayed solutions." },
+{	"solve",	NULL,			solve_cmd,		"[\"verify\" or \"linear\"] [equation-number-range] [\"for\"] variable or \"0\"",	"Solve the specified equations for a variable or for zero.", "The verify option checks all displayed solutions; \"solve linear\" solves a system of linear equations." },
 {	"sum",		NULL,			sum_cmd,		"variable start end [step-size]",			"Compute the summation as variable goes from start to end.", "Related command: product" },
 #if	!LIBRARY
 {	"tally",	NULL,			tally_cmd,		"[\"average\"]",					"Prompt for and add entries, showing running total." },
 #endif
-{	"taylor",	NULL,			taylor_cmd,		"[\"nosimplify\"] variable order point",		"Compute the Taylor series expansion of the current expression." },
+{	"taylor",	NULL,			taylor_cmd,		"[\"nosimplify\" \"series\"] variable order point",		"Compute the Taylor series expansion of the current expression." },
 {	"unfactor",	"expand",		unfactor_cmd,		"[\"count\" \"fraction\" \"quick\" \"power\"] [equation-number-range]",	"Algebraically expand (multiply out) expressions." },
 {	"variables",	NULL,			variables_cmd,		"[\"c\" or \"java\" or \"integer\" or \"count\"] [equation-number-ranges]",	"Show all variable names used within the specified expressions.", "Related command: code" },
 {	"version",	NULL,			version_cmd,		"",							"Display Mathomatic version, compiler, and license information." }
 };
 
+/*
+ * Index of com_list[] by the first letter of the command names, a one level trie.
+ * com_index[com_start[c]] up to com_index[com_start[c+1]] are the com_list[] subscripts
+ * of the commands with either name starting with letter "c" (0 for 'a'), in table order,
+ * so the first prefix match is the same as when searching the whole table.
+ */
+static short	com_start[28];
+static short	com_index[2*ARR_CNT(com_list)];
+
+/*
+ * Return true if command function "func" never changes any equation space,
+ * or calls espace_written() itself for each equation space it changes,
+ * so the sign variables and variables indexed for the other equation spaces stay valid.
+ */
+static int
+writes_tracked(int (*func)())
+{
+	return(func == echo_cmd || func == list_cmd || func == pause_cmd || func == version_cmd
+	    || func == eliminate_cmd
+#if	HELP
+	    || func == help_cmd
+#endif
+	    );
+}
+
+/*
+ * Build com_start[] and com_index[] from com_list[], the first time this is called.
+ */
+static void
+init_com_index(void)
+{
+	static int	done = false;
+	int		i, c, c2, n = 0;
+
+	if (done)
+		return;
+	for (c = 0; c < 26; c++) {
+		com_start[c] = n;
+		for (i = 0; i < ARR_CNT(com_list); i++) {
+			c2 = com_list[i].secondary_name ? tolower(com_list[i].secondary_name[0]) : 0;
+			if (tolower(com_list[i].name[0]) == 'a' + c || c2 == 'a' + c) {
+				com_index[n++] = i;
+			}
+		}
+	}
+	com_start[26] = com_start[27] = n;
+	done = true;
+}
+
 #if	HELP && !LIBRARY
 char	*example_strings[] = {
 	"; Example 1:\n",
@@ -223,6 +275,7 @@ parse(n, cp)
 int	n;
 char	*cp;
 {
+	espace_written(n);
 	if (parse_equation(n, cp)) {
 		if (n_lhs[n] == 0 && n_rhs[n] == 0)
 			return true;
@@ -262,6 +315,7 @@ char	*cp;
 	long		answer_v = 0;		/* Mathomatic answer variable */
 #endif
 
+	espace_written(n);
 	if ((ep = parse_equation(n, cp))) {
 		for (cp1 = cp; cp1 < ep; cp1++) {
 			if (*cp1 == '=') {
@@ -273,6 +327,7 @@ char	*cp;
 			if (strcmp(cp, "=") == 0 && n_lhs[cur_equation] > 0 && n_rhs[cur_equation] > 0) {
 				debug_string(0, _("Swapping both sides of the current equation..."));
 				n = cur_equation;
+				espace_written(n);
 				i = n_lhs[n];
 				blt(tes, lhs[n], n_lhs[n] * sizeof(token_type));
 				n_lhs[n] = n_rhs[n];
@@ -289,6 +344,7 @@ char	*cp;
 				    || (lhs[n][0].kind == VARIABLE && ((lhs[n][0].token.variable & VAR_MASK) > SIGN || equals_flag))))
 				    || (n_rhs[n] == 1 && ((rhs[n][0].kind == CONSTANT && rhs[n][0].token.constant == 0.0)
 				    || rhs[n][0].kind == VARIABLE))) {
+					espace_written(-1);
 					rv = solve_espace(n, cur_equation);
 					n_lhs[n] = 0;
 					n_rhs[n] = 0;
@@ -316,6 +372,7 @@ char	*cp;
 #if	!LIBRARY
 			if (autocalc) {
 				/* the numerical input calculation */
+				espace_written(-1);
 				if (n_lhs[n]) {
 					if (!exp_is_numeric(lhs[n], n_lhs[n])) {
 						goto return_ok;		/* not numerical (contains a variable) */
@@ -395,6 +452,7 @@ char	*cp;
 	int	i;
 	int	len;
 	int	rv;
+	int	c, k;
 	char	buf2[MAX_CMD_LEN];	/* do not make this static! */
 	int	our_repeat_flag = false;
 	long	v;			/* Mathomatic variable */
@@ -408,7 +466,8 @@ char	*cp;
 	check_gvars();
 #endif
 	init_gvars();		/* make sure we are in the default state */
-	set_sign_array();	/* register all sign variables so that the next ones will be unique */
+	reset_sign_array();	/* all sign variables will be registered before the next one is made */
+	exact_collect();	/* forget exact integers no longer in any equation space */
 	if (cp == NULL) {
 		return false;
 	}
@@ -541,7 +600,12 @@ do_repeat:
 		cp = skip_space(cp1);
 		goto do_repeat;
 	}
-	for (i = 0; i < ARR_CNT(com_list); i++) {
+	init_com_index();
+	c = tolower((unsigned char) *cp) - 'a';
+	if (c < 0 || c >= 26)
+		c = 26;		/* not a letter, so the range of commands is empty */
+	for (k = com_start[c]; k < com_start[c+1]; k++) {
+		i = com_index[k];
 		if (COMPARE_COMMAND_NAME(com_list[i].name)
 		    || (com_list[i].secondary_name && COMPARE_COMMAND_NAME(com_list[i].secondary_name))) {
 			cp1 = skip_space(cp1);
@@ -589,6 +653,9 @@ do_repeat:
 #endif
 			remove_trailing_spaces(buf2);
 			pull_number = 1;
+			if (!writes_tracked(com_list[i].func)) {
+				espace_written(-1);
+			}
 /* execute the command by calling the command function */
 			show_usage = true;
 			repeat_flag = our_repeat_flag;
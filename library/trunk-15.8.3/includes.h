@@ -73,6 +73,11 @@ George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
 #include <libgen.h>
 #endif
 
+#if	!MINGW
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
 #if	sun
 #include <ieeefp.h>
 #endif
@@ -85,6 +90,7 @@ George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
+#include <time.h>
 
 #if	I18N
 #include <libintl.h>	/* Mac OS X doesn't have libintl.h, so define "char *gettext();" then. */
@@ -100,6 +106,10 @@ George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
 #include <readline/history.h>
 #endif
 
+#if	ZLIB
+#include <zlib.h>	/* for reading gzip compressed scripts */
+#endif
+
 /* Include files from the current directory: */
 #include "standard.h"	/* a standard include file for any math program written in C */
 #include "am.h"		/* the main include file for Mathomatic, contains tunable parameters */
@@ -24,9 +24,55 @@ George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
 
 #include "includes.h"
 
-static int integrate_sub(token_type *equation, int *np, int loc, int eloc, long v);
-static int laplace_sub(token_type *equation, int *np, int loc, int eloc, long v);
-static int inv_laplace_sub(token_type *equation, int *np, int loc, int eloc, long v);
+/*
+ * The shapes of a polynomial term in the variable v, as determined by term_shape().
+ * Used as the index into the rule tables below.
+ */
+#define	TERM_FREE	0	/* the term doesn't contain v */
+#define	TERM_POWER	1	/* the term is c*(v^d) */
+#define	TERM_INV_POWER	2	/* the term is c/(v^d) */
+#define	TERM_OTHER	3	/* the term is not a polynomial term in v */
+#define	N_TERM_SHAPES	4
+
+typedef struct {	/* transformation rule for one shape of polynomial term */
+	char	*name;		/* rule name for debug output */
+	int	(*func)(token_type *equation, int *np, int loc, int eloc, long v);	/* NULL if there is no rule */
+	long	hits;		/* number of terms transformed by this rule in the last int_dispatch() */
+} int_rule_type;
+
+typedef struct {	/* a term remembered by int_dispatch(), so identical terms are transformed once */
+	unsigned long	hash;	/* term_hash() of the term */
+	int		loc;	/* location of the term in the equation side */
+	int		len;	/* length of the term */
+	int		oloc;	/* location of its transformation in tes[] */
+	int		olen;	/* length of its transformation */
+} int_cache_type;
+
+static int int_dispatch(token_type *equation, int *np, long v, int_rule_type *rules);
+static int integrate_free(token_type *equation, int *np, int loc, int eloc, long v);
+static int integrate_power(token_type *equation, int *np, int loc, int eloc, long v);
+static int laplace_free(token_type *equation, int *np, int loc, int eloc, long v);
+static int laplace_power(token_type *equation, int *np, int loc, int eloc, long v);
+static int inv_laplace_power(token_type *equation, int *np, int loc, int eloc, long v);
+
+static int_rule_type	integrate_rules[N_TERM_SHAPES] = {
+	{ "constant", integrate_free },
+	{ "power", integrate_power },
+	{ "negative power", integrate_power },
+	{ NULL, NULL }
+};
+static int_rule_type	laplace_rules[N_TERM_SHAPES] = {
+	{ "constant", laplace_free },
+	{ "power", laplace_power },
+	{ NULL, NULL },
+	{ NULL, NULL }
+};
+static int_rule_type	inv_laplace_rules[N_TERM_SHAPES] = {
+	{ NULL, NULL },
+	{ NULL, NULL },
+	{ "negative power", inv_laplace_power },
+	{ NULL, NULL }
+};
 
 static int	constant_var_number = 1;	/* makes unique numbers for the constant of integration */
 
@@ -73,100 +119,262 @@ long		v;		/* Mathomatic variable */
 	}
 }
 
+/*
+ * Return the shape of the polynomial term in "p1", in the variable v.
+ */
+static int
+term_shape(p1, n, v)
+token_type	*p1;	/* term pointer */
+int		n;	/* term length */
+long		v;	/* Mathomatic variable */
+{
+	int	i;
+
+	if (!poly_in_v_sub(p1, n, v, true))
+		return TERM_OTHER;
+	for (i = 0; i < n; i += 2) {
+		if (p1[i].kind == VARIABLE && p1[i].token.variable == v) {
+			if (i > 0 && p1[i-1].token.operatr == DIVIDE)
+				return TERM_INV_POWER;
+			return TERM_POWER;
+		}
+	}
+	return TERM_FREE;
+}
+
+/*
+ * Return a hash value for the expression in "p1", for the term cache in int_dispatch().
+ */
+static unsigned long
+term_hash(p1, n)
+token_type	*p1;	/* expression pointer */
+int		n;	/* expression length */
+{
+	int		i, j;
+	unsigned long	h;
+	unsigned char	*cp;
+
+	h = n;
+	for (i = 0; i < n; i++) {
+		h = h * 31 + p1[i].kind * 7 + p1[i].level;
+		switch (p1[i].kind) {
+		case CONSTANT:
+			cp = (unsigned char *) &p1[i].token.constant;
+			for (j = 0; j < sizeof(p1[i].token.constant); j++)
+				h = h * 31 + cp[j];
+			break;
+		case VARIABLE:
+			h = h * 31 + p1[i].token.variable;
+			break;
+		case OPERATOR:
+			h = h * 31 + p1[i].token.operatr;
+			break;
+		}
+	}
+	return h;
+}
+
+/*
+ * Return true if the two expressions are token for token identical.
+ */
+static int
+term_identical(p1, p2, n)
+token_type	*p1, *p2;	/* expression pointers */
+int		n;		/* length of both expressions */
+{
+	int	i;
+
+	for (i = 0; i < n; i++) {
+		if (p1[i].kind != p2[i].kind || p1[i].level != p2[i].level)
+			return false;
+		switch (p1[i].kind) {
+		case CONSTANT:
+			if (p1[i].token.constant != p2[i].token.constant)
+				return false;
+			break;
+		case VARIABLE:
+			if (p1[i].token.variable != p2[i].token.variable)
+				return false;
+			break;
+		case OPERATOR:
+			if (p1[i].token.operatr != p2[i].token.operatr)
+				return false;
+			break;
+		}
+	}
+	return true;
+}
+
 /*
  * Integration dispatch routine for polynomials.
  * Handles the level 1 additive operators,
- * sending each polynomial term to the specified integration function.
+ * sending each polynomial term to the rule for its shape in the specified rule table.
+ * Each term is transformed by itself in scratch[] and appended to the result in tes[],
+ * so the time taken is linear in the size of the expression.
+ * Identical terms are only transformed once.
  *
  * Return true if successful.
  */
-int
-int_dispatch(equation, np, v, func)
+static int
+int_dispatch(equation, np, v, rules)
 token_type	*equation;	/* pointer to beginning of equation side to integrate */
 int		*np;		/* pointer to length of equation side */
 long		v;		/* integration variable */
-int		(*func)(token_type *equation, int *np, int loc, int eloc, long v);	/* integration function to call for each term */
+int_rule_type	*rules;		/* rule table indexed by term shape */
 {
-	int	i, j;
+	static int_cache_type	*cache;
+	static int		cache_alloc;
+
+	int		i, j, k;
+	int		n, shape;
+	int		n_terms, cache_size, cache_hits = 0;
+	int_cache_type	*cp, *new_cache;
+	unsigned long	h;
 
-	make_powers(equation, np, v);
+	for (i = 0; i < N_TERM_SHAPES; i++)
+		rules[i].hits = 0;
+	for (i = 1, n_terms = 1; i < *np; i += 2) {
+		if (equation[i].level == 1
+		    && (equation[i].token.operatr == PLUS || equation[i].token.operatr == MINUS))
+			n_terms++;
+	}
+	for (cache_size = 16; cache_size < 2 * n_terms; cache_size *= 2)
+		;
+	if (cache_size > cache_alloc) {
+		new_cache = (int_cache_type *) realloc(cache, cache_size * sizeof(int_cache_type));
+		if (new_cache) {
+			cache = new_cache;
+			cache_alloc = cache_size;
+		}
+	}
+	if (cache_size > cache_alloc) {
+		cache_size = 0;		/* out of memory, so don't use the cache */
+	} else {
+		memset(cache, 0, cache_size * sizeof(int_cache_type));
+	}
+	n_tes = 0;
 	for (j = 0, i = 1;; i += 2) {
-		if (i >= *np) {
-			return((*func)(equation, np, j, i, v));
+		if (i < *np && (equation[i].level != 1
+		    || (equation[i].token.operatr != PLUS && equation[i].token.operatr != MINUS)))
+			continue;
+		if (j > 0) {
+			if (n_tes + 1 > n_tokens)
+				error_huge();
+			tes[n_tes++] = equation[j-1];
 		}
-		if (equation[i].level == 1
-		    && (equation[i].token.operatr == PLUS || equation[i].token.operatr == MINUS)) {
-			if (!(*func)(equation, np, j, i, v)) {
+		n = i - j;
+		h = term_hash(&equation[j], n);
+		cp = NULL;
+		if (cache_size) {
+			for (k = h & (cache_size - 1);; k = (k + 1) & (cache_size - 1)) {
+				cp = &cache[k];
+				if (cp->len == 0)
+					break;
+				if (cp->hash == h && cp->len == n && term_identical(&equation[cp->loc], &equation[j], n))
+					break;
+			}
+		}
+		if (cp && cp->len) {
+			cache_hits++;
+			if (n_tes + cp->olen > n_tokens)
+				error_huge();
+			blt(&tes[n_tes], &tes[cp->oloc], cp->olen * sizeof(token_type));
+			n_tes += cp->olen;
+		} else {
+			blt(scratch, &equation[j], n * sizeof(token_type));
+			make_powers(scratch, &n, v);
+			shape = term_shape(scratch, n, v);
+			if (rules[shape].func == NULL || !(*rules[shape].func)(scratch, &n, 0, n, v))
 				return false;
+			rules[shape].hits++;
+			if (n_tes + n > n_tokens)
+				error_huge();
+			if (cp) {
+				cp->hash = h;
+				cp->loc = j;
+				cp->len = i - j;
+				cp->oloc = n_tes;
+				cp->olen = n;
 			}
-			for (i = j + 1;; i += 2) {
-				if (i >= *np) {
-					return true;
-				}
-				if (equation[i].level == 1) {
-					j = i + 1;
-					break;
-				}
+			blt(&tes[n_tes], scratch, n * sizeof(token_type));
+			n_tes += n;
+		}
+		if (i >= *np)
+			break;
+		j = i + 1;
+	}
+#if	!SILENT
+	if (debug_level >= 1) {
+		for (i = 0; i < N_TERM_SHAPES; i++) {
+			if (rules[i].hits) {
+				fprintf(gfp, _("%ld terms transformed by the %s rule.\n"), rules[i].hits, rules[i].name);
 			}
 		}
+		if (cache_hits) {
+			fprintf(gfp, _("%d identical terms transformed only once.\n"), cache_hits);
+		}
 	}
+#endif
+	blt(equation, tes, n_tes * sizeof(token_type));
+	*np = n_tes;
 	return true;
 }
 
 /*
- * Do the actual integration of a polynomial term.
+ * Integrate a polynomial term that doesn't contain the variable of integration,
+ * by multiplying it by that variable.
  *
  * Return true if successful.
  */
 static int
-integrate_sub(equation, np, loc, eloc, v)
+integrate_free(equation, np, loc, eloc, v)
 token_type	*equation;	/* pointer to beginning of equation side */
 int		*np;		/* pointer to length of equation side */
 int		loc;		/* beginning location of term */
 int		eloc;		/* end location of term */
 long		v;		/* variable of integration */
 {
-	int		i, j, k;
+	int	j;
+	int	mlevel;
+
+	mlevel = min_level(&equation[loc], eloc - loc) + 1;
+	for (j = loc; j < eloc; j++)
+		equation[j].level += 2;
+	if (*np + 2 > n_tokens) {
+		error_huge();
+	}
+	blt(&equation[eloc+2], &equation[eloc], (*np - eloc) * sizeof(token_type));
+	*np += 2;
+	equation[eloc].level = mlevel;
+	equation[eloc].kind = OPERATOR;
+	equation[eloc].token.operatr = TIMES;
+	eloc++;
+	equation[eloc].level = mlevel;
+	equation[eloc].kind = VARIABLE;
+	equation[eloc].token.variable = v;
+	return true;
+}
+
+/*
+ * Do the actual integration of a polynomial term c*(v^d) or c/(v^d),
+ * using the power rule.
+ *
+ * Return true if successful.
+ */
+static int
+integrate_power(equation, np, loc, eloc, v)
+token_type	*equation;	/* pointer to beginning of equation side */
+int		*np;		/* pointer to length of equation side */
+int		loc;		/* beginning location of term */
+int		eloc;		/* end location of term */
+long		v;		/* variable of integration */
+{
+	int		i, j;
 	int		len;
-	int		level, vlevel, mlevel;
-	int		count;
+	int		level, mlevel;
 	int		div_flag;
 
 	level = min_level(&equation[loc], eloc - loc);
-	/* determine if the term is a polynomial term in "v" */
-	for (i = loc, count = 0; i < eloc; i += 2) {
-		if (equation[i].kind == VARIABLE && equation[i].token.variable == v) {
-			count++;
-			if (count > 1)
-				return false;
-			vlevel = equation[i].level;
-			if (vlevel == level || vlevel == (level + 1)) {
-				for (k = loc + 1; k < eloc; k += 2) {
-					if (equation[k].level == level) {
-						switch (equation[k].token.operatr) {
-						case DIVIDE:
-						case TIMES:
-							continue;
-						case POWER:
-							if (k == (i + 1))
-								continue;
-						default:
-							return false;
-						}
-					}
-				}
-				if (vlevel == (level + 1)) {
-					if ((i + 1) < eloc && equation[i+1].level == vlevel
-					    && equation[i+1].token.operatr == POWER) {
-						continue;
-					}
-				} else {
-					continue;
-				}
-			}
-			return false;
-		}
-	}
 	mlevel = level + 1;
 	for (j = loc; j < eloc; j++)
 		equation[j].level += 2;
@@ -224,19 +432,7 @@ long		v;		/* variable of integration */
 			return true;
 		}
 	}
-	if (*np + 2 > n_tokens) {
-		error_huge();
-	}
-	blt(&equation[eloc+2], &equation[eloc], (*np - eloc) * sizeof(token_type));
-	*np += 2;
-	equation[eloc].level = mlevel;
-	equation[eloc].kind = OPERATOR;
-	equation[eloc].token.operatr = TIMES;
-	eloc++;
-	equation[eloc].level = mlevel;
-	equation[eloc].kind = VARIABLE;
-	equation[eloc].token.variable = v;
-	return true;
+	return false;
 }
 
 /*
@@ -331,7 +527,7 @@ char	*cp;
 	blt(dest, source, *nps * sizeof(token_type));
 	n1 = *nps;
 	for (l1 = 0; l1 < integrate_order; l1++) {
-		if (!int_dispatch(dest, &n1, v, integrate_sub)) {
+		if (!int_dispatch(dest, &n1, v, integrate_rules)) {
 			error(_("Integration failed, not a polynomial."));
 			return false;
 		}
@@ -407,12 +603,46 @@ char	*cp;
 }
 
 /*
- * Do the actual Laplace transformation of a polynomial term.
+ * Laplace transform a polynomial term that doesn't contain the variable v,
+ * by dividing it by v.
  *
  * Return true if successful.
  */
 static int
-laplace_sub(equation, np, loc, eloc, v)
+laplace_free(equation, np, loc, eloc, v)
+token_type	*equation;
+int		*np;
+int		loc, eloc;
+long		v;
+{
+	int	j;
+	int	mlevel;
+
+	mlevel = min_level(&equation[loc], eloc - loc) + 1;
+	for (j = loc; j < eloc; j++)
+		equation[j].level += 2;
+	if (*np + 2 > n_tokens) {
+		error_huge();
+	}
+	blt(&equation[eloc+2], &equation[eloc], (*np - eloc) * sizeof(token_type));
+	*np += 2;
+	equation[eloc].level = mlevel;
+	equation[eloc].kind = OPERATOR;
+	equation[eloc].token.operatr = DIVIDE;
+	eloc++;
+	equation[eloc].level = mlevel;
+	equation[eloc].kind = VARIABLE;
+	equation[eloc].token.variable = v;
+	return true;
+}
+
+/*
+ * Do the actual Laplace transformation of a polynomial term c*(v^d).
+ *
+ * Return true if successful.
+ */
+static int
+laplace_power(equation, np, loc, eloc, v)
 token_type	*equation;
 int		*np;
 int		loc, eloc;
@@ -477,28 +707,16 @@ long		v;
 			return true;
 		}
 	}
-	if (*np + 2 > n_tokens) {
-		error_huge();
-	}
-	blt(&equation[eloc+2], &equation[eloc], (*np - eloc) * sizeof(token_type));
-	*np += 2;
-	equation[eloc].level = mlevel;
-	equation[eloc].kind = OPERATOR;
-	equation[eloc].token.operatr = DIVIDE;
-	eloc++;
-	equation[eloc].level = mlevel;
-	equation[eloc].kind = VARIABLE;
-	equation[eloc].token.variable = v;
-	return true;
+	return false;
 }
 
 /*
- * Do the actual inverse Laplace transformation of a polynomial term.
+ * Do the actual inverse Laplace transformation of a polynomial term c/(v^d).
  *
  * Return true if successful.
  */
 static int
-inv_laplace_sub(equation, np, loc, eloc, v)
+inv_laplace_power(equation, np, loc, eloc, v)
 token_type	*equation;
 int		*np;
 int		loc, eloc;
@@ -614,12 +832,12 @@ char	*cp;
 	blt(dest, source, *nps * sizeof(token_type));
 	n1 = *nps;
 	if (inverse_flag) {
-		if (!poly_in_v(dest, n1, v, true) || !int_dispatch(dest, &n1, v, inv_laplace_sub)) {
+		if (!poly_in_v(dest, n1, v, true) || !int_dispatch(dest, &n1, v, inv_laplace_rules)) {
 			error(_("Inverse Laplace transformation failed."));
 			return false;
 		}
 	} else {
-		if (!poly_in_v(dest, n1, v, false) || !int_dispatch(dest, &n1, v, laplace_sub)) {
+		if (!poly_in_v(dest, n1, v, false) || !int_dispatch(dest, &n1, v, laplace_rules)) {
 			error(_("Laplace transformation failed, not a polynomial."));
 			return false;
 		}
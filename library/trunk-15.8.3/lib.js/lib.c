@@ -226,6 +226,613 @@ matho_parse(char *input, char **outputp)
 	return rv;
 }
 
+/** 3
+ * matho_process_ex - Process Mathomatic input, returning a structured JSON result
+ * Works like matho_process(3), but the result is always a malloc()ed JSON object
+ * stored in "*jsonp", which must be free()d after use,
+ * so that the result can be decoded without an expression parser:
+ *
+ * {"status":0,"warning":null,"result":{"equation":1,"lhs":...,"rhs":...}}
+ *
+ * "status" is the return value, "warning" is the warning message string or null,
+ * and "result" is the resulting equation space in the same format as the "list json" command,
+ * which never converts the expression to text.
+ * A command that succeeds without an expression result has status MATHO_NO_RESULT
+ * and a "text" string or null instead, and a failure has status MATHO_ERROR
+ * and an "error" string instead.
+ *
+ * Returns MATHO_OK, MATHO_NO_RESULT, or MATHO_ERROR.
+ * If out of memory, "*jsonp" is set to NULL and MATHO_ERROR is returned.
+ */
+int
+matho_process_ex(char *input, char **jsonp)
+{
+	int		rv, status;
+	char		*out, *cp = NULL;
+	strbuf_type	sb;
+	char		buf[40];
+
+	no_result_str = true;
+	rv = matho_process(input, &out);
+	no_result_str = false;
+	if (!rv) {
+		status = MATHO_ERROR;
+	} else if (result_en >= 0 && (cp = list_equation(result_en, 5)) != NULL) {
+		status = MATHO_OK;
+	} else {
+		status = MATHO_NO_RESULT;
+	}
+	strbuf_init(&sb);
+	snprintf(buf, sizeof(buf), "{\"status\":%d,\"warning\":", status);
+	strbuf_append(&sb, buf);
+	if (warning_str) {
+		json_string(&sb, (char *) warning_str);
+	} else {
+		strbuf_append(&sb, "null");
+	}
+	switch (status) {
+	case MATHO_OK:
+		strbuf_append(&sb, ",\"result\":");
+		strbuf_append(&sb, cp);
+		free(cp);
+		break;
+	case MATHO_NO_RESULT:
+		strbuf_append(&sb, ",\"text\":");
+		if (out) {
+			json_string(&sb, out);
+		} else {
+			strbuf_append(&sb, "null");
+		}
+		break;
+	case MATHO_ERROR:
+		strbuf_append(&sb, ",\"error\":");
+		json_string(&sb, out ? out : _("Unknown error."));
+		break;
+	}
+	strbuf_append(&sb, "}");
+	if (rv && out) {
+		free(out);
+	}
+	*jsonp = strbuf_finish(&sb);
+	if (*jsonp == NULL)
+		return MATHO_ERROR;
+	return status;
+}
+
+/*
+ * Return true if "handle" refers to an equation space holding an expression,
+ * otherwise set error_str and return false.
+ */
+static int
+valid_handle(int handle)
+{
+	if (empty_equation_space(handle)) {
+		error_str = _("Invalid or released expression handle.");
+		return false;
+	}
+	return true;
+}
+
+/** 3
+ * matho_parse_handle - Parse an expression into an equation space and return its handle
+ * Works like matho_parse(3), except no result string is made;
+ * the expression is only parsed and stored in the next available equation space.
+ * The returned handle is that equation space number,
+ * which can be given to matho_command(3), matho_text(3), and matho_release(3).
+ *
+ * Returns the handle (>= 0) if successful,
+ * otherwise -1 with the error message in the global "error_str".
+ */
+int
+matho_parse_handle(char *input)
+{
+	int	rv;
+
+	no_result_str = true;
+	rv = matho_parse(input, NULL);
+	no_result_str = false;
+	if (rv && result_en < 0)
+		error_str = _("No expression entered.");
+	return(rv ? result_en : -1);
+}
+
+/** 3
+ * matho_command - Run a Mathomatic command on the expression with the given handle
+ * "handle" is made the current equation and "command" is processed as with matho_process(3),
+ * for example "simplify", "derivative x", or "solve x",
+ * but the result is not converted to text, saving the formatting and any later reparsing.
+ * Multi-step operations can be chained by passing each returned handle to the next command.
+ *
+ * Returns the handle of the equation space the result is in,
+ * which is "handle" itself for commands that work in place,
+ * or a new handle for commands that store their result elsewhere, like "derivative".
+ * Returns -1 if the command failed (the error message is in the global "error_str"),
+ * or if it succeeded without producing an expression, like the set command.
+ */
+int
+matho_command(char *command, int handle)
+{
+	int	rv;
+
+	error_str = NULL;
+	warning_str = NULL;
+	if (!valid_handle(handle))
+		return -1;
+	cur_equation = handle;
+	no_result_str = true;
+	rv = matho_process(command, NULL);
+	no_result_str = false;
+	return(rv ? result_en : -1);
+}
+
+/** 3
+ * matho_text - Return the text of the expression with the given handle
+ * The expression is rendered the same way as the result strings of matho_process(3),
+ * in 2D if the display2d option is set.
+ *
+ * Returns a malloc()ed string which must be free()d after use,
+ * or NULL if the handle is invalid or out of memory.
+ */
+char *
+matho_text(int handle)
+{
+	char	*cp = NULL;
+
+	error_str = NULL;
+	warning_str = NULL;
+	if (!valid_handle(handle))
+		return NULL;
+	if (display2d)
+		cp = flist_equation_string(handle);
+	if (cp == NULL)
+		cp = list_equation(handle, false);
+	return cp;
+}
+
+/** 3
+ * matho_release - Release an expression handle
+ * Erases the equation space the handle refers to, so it can be reused.
+ * The handle is invalid afterwards.
+ */
+void
+matho_release(int handle)
+{
+	if (handle >= 0 && handle < n_equations) {
+		espace_written(handle);
+		n_lhs[handle] = 0;
+		n_rhs[handle] = 0;
+	}
+}
+
+/*
+ * State of the expression being built by the matho_build_*() functions.
+ * The tokens are written straight into equation space "build_en",
+ * with the same levels parse_section() would give them,
+ * and organized once by matho_build_end().
+ */
+static int	build_en = -1;		/* equation space being built, -1 if none */
+static int	build_rhs;		/* true if building the right-hand side */
+static int	build_level;		/* current level of parentheses */
+static int	build_operand;		/* true if the last thing built was an operand */
+
+/*
+ * Abandon the expression being built, with error message "str".
+ * Always returns false.
+ */
+static int
+build_fail(const char *str)
+{
+	if (build_en >= 0) {
+		n_lhs[build_en] = 0;
+		n_rhs[build_en] = 0;
+		espace_written(build_en);
+		build_en = -1;
+	}
+	error_str = str;
+	return false;
+}
+
+/*
+ * Append a token to the expression being built.
+ * Returns false if there is no room.
+ */
+static int
+build_token(int kind, int operatr, double constant, long variable)
+{
+	token_type	*p1;
+	int		*np;
+
+	if (build_rhs) {
+		p1 = rhs[build_en];
+		np = &n_rhs[build_en];
+	} else {
+		p1 = lhs[build_en];
+		np = &n_lhs[build_en];
+	}
+	if (*np > (n_tokens - 10))
+		return build_fail(_("Expression too large."));
+	p1 = &p1[(*np)++];
+	p1->level = build_level;
+	p1->kind = kind;
+	switch (kind) {
+	case CONSTANT:
+		p1->token.constant = constant;
+		break;
+	case VARIABLE:
+		p1->token.variable = variable;
+		break;
+	case OPERATOR:
+		p1->token.operatr = operatr;
+		break;
+	}
+	return true;
+}
+
+/*
+ * Return true if an expression is being built, otherwise set error_str.
+ */
+static int
+build_active(void)
+{
+	if (build_en < 0) {
+		error_str = _("No expression is being built; call matho_build_begin() first.");
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Start an operand, inserting an implied times operator after a previous operand,
+ * the same as the parser does for input like "2x" or "(x)(y)".
+ */
+static int
+build_operand_start(void)
+{
+	if (!build_active())
+		return false;
+	if (build_operand && !build_token(OPERATOR, TIMES, 0.0, 0L))
+		return false;
+	build_operand = true;
+	return true;
+}
+
+/** 3
+ * matho_build_begin - Start building an expression without parsing text
+ * Begin building an expression or equation in the next available equation space,
+ * by calling the other matho_build_*() functions in the order
+ * the expression would be written, from left to right,
+ * then matho_build_end(3) to finish it and get its handle.
+ * For machine generated expressions this is much faster than printing
+ * and parsing text, and it cannot be confused by variable names or number formats.
+ * Any expression being built is abandoned.
+ *
+ * Returns true if successful, false if there are no free equation spaces.
+ */
+int
+matho_build_begin(void)
+{
+	build_fail(NULL);	/* abandon any unfinished expression */
+	warning_str = NULL;
+	build_en = alloc_next_espace();
+	if (build_en < 0) {
+		error_str = _("Out of free equation spaces.");
+		return false;
+	}
+	espace_written(build_en);	/* the tokens are written directly, so mark it now */
+	build_rhs = false;
+	build_level = 1;
+	build_operand = false;
+	return true;
+}
+
+/** 3
+ * matho_build_constant - Add a constant to the expression being built
+ * Returns true if successful.
+ */
+int
+matho_build_constant(double d)
+{
+	if (isnan(d))
+		return build_fail(_("Constant out of range."));
+	return(build_operand_start() && build_token(CONSTANT, 0, d, 0L));
+}
+
+/** 3
+ * matho_variable - Return the id of a variable name, creating it if necessary
+ * The id can be given to matho_build_variable_id(3) any number of times,
+ * to avoid looking up the name again for every occurrence.
+ * The special names "e", "pi", "i", and "sign" are recognized as they are when parsing.
+ *
+ * Returns the id (> 0), or 0 if the name is not a valid variable name,
+ * with the error message in the global "error_str".
+ */
+long
+matho_variable(char *name)
+{
+	long	v = 0;
+	char	buf[MAX_VAR_LEN+1], *cp;
+
+	error_str = NULL;
+	if (name == NULL || strlen(name) > MAX_VAR_LEN) {
+		error_str = _("Variable name too long.");
+		return 0;
+	}
+	my_strlcpy(buf, name, sizeof(buf));
+	if (!case_sensitive_flag) {
+		str_tolower(buf);
+	}
+	cp = parse_var(&v, buf);
+	if (cp == NULL)
+		return 0;
+	if (*cp) {
+		error_str = _("Invalid variable.");
+		return 0;
+	}
+	return v;
+}
+
+/** 3
+ * matho_build_variable_id - Add a variable to the expression being built, by id
+ * "v" is a variable id returned by matho_variable(3).
+ *
+ * Returns true if successful.
+ */
+int
+matho_build_variable_id(long v)
+{
+	long	i;
+
+	i = v & VAR_MASK;
+	if (v <= 0 || i == V_NULL || (i >= VAR_OFFSET && (i - VAR_OFFSET >= MAX_VAR_NAMES || var_names[i-VAR_OFFSET] == NULL)))
+		return build_fail(_("Invalid variable."));
+	if (i == SIGN && (v >> VAR_SHIFT) <= MAX_SUBSCRIPT + 1) {
+		sign_array[v>>VAR_SHIFT] = true;
+	}
+	return(build_operand_start() && build_token(VARIABLE, 0, 0.0, v));
+}
+
+/** 3
+ * matho_build_variable - Add a variable to the expression being built, by name
+ * Returns true if successful.
+ */
+int
+matho_build_variable(char *name)
+{
+	long	v;
+
+	if (!build_active())
+		return false;
+	v = matho_variable(name);
+	if (v == 0)
+		return build_fail(error_str);
+	return matho_build_variable_id(v);
+}
+
+/** 3
+ * matho_build_operator - Add an operator to the expression being built
+ * "op" is one of the characters '+', '-', '*', '/', '^', or '%',
+ * with the same meaning and priority as in typed expressions.
+ * '-' where an operand is expected negates the following operand.
+ *
+ * Returns true if successful.
+ */
+int
+matho_build_operator(int op)
+{
+	int	operatr;
+
+	if (!build_active())
+		return false;
+	if (!build_operand) {
+		if (op != '-')
+			return build_fail(_("Operand expected in built expression."));
+		build_operand = false;
+		return(build_token(CONSTANT, 0, -1.0, 0L) && build_token(OPERATOR, NEGATE, 0.0, 0L));
+	}
+	switch (op) {
+	case '+':
+		operatr = PLUS;
+		break;
+	case '-':
+		operatr = MINUS;
+		break;
+	case '*':
+		operatr = TIMES;
+		break;
+	case '/':
+		operatr = DIVIDE;
+		break;
+	case '^':
+		operatr = POWER;
+		break;
+	case '%':
+		operatr = MODULUS;
+		break;
+	default:
+		return build_fail(_("Unknown operator in built expression."));
+	}
+	build_operand = false;
+	return build_token(OPERATOR, operatr, 0.0, 0L);
+}
+
+/** 3
+ * matho_build_open - Open a parenthesized group in the expression being built
+ * Returns true if successful.
+ */
+int
+matho_build_open(void)
+{
+	if (!build_operand_start())
+		return false;
+	build_operand = false;
+	build_level++;
+	return true;
+}
+
+/** 3
+ * matho_build_close - Close the last parenthesized group in the expression being built
+ * Returns true if successful.
+ */
+int
+matho_build_close(void)
+{
+	if (!build_active())
+		return false;
+	if (build_level <= 1)
+		return build_fail(_("Unmatched parenthesis: too many )"));
+	if (!build_operand)
+		return build_fail(_("Operand expected in built expression."));
+	build_level--;
+	return true;
+}
+
+/** 3
+ * matho_build_equals - Start the right-hand side of the equation being built
+ * What was built so far becomes the left-hand side.
+ *
+ * Returns true if successful.
+ */
+int
+matho_build_equals(void)
+{
+	if (!build_active())
+		return false;
+	if (build_rhs || build_level != 1 || !build_operand)
+		return build_fail(_("Misplaced equals sign in built expression."));
+	build_rhs = true;
+	build_operand = false;
+	return true;
+}
+
+/** 3
+ * matho_build_polynomial - Add a polynomial with coefficients from an array
+ * Adds the parenthesized operand
+ * (coefficients[0] + coefficients[1]*var + ... + coefficients[n-1]*var^(n-1))
+ * to the expression being built, skipping zero coefficients.
+ * This is the cheap way to turn an external array of numbers into an expression.
+ *
+ * Returns true if successful.
+ */
+int
+matho_build_polynomial(double *coefficients, int n, char *var)
+{
+	int	i, first = true;
+	long	v;
+
+	if (!build_active())
+		return false;
+	if ((v = matho_variable(var)) == 0)
+		return build_fail(error_str);
+	if (!matho_build_open())
+		return false;
+	for (i = 0; i < n; i++) {
+		if (coefficients[i] == 0.0)
+			continue;
+		if (!first && !matho_build_operator('+'))
+			return false;
+		first = false;
+		if (!matho_build_constant(coefficients[i]))
+			return false;
+		if (i > 0) {
+			if (!matho_build_variable_id(v))
+				return false;
+			if (i > 1 && !(matho_build_operator('^') && matho_build_constant((double) i)))
+				return false;
+		}
+	}
+	if (first && !matho_build_constant(0.0))
+		return false;
+	return matho_build_close();
+}
+
+/** 3
+ * matho_build_end - Finish building an expression and return its handle
+ * The built tokens are given operator priority and organized once,
+ * then stored exactly like matho_parse_handle(3) stores parsed input,
+ * and the equation space becomes the current equation.
+ *
+ * Returns the handle (>= 0) of the equation space holding the expression,
+ * otherwise -1 with the error message in the global "error_str".
+ */
+int
+matho_build_end(void)
+{
+	int	en;
+
+	if (!build_active())
+		return -1;
+	if (build_level != 1 || !build_operand) {
+		build_fail((build_level != 1) ? _("Unmatched parenthesis: missing )") : _("Operand expected in built expression."));
+		return -1;
+	}
+	en = build_en;
+	build_en = -1;
+	result_en = -1;
+	if (setjmp(jmp_save) != 0) {
+		clean_up();
+		n_lhs[en] = 0;
+		n_rhs[en] = 0;
+		if (error_str == NULL)
+			error_str = _("Processing was interrupted.");
+		no_result_str = false;
+		return -1;
+	}
+	give_priority(lhs[en], &n_lhs[en]);
+	organize(lhs[en], &n_lhs[en]);
+	if (n_rhs[en]) {
+		give_priority(rhs[en], &n_rhs[en]);
+		organize(rhs[en], &n_rhs[en]);
+	}
+	cur_equation = en;
+	espace_written(en);
+	no_result_str = true;
+	return_result(en);
+	no_result_str = false;
+	return en;
+}
+
+#if	!SECURE
+/** 3
+ * matho_save_state - Save the whole Mathomatic session in a binary file
+ * All equation spaces, variable names, and the options that affect expressions
+ * are written to "filename" in the binary snapshot format of the "save binary" command,
+ * overwriting any existing file.
+ * The file can only be loaded by the same version of Mathomatic on the same type of computer.
+ *
+ * Returns true (non-zero) if successful,
+ * otherwise the error message is in the global "error_str".
+ */
+int
+matho_save_state(char *filename)
+{
+	error_str = NULL;
+	warning_str = NULL;
+	if (filename == NULL)
+		return false;
+	return save_binary(filename);
+}
+
+/** 3
+ * matho_load_state - Restore a Mathomatic session from a binary file
+ * Loads a file written by matho_save_state(3) or the "save binary" command,
+ * replacing all equation spaces, variable names, and expression options,
+ * without any parsing.
+ * The file is completely checked first, and nothing is changed if it is not valid.
+ *
+ * Returns true (non-zero) if successful,
+ * otherwise the error message is in the global "error_str".
+ */
+int
+matho_load_state(char *filename)
+{
+	error_str = NULL;
+	warning_str = NULL;
+	if (filename == NULL)
+		return false;
+	return read_binary(filename);
+}
+#endif
+
 /*
  * Floating point exception handler.
  * Usually doesn't work in most operating systems, so just ignore it.
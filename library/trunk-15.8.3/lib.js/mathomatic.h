@@ -6,6 +6,32 @@ int matho_init(void);				/* one-time Mathomatic initialization */
 int matho_process(char *input, char **outputp);	/* Mathomatic command or expression input */
 int matho_parse(char *input, char **outputp);	/* Mathomatic expression or equation input */
 void matho_clear(void);				/* Restart Mathomatic quickly and cleanly, replaces clear_all(). */
+int matho_process_ex(char *input, char **jsonp);	/* Mathomatic input, with a JSON result in "*jsonp" */
+#define	MATHO_OK	0	/* matho_process_ex() status: success with an expression result */
+#define	MATHO_NO_RESULT	1	/* success without an expression result */
+#define	MATHO_ERROR	2	/* failure, with an error message */
+
+/* Handle API: a handle is an equation space number, -1 for none or failure. */
+int matho_parse_handle(char *input);		/* Parse and store an expression without making a result string. */
+int matho_command(char *command, int handle);	/* Run a command on a handle, returning the handle of the result. */
+char *matho_text(int handle);			/* Return the malloc()ed text of the expression with a handle. */
+void matho_release(int handle);			/* Erase the equation space of a handle. */
+
+/* Expression builder: write an expression left to right without any text, then get its handle. */
+int matho_build_begin(void);			/* Start building in the next free equation space. */
+int matho_build_constant(double d);		/* Add a constant. */
+long matho_variable(char *name);		/* Return the id of a variable name, 0 if invalid. */
+int matho_build_variable_id(long v);		/* Add a variable by id. */
+int matho_build_variable(char *name);		/* Add a variable by name. */
+int matho_build_operator(int op);		/* Add one of the operators + - * / ^ %. */
+int matho_build_open(void);			/* Open a parenthesized group. */
+int matho_build_close(void);			/* Close a parenthesized group. */
+int matho_build_equals(void);			/* Start the right-hand side of an equation. */
+int matho_build_polynomial(double *coefficients, int n, char *var);	/* Add a polynomial from an array. */
+int matho_build_end(void);			/* Finish, returning the handle of the expression. */
+
+int matho_save_state(char *filename);		/* Save the whole session in a binary file. */
+int matho_load_state(char *filename);		/* Restore a session saved by matho_save_state(), without parsing. */
 
 void free_mem(void);		/* Free all allocated memory before quitting Mathomatic, if operating system doesn't when done. */
 				/* Mathomatic becomes unusable after free_mem(), until matho_init() is called again. */
@@ -21,3 +47,4 @@ extern int result_en;		/* Equation number of the API's returned result, */
 				/* to act on it with further commands. */
 
 extern const char *warning_str;	/* optional warning message generated by the last command */
+extern const char *error_str;	/* error message of the last failed matho_save_state() or matho_load_state() */
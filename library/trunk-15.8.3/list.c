@@ -63,8 +63,9 @@ static int	carray[] = {
 #define	EQUATE_STRING	" = "	/* string displayed between the LHS and RHS of equations */
 #define MODULUS_STRING	" % "	/* string displayed for the modulus operator */
 
-static int flist_sub(token_type *p1, int n, int out_flag, char *string, int sbuffer_size, int pos, int *highp, int *lowp);
-static int flist_recurse(token_type *p1, int n, int out_flag, char *string, int sbuffer_size, int line, int pos, int cur_level, int *highp, int *lowp);
+static int flist_sub(token_type *p1, int n, int out_flag, strbuf_type *rows, int pos, int *highp, int *lowp);
+static int flist_recurse(token_type *p1, int n, int out_flag, strbuf_type *rows, int line, int pos, int cur_level, int *highp, int *lowp);
+static void flist_append(strbuf_type *rows, int line, char *str);
 
 /* Bright HTML color array. */
 /* Used when HTML output and "set color" and "set bold" options are enabled. */
@@ -238,6 +239,82 @@ char	*buf;
 	}
 }
 
+/*
+ * Initialize string buffer "sb" to the empty string.
+ */
+void
+strbuf_init(sb)
+strbuf_type	*sb;
+{
+	sb->str = NULL;
+	sb->len = 0;
+	sb->size = 0;
+	sb->failed = false;
+}
+
+/*
+ * Append the first "len" characters of "str" to string buffer "sb",
+ * doubling its allocated size as needed.
+ *
+ * Return false if out of memory.
+ */
+int
+strbuf_appendn(sb, str, len)
+strbuf_type	*sb;
+char		*str;
+int		len;
+{
+	int	new_size;
+	char	*cp;
+
+	if (sb->failed)
+		return false;
+	if (sb->len + len + 1 > sb->size) {
+		new_size = max(sb->size * 2, sb->len + len + 1024);
+		cp = (char *) realloc(sb->str, new_size);
+		if (cp == NULL) {
+			sb->failed = true;
+			return false;
+		}
+		sb->str = cp;
+		sb->size = new_size;
+	}
+	memcpy(&sb->str[sb->len], str, len);
+	sb->len += len;
+	sb->str[sb->len] = '\0';
+	return true;
+}
+
+/*
+ * Append "str" to string buffer "sb".
+ *
+ * Return false if out of memory.
+ */
+int
+strbuf_append(sb, str)
+strbuf_type	*sb;
+char		*str;
+{
+	return strbuf_appendn(sb, str, strlen(str));
+}
+
+/*
+ * Return the string in string buffer "sb", to be freed with free() when done,
+ * or NULL with an error message if out of memory.
+ */
+char *
+strbuf_finish(sb)
+strbuf_type	*sb;
+{
+	if (sb->failed || (sb->str == NULL && !strbuf_appendn(sb, "", 0))) {
+		error(_("Out of memory (can't malloc(3))."));
+		free(sb->str);
+		strbuf_init(sb);
+		return NULL;
+	}
+	return sb->str;
+}
+
 /*
  * Display the expression or equation stored in equation space "n" in single-line format.
  *
@@ -247,12 +324,20 @@ int
 list1_sub(n, export_flag)
 int	n;		/* equation space number */
 int	export_flag;	/* non-zero for exportable format (readable by other math programs) */
-			/* 1 for Maxima, 2 for other, 3 for gnuplot, 4 for hexadecimal */
+			/* 1 for Maxima, 2 for other, 3 for gnuplot, 4 for hexadecimal, 5 for JSON */
 {
 	int	len = 0;
+	char	*cp;
 
 	if (empty_equation_space(n))
 		return 0;
+	if (export_flag == 5) {
+		if ((cp = list_equation(n, export_flag)) == NULL)
+			return 0;
+		len = fprintf(gfp, "%s\n", cp) - 1;
+		free(cp);
+		return len;
+	}
 	if ((export_flag == 0 || export_flag == 4) && !high_prec) {
 		len += fprintf(gfp, "#%d: ", n + 1);
 	}
@@ -487,7 +572,7 @@ int		n;		/* length of expression */
 int		export_flag;	/* flag for exportable format (usually false) */
 				/* 1 for Maxima, 2 for other, 3 for gnuplot, 4 for hexadecimal */
 {
-	return list_string_sub(p1, n, true, NULL, export_flag);
+	return list_string_sub(p1, n, true, NULL, NULL, export_flag);
 }
 
 /*
@@ -501,31 +586,28 @@ list_equation(n, export_flag)
 int	n;		/* equation space number */
 int	export_flag;	/* flag for exportable format (usually false) */
 {
-	int	len;
-	char	*cp;
+	strbuf_type	sb;
+
+	char		buf[30];
 
 	if (empty_equation_space(n))
 		return NULL;
-	len = list_string(lhs[n], n_lhs[n], NULL, export_flag);
-	if (n_rhs[n]) {
-		len += strlen(EQUATE_STRING);
-		len += list_string(rhs[n], n_rhs[n], NULL, export_flag);
-	}
-	len += 2;	/* for possible semicolon and terminating null character */
-	cp = (char *) malloc(len);
-	if (cp == NULL) {
-		error(_("Out of memory (can't malloc(3))."));
-		return NULL;
+	strbuf_init(&sb);
+	if (export_flag == 5) {
+		snprintf(buf, sizeof(buf), "{\"equation\":%d,\"lhs\":", n + 1);
+		strbuf_append(&sb, buf);
 	}
-	list_string(lhs[n], n_lhs[n], cp, export_flag);
+	list_string_sub(lhs[n], n_lhs[n], false, NULL, &sb, export_flag);
 	if (n_rhs[n]) {
-		strcat(cp, EQUATE_STRING);
-		list_string(rhs[n], n_rhs[n], &cp[strlen(cp)], export_flag);
+		strbuf_append(&sb, (export_flag == 5) ? ",\"rhs\":" : EQUATE_STRING);
+		list_string_sub(rhs[n], n_rhs[n], false, NULL, &sb, export_flag);
 	}
 	if (export_flag == 1) {
-		strcat(cp, ";");
+		strbuf_append(&sb, ";");
+	} else if (export_flag == 5) {
+		strbuf_append(&sb, "}");
 	}
-	return cp;
+	return strbuf_finish(&sb);
 }
 
 /*
@@ -540,21 +622,14 @@ token_type	*p1;		/* expression pointer */
 int		n;		/* length of expression */
 int		export_flag;
 {
-	int	len;
-	char	*cp;
+	strbuf_type	sb;
 
 	if (n <= 0) {
 		return NULL;
 	}
-	len = list_string(p1, n, NULL, export_flag);
-	len++;	/* for terminating null character */
-	cp = (char *) malloc(len);
-	if (cp == NULL) {
-		error(_("Out of memory (can't malloc(3))."));
-		return NULL;
-	}
-	list_string(p1, n, cp, export_flag);
-	return cp;
+	strbuf_init(&sb);
+	list_string_sub(p1, n, false, NULL, &sb, export_flag);
+	return strbuf_finish(&sb);
 }
 
 /*
@@ -572,20 +647,144 @@ int		n;		/* length of expression */
 char		*string;	/* buffer to save output to or NULL pointer */
 int		export_flag;
 {
-	return list_string_sub(p1, n, false, string, export_flag);
+	return list_string_sub(p1, n, false, string, NULL, export_flag);
+}
+
+/*
+ * Append the JSON string for "str" to string buffer "sb".
+ */
+void
+json_string(sb, str)
+strbuf_type	*sb;
+char		*str;
+{
+	char	buf[8];
+
+	strbuf_append(sb, "\"");
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\') {
+			buf[0] = '\\';
+			buf[1] = *str;
+			strbuf_appendn(sb, buf, 2);
+		} else if ((unsigned char) *str < ' ') {
+			snprintf(buf, sizeof(buf), "\\u%04x", *str);
+			strbuf_append(sb, buf);
+		} else {
+			strbuf_appendn(sb, str, 1);
+		}
+	}
+	strbuf_append(sb, "\"");
+}
+
+/*
+ * Append the JSON tree of the expression at "p1" to string buffer "sb".
+ * Constants are JSON numbers, exact when read back, or {"const":"inf"}, {"const":"-inf"}, or {"const":"nan"};
+ * variables are JSON strings, with "e", "pi", "i", and "sign" being the special variables;
+ * and operations are arrays of the operator string followed by its operands:
+ * ["+",a,b,...], ["-",a,b,...], ["*",a,b,...], ["/",a,b,...], ["//",a,b], ["%",a,b], ["^",a,b], or ["!",a].
+ * Runs of the same operator on the same level are combined into a single array,
+ * which is a left fold over its operands, so ["-",a,b,c] is (a-b)-c and ["/",a,b,c] is (a/b)/c.
+ * Different operators on the same level are nested so that they evaluate from left to right.
+ * Powers and factorials are never combined.
+ */
+static void
+list_json(p1, n, sb)
+token_type	*p1;	/* expression pointer */
+int		n;	/* length of expression */
+strbuf_type	*sb;
+{
+	int	i, j, level, runs, run, start;
+	int	op, last_op;
+	char	buf[300];
+	static const char *op_names[] = { NULL, "+", "-", "-", "*", "/", "%", "//", "^", "!" };
+
+	if (n == 1) {
+		switch (p1->kind) {
+		case CONSTANT:
+			if (exact_string(p1->token.constant, buf, sizeof(buf))) {
+				;	/* JSON numbers may have any number of digits */
+			} else if (isfinite(p1->token.constant)) {
+				snprintf(buf, sizeof(buf), "%.17g", (p1->token.constant == 0.0) ? 0.0 : p1->token.constant);
+			} else {
+				snprintf(buf, sizeof(buf), "{\"const\":\"%s\"}", isnan(p1->token.constant) ? "nan"
+				    : ((p1->token.constant < 0.0) ? "-inf" : "inf"));
+			}
+			strbuf_append(sb, buf);
+			break;
+		case VARIABLE:
+			list_var(p1->token.variable, 0);
+			json_string(sb, var_str);
+			break;
+		default:
+			strbuf_append(sb, "null");
+			break;
+		}
+		return;
+	}
+	level = min_level(p1, n);
+/* Count the runs of operators at this level, and open the nested arrays of all but the first run, innermost last. */
+	for (runs = 0, last_op = 0, i = 1; i < n; i += 2) {
+		if (p1[i].level == level) {
+			op = p1[i].token.operatr;
+			if (op != last_op || op == FACTORIAL || op == POWER)
+				runs++;
+			last_op = op;
+		}
+	}
+	for (run = runs; run > 1; run--) {
+		for (j = 0, last_op = 0, i = 1; i < n; i += 2) {
+			if (p1[i].level == level) {
+				op = p1[i].token.operatr;
+				if (op != last_op || op == FACTORIAL || op == POWER) {
+					if (++j == run)
+						break;
+				}
+				last_op = op;
+			}
+		}
+		strbuf_append(sb, "[");
+		json_string(sb, (char *) op_names[p1[i].token.operatr]);
+		strbuf_append(sb, ",");
+	}
+/* Output the operands, closing each run after its last operand. */
+	for (start = 0, last_op = 0, i = 1;; i += 2) {
+		if (i < n && p1[i].level != level)
+			continue;
+		op = (i < n) ? p1[i].token.operatr : 0;
+		if (last_op == 0) {
+			strbuf_append(sb, "[");
+			json_string(sb, (char *) op_names[op]);
+			strbuf_append(sb, ",");
+			list_json(p1, i, sb);
+		} else {
+			if (last_op != FACTORIAL) {	/* the operand of factorial is a dummy */
+				strbuf_append(sb, ",");
+				list_json(&p1[start], i - start, sb);
+			}
+			if (op != last_op || op == FACTORIAL || op == POWER) {
+				strbuf_append(sb, "]");
+			}
+		}
+		if (i >= n)
+			break;
+		last_op = op;
+		start = i + 1;
+	}
 }
 
 #define	APPEND(str)	{ if (string) { strcpy(&string[len], str); } if (outflag) { fprintf(gfp, "%s", str); } len += strlen(str); }
-#define	APPEND2(str)	{ if (string) { if ((sbuffer_size - current_len) > 0) my_strlcpy(&string[current_len], str, sbuffer_size - current_len); } else { fprintf(gfp, "%s", str); } current_len += strlen(str); }
+#define	APPEND1(str)	{ if (string) { strcpy(&string[len], str); } if (sb) { strbuf_append(sb, str); } if (outflag) { fprintf(gfp, "%s", str); } len += strlen(str); }
+#define	APPEND2(str)	{ if (rows) { flist_append(rows, line, str); } else { fprintf(gfp, "%s", str); } }
 
 int
-list_string_sub(p1, n, outflag, string, export_flag)
+list_string_sub(p1, n, outflag, string, sb, export_flag)
 token_type	*p1;		/* expression pointer */
 int		n;		/* length of expression */
 int		outflag;	/* if true, output to gfp */
 char		*string;	/* buffer to save output to or NULL pointer */
+strbuf_type	*sb;		/* string buffer to append output to or NULL pointer */
 int		export_flag;	/* flag for exportable format (usually false) */
-				/* 1 for Maxima, 2 for other, 3 for gnuplot, 4 for hexadecimal */
+				/* 1 for Maxima, 2 for other, 3 for gnuplot, 4 for hexadecimal, 5 for JSON */
 {
 	int	i, j, k, i1;
 	int	min1;
@@ -595,7 +794,22 @@ int		export_flag;	/* flag for exportable format (usually false) */
 	char	buf[500], buf2[500];
 	int	export_precision;
 	int	cflag, power_flag;
+	strbuf_type	jb;
 
+	if (export_flag == 5) {
+		if (sb && string == NULL && !outflag) {
+			len = sb->len;
+			list_json(p1, n, sb);
+			return(sb->len - len);
+		}
+		strbuf_init(&jb);
+		list_json(p1, n, &jb);
+		if ((cp = strbuf_finish(&jb)) == NULL)
+			return 0;
+		APPEND1(cp);
+		free(cp);
+		return len;
+	}
 	cflag = (outflag && (export_flag == 0 || export_flag == 4));
 	if (cflag)
 		set_color(0);
@@ -629,14 +843,14 @@ int		export_flag;	/* flag for exportable format (usually false) */
 		for (i1 = 1; i1 <= k; i1++) {
 			if (j > 0) {
 				cur_level--;
-				APPEND(")");
+				APPEND1(")");
 				if (cflag)
 					set_color(cur_level-min1);
 			} else {
 				cur_level++;
 				if (cflag)
 					set_color(cur_level-min1);
-				APPEND("(");
+				APPEND1("(");
 			}
 		}
 		switch (p1[i].kind) {
@@ -650,7 +864,8 @@ int		export_flag;	/* flag for exportable format (usually false) */
 				snprintf(buf, sizeof(buf), "%#.*g", DBL_DIG, p1[i].token.constant);
 				trim_zeros(buf);
 			} else if (export_flag || high_prec) {
-				snprintf(buf, sizeof(buf), "%.*g", export_precision, p1[i].token.constant);
+				if (!exact_string(p1[i].token.constant, buf, sizeof(buf)))
+					snprintf(buf, sizeof(buf), "%.*g", export_precision, p1[i].token.constant);
 			} else if (finance_option) {
 #if	THOUSANDS_SEPARATOR	/* Fails miserably in MinGW and possibly others, displaying nothing but the format string. */
 				snprintf(buf, sizeof(buf), "%'.*f", finance_option, p1[i].token.constant);
@@ -658,25 +873,32 @@ int		export_flag;	/* flag for exportable format (usually false) */
 				snprintf(buf, sizeof(buf), "%.*f", finance_option, p1[i].token.constant);
 #endif
 			} else {
-				if (p1[i].token.constant < 0.0 && (i + 1) < n && p1[i+1].level == p1[i].level
+				if (exact_string(p1[i].token.constant, buf, sizeof(buf) - 2)) {
+					if (p1[i].token.constant < 0.0 && (i + 1) < n && p1[i+1].level == p1[i].level
+					    && (p1[i+1].token.operatr >= POWER)) {
+						blt(&buf[1], buf, strlen(buf) + 1);
+						buf[0] = '(';
+						strcat(buf, ")");
+					}
+				} else if (p1[i].token.constant < 0.0 && (i + 1) < n && p1[i+1].level == p1[i].level
 				    && (p1[i+1].token.operatr >= POWER)) {
 					snprintf(buf, sizeof(buf), "(%.*g)", precision, p1[i].token.constant);
 				} else {
 					snprintf(buf, sizeof(buf), "%.*g", precision, p1[i].token.constant);
 				}
-				APPEND(buf);
+				APPEND1(buf);
 				break;
 			}
 			if (p1[i].token.constant < 0.0) {
 				snprintf(buf2, sizeof(buf2), "(%s)", buf);
-				APPEND(buf2);
+				APPEND1(buf2);
 			} else {
-				APPEND(buf);
+				APPEND1(buf);
 			}
 			break;
 		case VARIABLE:
 			list_var(p1[i].token.variable, 0 - export_flag);
-			APPEND(var_str);
+			APPEND1(var_str);
 			break;
 		case OPERATOR:
 			cp = _("(unknown operator)");
@@ -711,12 +933,12 @@ int		export_flag;	/* flag for exportable format (usually false) */
 				i++;
 				break;
 			}
-			APPEND(cp);
+			APPEND1(cp);
 			break;
 		}
 	}
 	for (j = cur_level - min1; j > 0;) {
-		APPEND(")");
+		APPEND1(")");
 		j--;
 		if (cflag)
 			set_color(j);
@@ -832,6 +1054,8 @@ int			int_flag;	/* integer arithmetic flag */
 	return cp;
 }
 
+static int	tape_len;	/* if nonzero, list_code() outputs negative variables as tape array elements */
+
 /*
  * Output C, Java, or Python code for an expression.
  * Expression might be modified by this function, though it remains equivalent.
@@ -850,6 +1074,7 @@ int			int_flag;	/* integer arithmetic flag, should work with any language */
 	int	i, j, k, i1, i2;
 	int	min1;
 	int	cur_level;
+	long	l1;
 	char	*cp;
 	char	buf[500], buf2[500];
 	int	len = 0;
@@ -924,7 +1149,12 @@ int			int_flag;	/* integer arithmetic flag, should work with any language */
 			}
 			break;
 		case VARIABLE:
-		  	if (int_flag && (language == C || language == JAVA) && equation[i].token.variable == IMAGINARY) {
+			if (tape_len && equation[i].token.variable < 0) {
+/* reference to a tape array element, from string_code_gradient() */
+				l1 = -equation[i].token.variable - 1;
+				snprintf(buf, sizeof(buf), "%c[%ld]", (l1 < tape_len) ? 't' : 'a', l1 % tape_len);
+				APPEND(buf);
+			} else if (int_flag && (language == C || language == JAVA) && equation[i].token.variable == IMAGINARY) {
 				APPEND("1i");
 			} else {
 				list_var(equation[i].token.variable, language);
@@ -976,9 +1206,493 @@ int			int_flag;	/* integer arithmetic flag, should work with any language */
 	return len;
 }
 
+/* global variables for the gradient code generator below, so they can be freed after an error */
+static strbuf_type	gstr;		/* generated code string */
+static int		*gtape;		/* tape position of each DAG node, or -1 */
+static int		*gnodes;	/* DAG node of each tape position */
+static int		*galias;	/* the adjoint each copied adjoint is a copy of */
+static char		*gassigned;	/* 1 if adjoint or gradient element is assigned, 2 if it is a copy */
+
+/*
+ * Free the buffers of string_code_gradient() and turn off tape references in list_code().
+ * Called by clean_up(), in case an error aborted the code generation.
+ */
+void
+gradient_clean_up(void)
+{
+	tape_len = 0;
+	free(gstr.str);
+	strbuf_init(&gstr);
+	free(gtape);
+	free(gnodes);
+	free(galias);
+	free(gassigned);
+	gtape = gnodes = galias = NULL;
+	gassigned = NULL;
+}
+
+/*
+ * Append one assignment statement "target op expression" to the generated code string,
+ * using list_code() for the expression.
+ */
+static void
+gstr_statement(target, op, p1, n, language)
+char			*target;	/* left side of the assignment */
+char			*op;		/* assignment operator string, like " = " */
+token_type		*p1;		/* expression pointer */
+int			n;		/* length of expression */
+enum language_list	language;
+{
+	int	len;
+	char	*cp;
+
+	strbuf_append(&gstr, (language == PYTHON) ? "    " : "\t");
+	strbuf_append(&gstr, target);
+	strbuf_append(&gstr, op);
+	len = list_code(p1, &n, false, NULL, language, false);
+	if ((cp = (char *) malloc(len + 1)) == NULL) {
+		gstr.failed = true;
+		return;
+	}
+	list_code(p1, &n, false, cp, language, false);
+	strbuf_append(&gstr, cp);
+	free(cp);
+	strbuf_append(&gstr, (language == PYTHON) ? "\n" : ";\n");
+}
+
+/*
+ * Mark all operator nodes reachable from DAG node "x" in "tape".
+ */
+static void
+mark_tape(x, tape)
+int	x, *tape;
+{
+	token_type	t;
+	int		left, right;
+
+	dag_node(x, &t, &left, &right);
+	if (t.kind != OPERATOR || tape[x])
+		return;
+	tape[x] = true;
+	mark_tape(left, tape);
+	mark_tape(right, tape);
+}
+
+/*
+ * Store the token for operand node "x" in "*tp":
+ * a reference to the tape if it is an operator, otherwise the constant or variable.
+ */
+static void
+tape_operand(x, tape, tp, level)
+int		x, *tape;
+token_type	*tp;
+int		level;
+{
+	int	left, right;
+
+	dag_node(x, tp, &left, &right);
+	if (tp->kind == OPERATOR) {
+		tp->kind = VARIABLE;
+		tp->token.variable = -(tape[x] + 1);	/* t[tape[x]] */
+	}
+	tp->level = level;
+}
+
+/*
+ * Append a factor to the product expression in p1,
+ * multiplying if "op" is TIMES or dividing if "op" is DIVIDE.
+ */
+static void
+add_factor(p1, np, op, tp)
+token_type	*p1;
+int		*np, op;
+token_type	*tp;
+{
+	if (*np == 0 && op == DIVIDE) {
+		p1[0].level = 1;
+		p1[0].kind = CONSTANT;
+		p1[0].token.constant = 1.0;
+		*np = 1;
+	}
+	if (*np) {
+		p1[*np].level = 1;
+		p1[*np].kind = OPERATOR;
+		p1[*np].token.operatr = op;
+		(*np)++;
+	}
+	p1[(*np)++] = *tp;
+}
+
+/*
+ * Generate a function in C, Java, or Python code that evaluates
+ * the expression in equation space "en" and its full gradient
+ * with respect to all normal variables, using reverse-mode automatic differentiation.
+ * The forward sweep stores the value of each unique subexpression in array t[],
+ * then the backward sweep accumulates the adjoints in array a[] and the gradient in grad[],
+ * in one pass.
+ * The code is only proportional to the size of the expression DAG.
+ *
+ * Return a malloc()ed string with the code, or NULL if error.
+ */
+char *
+string_code_gradient(en, language)
+int			en;		/* equation space number */
+enum language_list	language;
+{
+	int		i, j, k, x, root, n, n_tape, nv = 0;
+	int		op, side, left, right, lr[2], src, i1;
+	int		*tape, *nodes, *alias;
+	char		*assigned;
+	char		*cp;
+	token_type	*source, t, t1, p1[20];
+	int		n1;
+	long		va[MAX_VARS], v, last_v;
+	double		d, lnc = 0.0;
+	char		*indent, buf[MAX_VAR_LEN+200], target[MAX_VAR_LEN+100];
+
+	if (empty_equation_space(en))
+		return NULL;
+	gradient_clean_up();
+	if (n_rhs[en]) {
+		source = rhs[en];
+		n1 = n_rhs[en];
+	} else {
+		source = lhs[en];
+		n1 = n_lhs[en];
+	}
+	for (last_v = 0;;) {
+		v = -1;
+		for (i = 0; i < n1; i += 2) {
+			if (source[i].kind == VARIABLE && (source[i].token.variable & VAR_MASK) > SIGN
+			    && source[i].token.variable > last_v && (v == -1 || source[i].token.variable < v)) {
+				v = source[i].token.variable;
+			}
+		}
+		if (v == -1)
+			break;
+		if (nv >= ARR_CNT(va)) {
+			error(_("Too many variables."));
+			return NULL;
+		}
+		va[nv++] = last_v = v;
+	}
+	blt(tes, source, n1 * sizeof(token_type));
+	n_tes = n1;
+	organize(tes, &n_tes);
+	dag_clear();
+	if ((root = dag_build(tes, n_tes)) < 0) {
+		error(_("Can't generate gradient code for this expression."));
+		return NULL;
+	}
+	n = dag_count();
+	if ((tape = gtape = (int *) calloc(n, sizeof(int))) == NULL || (nodes = gnodes = (int *) malloc(n * sizeof(int))) == NULL
+	    || (alias = galias = (int *) malloc(n * sizeof(int))) == NULL
+	    || (assigned = gassigned = (char *) calloc(n + nv, sizeof(char))) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		goto fail;
+	}
+/* The tape is every reachable operator node, in node order, which has operands first. */
+	mark_tape(root, tape);
+	for (x = 0, n_tape = 0; x < n; x++) {
+		if (tape[x]) {
+			nodes[n_tape] = x;
+			tape[x] = n_tape++;
+		} else {
+			tape[x] = -1;
+		}
+	}
+	for (k = 0; k < n_tape; k++) {
+		x = nodes[k];
+		dag_node(x, &t, &left, &right);
+		if (!dag_depends(x, MATCH_ANY))
+			continue;
+		switch (t.token.operatr) {
+		case PLUS:
+		case MINUS:
+		case TIMES:
+		case DIVIDE:
+			break;
+		case POWER:
+			if (dag_depends(right, MATCH_ANY)) {
+				if (dag_depends(left, MATCH_ANY)) {
+					error(_("Differentiation requires symbolic logarithms, which are not implemented."));
+					goto fail;
+				}
+			}
+			break;
+		default:
+			error(_("The factorial, modulus, and integral divide operators can't be differentiated."));
+			goto fail;
+		}
+	}
+	indent = (language == PYTHON) ? "    " : "\t";
+/* function heading */
+	if (solved_equation(en)) {
+		list_var(lhs[en][0].token.variable, language);
+		snprintf(buf, sizeof(buf), "%s_gradient", var_str);
+	} else {
+		my_strlcpy(buf, "gradient", sizeof(buf));
+	}
+	switch (language) {
+	case PYTHON:
+		strbuf_append(&gstr, "# Return the value and gradient, computed by reverse-mode automatic differentiation.\n");
+		strbuf_append(&gstr, "# grad[i] is the partial derivative with respect to the i-th argument.\n");
+		strbuf_append(&gstr, "def ");
+		strbuf_append(&gstr, buf);
+		strbuf_append(&gstr, "(");
+		break;
+	case JAVA:
+		strbuf_append(&gstr, "// Return the value and store the gradient in grad[], computed by reverse-mode automatic differentiation.\n");
+		strbuf_append(&gstr, "// grad[i] is the partial derivative with respect to the i-th argument.\n");
+		strbuf_append(&gstr, "public static double ");
+		strbuf_append(&gstr, buf);
+		strbuf_append(&gstr, "(");
+		break;
+	default:
+		strbuf_append(&gstr, "/* Return the value and store the gradient in grad[], computed by reverse-mode automatic differentiation. */\n");
+		strbuf_append(&gstr, "/* grad[i] is the partial derivative with respect to the i-th argument. */\n");
+		strbuf_append(&gstr, "double\n");
+		strbuf_append(&gstr, buf);
+		strbuf_append(&gstr, "(");
+		break;
+	}
+	for (i = 0; i < nv; i++) {
+		if (language != PYTHON)
+			strbuf_append(&gstr, "double ");
+		list_var(va[i], language);
+		strbuf_append(&gstr, var_str);
+		if (i + 1 < nv || language != PYTHON)
+			strbuf_append(&gstr, ", ");
+	}
+	switch (language) {
+	case PYTHON:
+		strbuf_append(&gstr, "):\n");
+		snprintf(buf, sizeof(buf), "%sgrad = [0.0] * %d\n", indent, nv);
+		strbuf_append(&gstr, buf);
+		if (n_tape) {
+			snprintf(buf, sizeof(buf), "%st = [0.0] * %d\n%sa = [0.0] * %d\n", indent, n_tape, indent, n_tape);
+			strbuf_append(&gstr, buf);
+		}
+		break;
+	case JAVA:
+		strbuf_append(&gstr, "double[] grad) {\n");
+		if (n_tape) {
+			snprintf(buf, sizeof(buf), "%sdouble[] t = new double[%d];\n%sdouble[] a = new double[%d];\n", indent, n_tape, indent, n_tape);
+			strbuf_append(&gstr, buf);
+		}
+		break;
+	default:
+		strbuf_append(&gstr, "double grad[])\n{\n");
+		if (n_tape) {
+			snprintf(buf, sizeof(buf), "%sdouble t[%d], a[%d];\n", indent, n_tape, n_tape);
+			strbuf_append(&gstr, buf);
+		}
+		break;
+	}
+	if (n_tape)
+		strbuf_append(&gstr, "\n");
+	tape_len = n_tape;
+/* forward sweep */
+	for (k = 0; k < n_tape; k++) {
+		dag_node(nodes[k], &t, &left, &right);
+		tape_operand(left, tape, &p1[0], 1);
+		p1[1] = t;
+		tape_operand(right, tape, &p1[2], 1);
+		snprintf(target, sizeof(target), "t[%d]", k);
+		gstr_statement(target, " = ", p1, 3, language);
+	}
+/* backward sweep */
+	for (k = n_tape - 1; k >= 0; k--) {
+		x = nodes[k];
+		if (!dag_depends(x, MATCH_ANY))
+			continue;
+		dag_node(x, &t, &left, &right);
+		op = t.token.operatr;
+		if (op == POWER && dag_depends(right, MATCH_ANY)) {
+			n1 = 0;
+			dag_flatten(left, scratch, &n1);
+			if (!get_constant(scratch, n1, &d) || d <= 0.0) {
+				error(_("Can't take the logarithm of the base of a power."));
+				goto fail;
+			}
+			lnc = log(d);
+		}
+		lr[0] = left;
+		lr[1] = right;
+		src = (assigned[k] == 2) ? alias[k] : k;
+		for (side = 0; side < 2; side++) {
+			if (!dag_depends(lr[side], MATCH_ANY))
+				continue;
+			n1 = 0;
+			if (src != n_tape - 1) {
+				p1[0].level = 1;
+				p1[0].kind = VARIABLE;
+				p1[0].token.variable = -(n_tape + src + 1);	/* a[src] */
+				n1 = 1;
+			}
+			i = false;	/* negate flag */
+			switch (op) {
+			case MINUS:
+				i = side;
+				break;
+			case TIMES:
+				tape_operand(lr[!side], tape, &t1, 1);
+				add_factor(p1, &n1, TIMES, &t1);
+				break;
+			case DIVIDE:
+				if (side) {
+					i = true;
+					tape_operand(x, tape, &t1, 1);
+					add_factor(p1, &n1, TIMES, &t1);
+				}
+				tape_operand(lr[1], tape, &t1, 1);
+				add_factor(p1, &n1, DIVIDE, &t1);
+				break;
+			case POWER:
+				if (side) {
+					tape_operand(x, tape, &t1, 1);
+					add_factor(p1, &n1, TIMES, &t1);
+					t1.level = 1;
+					t1.kind = CONSTANT;
+					t1.token.constant = lnc;
+					add_factor(p1, &n1, TIMES, &t1);
+					break;
+				}
+				tape_operand(lr[1], tape, &t1, 1);
+				add_factor(p1, &n1, TIMES, &t1);
+				if (t1.kind == CONSTANT && t1.token.constant == 1.0)
+					break;
+				if (t1.kind == CONSTANT && t1.token.constant == 2.0) {
+					tape_operand(lr[0], tape, &t1, 1);
+					add_factor(p1, &n1, TIMES, &t1);
+					break;
+				}
+				p1[n1].level = 1;
+				p1[n1].kind = OPERATOR;
+				p1[n1++].token.operatr = TIMES;
+				tape_operand(lr[0], tape, &p1[n1++], 2);
+				p1[n1].level = 2;
+				p1[n1].kind = OPERATOR;
+				p1[n1++].token.operatr = POWER;
+				tape_operand(lr[1], tape, &p1[n1], 3);
+				if (p1[n1].kind == CONSTANT) {
+					p1[n1].level = 2;
+					p1[n1++].token.constant -= 1.0;
+				} else {
+					n1++;
+					p1[n1].level = 3;
+					p1[n1].kind = OPERATOR;
+					p1[n1++].token.operatr = MINUS;
+					p1[n1].level = 3;
+					p1[n1].kind = CONSTANT;
+					p1[n1++].token.constant = 1.0;
+				}
+				break;
+			}
+			if (tape[lr[side]] >= 0) {
+				j = tape[lr[side]];
+				if (assigned[j] == 0 && !i && n1 == (src != n_tape - 1)) {
+/* The adjoint is just a copy of another one, so use that one instead. */
+					assigned[j] = 2;
+					alias[j] = src;
+					continue;
+				}
+				snprintf(target, sizeof(target), "a[%d]", j);
+			} else {
+				dag_node(lr[side], &t1, &left, &right);
+				for (j = 0; va[j] != t1.token.variable; j++)
+					;
+				snprintf(target, sizeof(target), "grad[%d]", j);
+				j += n_tape;
+			}
+			if (n1 == 0) {
+				p1[0].level = 1;
+				p1[0].kind = CONSTANT;
+				p1[0].token.constant = 1.0;
+				n1 = 1;
+			}
+			if (assigned[j] == 1) {
+				gstr_statement(target, i ? " -= " : " += ", p1, n1, language);
+				continue;
+			}
+			if (assigned[j] == 2) {
+/* Add to the copied adjoint. */
+				for (i1 = 0; i1 < n1; i1++)
+					p1[i1].level++;
+				blt(&p1[2], p1, n1 * sizeof(token_type));
+				p1[0].level = 1;
+				if (alias[j] == n_tape - 1) {
+					p1[0].kind = CONSTANT;
+					p1[0].token.constant = 1.0;
+				} else {
+					p1[0].kind = VARIABLE;
+					p1[0].token.variable = -(n_tape + alias[j] + 1);
+				}
+				p1[1].level = 1;
+				p1[1].kind = OPERATOR;
+				p1[1].token.operatr = i ? MINUS : PLUS;
+				n1 += 2;
+			} else if (i) {
+				blt(&p1[2], p1, n1 * sizeof(token_type));
+				p1[0].level = 1;
+				p1[0].kind = CONSTANT;
+				p1[0].token.constant = -1.0;
+				p1[1].level = 1;
+				p1[1].kind = OPERATOR;
+				p1[1].token.operatr = TIMES;
+				n1 += 2;
+			}
+			assigned[j] = 1;
+			gstr_statement(target, " = ", p1, n1, language);
+		}
+	}
+	if (n_tape == 0 && nv) {
+		snprintf(buf, sizeof(buf), "%sgrad[0] = 1.0%s\n", indent, (language == PYTHON) ? "" : ";");
+		strbuf_append(&gstr, buf);	/* the expression is a single variable */
+		assigned[0] = true;
+	}
+	if (language != PYTHON) {
+		for (j = 0; j < nv; j++) {
+			if (!assigned[n_tape + j]) {
+				snprintf(buf, sizeof(buf), "%sgrad[%d] = 0.0;\n", indent, j);
+				strbuf_append(&gstr, buf);
+			}
+		}
+	}
+/* return the value */
+	if (n_tape) {
+		snprintf(target, sizeof(target), "t[%d]", n_tape - 1);
+	} else {
+		tape_operand(root, tape, &t, 1);
+		k = 1;
+		i = list_code(&t, &k, false, NULL, language, false);
+		if (i >= sizeof(target))
+			goto fail;
+		list_code(&t, &k, false, target, language, false);
+	}
+	strbuf_append(&gstr, "\n");
+	if (language == PYTHON) {
+		snprintf(buf, sizeof(buf), "%sreturn %s, grad\n", indent, target);
+	} else {
+		snprintf(buf, sizeof(buf), "%sreturn %s;\n}\n", indent, target);
+	}
+	strbuf_append(&gstr, buf);
+	cp = strbuf_finish(&gstr);
+	strbuf_init(&gstr);	/* the caller frees the code string */
+	gradient_clean_up();
+	return cp;
+
+fail:
+	gradient_clean_up();
+	return NULL;
+}
+
 /* global variables for the flist functions below */
-static int	cur_line;	/* current line */
-static int	cur_pos;	/* current position in the current line on the screen */
+static int	cur_line;		/* current line */
+static int	cur_pos;		/* current position in the current line on the screen */
+static int	top_line;		/* line number of rows[0] when outputting to string buffers */
+static int	row_pos[TEXT_ROWS];	/* current position in each line when outputting to string buffers */
+static int	row_columns;		/* maximum line width when outputting to string buffers */
 
 /*
  * Return a multi-line C string containing the specified equation space in 2D multi-line fraction format.
@@ -989,75 +1703,61 @@ static int	cur_pos;	/* current position in the current line on the screen */
  * The equation sides must first be basically simplified and prepared by fractions_and_group(),
  * for proper formatting.
  *
+ * All lines are rendered in one pass, each into its own string buffer.
+ *
  * Return NULL on failure.
- * Result will be limited to current_columns columns, TEXT_ROWS lines.
- * Exceeding current_columns will result in truncation,
+ * Result will be limited to screen_columns columns (TEXT_COLUMNS if 0), TEXT_ROWS lines.
+ * Exceeding the columns will result in truncation,
  * exceeding TEXT_ROWS will result in failure and NULL return.
- * current_columns is set in malloc_vscreen().
  */
 char *
 flist_equation_string(n)
 int	n;	/* equation space number */
 {
-	int	i;
-	int	len, cur_len, buf_len;
-	int	pos;
-	int	high = 0, low = 0;
-	int	max_line = 0, min_line = 0;
-	int	screen_line;
-	char	*cp;
+	int		i;
+	int		pos;
+	int		high = 0, low = 0;
+	int		max_line = 0, min_line = 0;
+	int		n_rows;
+	strbuf_type	rows[TEXT_ROWS], sb;
 
 	if (empty_equation_space(n))
 		return NULL;
-	if (!malloc_vscreen())
-		return NULL;
-	for (i = 0; i < TEXT_ROWS; i++) {
-		vscreen[i][0] = '\0';
-	}
-	cur_line = 0;
-	cur_pos = 0;
-	len = flist_sub(lhs[n], n_lhs[n], false, NULL, current_columns, 0, &max_line, &min_line);
+	row_columns = (screen_columns > 0) ? screen_columns : TEXT_COLUMNS;
+	pos = flist_sub(lhs[n], n_lhs[n], false, NULL, 0, &max_line, &min_line);
 	if (n_rhs[n]) {
-		len += strlen(EQUATE_STRING);
-		len += flist_sub(rhs[n], n_rhs[n], false, NULL, current_columns, 0, &high, &low);
+		pos += strlen(EQUATE_STRING);
+		flist_sub(rhs[n], n_rhs[n], false, NULL, pos, &high, &low);
 		if (high > max_line)
 			max_line = high;
 		if (low < min_line)
 			min_line = low;
 	}
-	if ((max_line - min_line) >= TEXT_ROWS)
+	n_rows = max_line - min_line + 1;
+	if (n_rows > TEXT_ROWS)
 		return NULL;
-	for (cur_line = max_line, screen_line = 0; cur_line >= min_line; cur_line--, screen_line++) {
-		pos = cur_pos = 0;
-		pos += flist_sub(lhs[n], n_lhs[n], true, vscreen[screen_line], current_columns, pos, &high, &low);
-		if (n_rhs[n]) {
-			if (cur_line == 0) {
-				cur_pos += strlen(EQUATE_STRING);
-				cur_len = strlen(vscreen[screen_line]);
-				if ((current_columns - cur_len) > 0)
-					my_strlcpy(&vscreen[screen_line][cur_len], EQUATE_STRING, current_columns - cur_len);
-			}
-			pos += strlen(EQUATE_STRING);
-			pos += flist_sub(rhs[n], n_rhs[n], true, vscreen[screen_line], current_columns, pos, &high, &low);
-		}
+	top_line = max_line;
+	for (i = 0; i < n_rows; i++) {
+		strbuf_init(&rows[i]);
+		row_pos[i] = 0;
 	}
-	if (screen_line <= 0)
-		return NULL;
-	for (i = 0, buf_len = 1; i < screen_line; i++) {
-		buf_len += strlen(vscreen[i]);
-		buf_len++;	/* For newlines */
-	}
-	cp = (char *) malloc(buf_len);
-	if (cp == NULL) {
-		error(_("Out of memory (can't malloc(3))."));
-		return NULL;
+	pos = flist_sub(lhs[n], n_lhs[n], true, rows, 0, &high, &low);
+	if (n_rhs[n]) {
+		flist_append(rows, 0, EQUATE_STRING);
+		row_pos[top_line] += strlen(EQUATE_STRING);
+		pos += strlen(EQUATE_STRING);
+		flist_sub(rhs[n], n_rhs[n], true, rows, pos, &high, &low);
 	}
-	cp[0] = '\0';
-	for (i = 0; i < screen_line; i++) {
-		strcat(cp, vscreen[i]);
-		strcat(cp, "\n");
+	strbuf_init(&sb);
+	for (i = 0; i < n_rows; i++) {
+		if (rows[i].str)
+			strbuf_appendn(&sb, rows[i].str, rows[i].len);
+		strbuf_append(&sb, "\n");
+		if (rows[i].failed)
+			sb.failed = true;
+		free(rows[i].str);
 	}
-	return(cp);
+	return strbuf_finish(&sb);
 }
 
 /*
@@ -1094,11 +1794,11 @@ int	n;	/* equation space number */
 	cur_line = 0;
 	cur_pos = 0;
 	sind = n_rhs[n];
-	len += flist_sub(lhs[n], n_lhs[n], false, NULL, screen_columns, 0, &max_line, &min_line);
+	len += flist_sub(lhs[n], n_lhs[n], false, NULL, 0, &max_line, &min_line);
 	if (n_rhs[n]) {
 		len += strlen(EQUATE_STRING);
 make_smaller:
-		len2 = flist_sub(rhs[n], sind, false, NULL, screen_columns, 0, &high, &low);
+		len2 = flist_sub(rhs[n], sind, false, NULL, 0, &high, &low);
 		if (screen_columns && use_screen_columns && (len + len2) >= screen_columns && sind > 0) {
 			for (sind--; sind > 0; sind--) {
 				if (rhs[n][sind].level == 1 && rhs[n][sind].kind == OPERATOR) {
@@ -1116,7 +1816,7 @@ make_smaller:
 			max_line = high;
 		if (low < min_line)
 			min_line = low;
-		len3 = flist_sub(&rhs[n][sind], n_rhs[n] - sind, false, NULL, screen_columns, 0, &max2_line, &min2_line);
+		len3 = flist_sub(&rhs[n][sind], n_rhs[n] - sind, false, NULL, 0, &max2_line, &min2_line);
 	} else {
 		len2 = 0;
 		len3 = 0;
@@ -1139,13 +1839,13 @@ make_smaller:
 			cur_pos += fprintf(gfp, "%s", buf);
 		}
 		pos += strlen(buf);
-		pos += flist_sub(lhs[n], n_lhs[n], true, NULL, screen_columns, pos, &high, &low);
+		pos += flist_sub(lhs[n], n_lhs[n], true, NULL, pos, &high, &low);
 		if (n_rhs[n]) {
 			if (cur_line == 0) {
 				cur_pos += fprintf(gfp, "%s", EQUATE_STRING);
 			}
 			pos += strlen(EQUATE_STRING);
-			pos += flist_sub(rhs[n], sind, true, NULL, screen_columns, pos, &high, &low);
+			pos += flist_sub(rhs[n], sind, true, NULL, pos, &high, &low);
 		}
 		fprintf(gfp, "\n");
 	}
@@ -1154,7 +1854,7 @@ make_smaller:
 		fprintf(gfp, "\n");
 		for (cur_line = max2_line; cur_line >= min2_line; cur_line--) {
 			cur_pos = 0;
-			flist_sub(&rhs[n][sind], n_rhs[n] - sind, true, NULL, screen_columns, 0, &high, &low);
+			flist_sub(&rhs[n][sind], n_rhs[n] - sind, true, NULL, 0, &high, &low);
 			fprintf(gfp, "\n");
 		}
 	}
@@ -1167,6 +1867,8 @@ make_smaller:
  * The number of the line to output is stored in the global variable cur_line.
  * 0 is the middle line, lines above are positive, lines below are negative.
  * Use color if available.
+ * If "rows" is not NULL, output all lines at once instead,
+ * appending line number "line" to rows[top_line - line].
  *
  * The following functions are for internal use only, and not to be called,
  * except by flist_equation() and flist_equation_string().
@@ -1174,31 +1876,50 @@ make_smaller:
  * Return the width of the expression (that is, the required number of screen columns).
  */
 static int
-flist_sub(p1, n, out_flag, string, sbuffer_size, pos, highp, lowp)
+flist_sub(p1, n, out_flag, rows, pos, highp, lowp)
 token_type	*p1;		/* expression pointer */
 int		n;		/* length of expression */
-int		out_flag;	/* if true, output to gfp or string */
-char		*string;	/* if not NULL, put output to here instead of gfp */
-int		sbuffer_size;	/* string buffer size */
+int		out_flag;	/* if true, output to gfp or rows */
+strbuf_type	*rows;		/* if not NULL, put output to here instead of gfp */
 int		pos;
 int		*highp, *lowp;
 {
 	int	rv;
 
-	rv = flist_recurse(p1, n, out_flag, string, sbuffer_size, 0, pos, 1, highp, lowp);
-	if (out_flag && (string == NULL)) {
+	rv = flist_recurse(p1, n, out_flag, rows, 0, pos, 1, highp, lowp);
+	if (out_flag && (rows == NULL)) {
 		default_color();
 	}
 	return rv;
 }
 
+/*
+ * Append "str" to the string buffer for line number "line",
+ * truncating the line to row_columns characters.
+ */
+static void
+flist_append(rows, line, str)
+strbuf_type	*rows;
+int		line;
+char		*str;
+{
+	strbuf_type	*sb;
+	int		len;
+
+	sb = &rows[top_line - line];
+	len = strlen(str);
+	if (len > row_columns - 1 - sb->len)
+		len = row_columns - 1 - sb->len;
+	if (len > 0)
+		strbuf_appendn(sb, str, len);
+}
+
 static int
-flist_recurse(p1, n, out_flag, string, sbuffer_size, line, pos, cur_level, highp, lowp)
+flist_recurse(p1, n, out_flag, rows, line, pos, cur_level, highp, lowp)
 token_type	*p1;
 int		n;
-int		out_flag;	/* if true, output to gfp or string */
-char		*string;	/* if not NULL, put output to here instead of gfp */
-int		sbuffer_size;	/* string buffer size */
+int		out_flag;	/* if true, output to gfp or rows */
+strbuf_type	*rows;		/* if not NULL, put output to here instead of gfp */
 int		line;
 int		pos;
 int		cur_level;
@@ -1214,36 +1935,50 @@ int		*highp, *lowp;
 	int	start_level;
 	int	oflag, cflag, html_out, power_flag;
 	int	len = 0, len1, len2;
-	int	current_len = 0;
 	int	high, low;
+	int	min_div_level;
+	int	*posp;
 	char	buf[500];
 	char	*cp;
 
-	if (string)
-		current_len = strlen(string);
 	start_level = cur_level;
 	*highp = line;
 	*lowp = line;
 	if (n <= 0) {
 		return 0;
 	}
-	oflag = (out_flag && line == cur_line);
-	cflag = (oflag && string == NULL);
+	if (rows) {
+		oflag = out_flag;
+		posp = &row_pos[top_line - line];
+	} else {
+		oflag = (out_flag && line == cur_line);
+		posp = &cur_pos;
+	}
+	cflag = (oflag && rows == NULL);
 #if	LIBRARY
 	html_out = html_flag;
 #else
 	html_out = (html_flag && gfp == stdout);
 #endif
 	if (oflag) {
-		for (; cur_pos < pos; cur_pos++) {
+		for (; *posp < pos; (*posp)++) {
 			APPEND2(" ");
 		}
 	}
+	min_div_level = INT_MAX;
+	for (i = 1; i < n; i += 2) {
+		if (p1[i].token.operatr == DIVIDE && p1[i].level < min_div_level)
+			min_div_level = p1[i].level;
+	}
 	ii = 0;
 check_again:
 	stop_at = n;
 	div_loc = -1;
 	for (i = ii; i < n; i++) {
+		if (div_loc >= 0 && (p1[div_loc].level == min_div_level || p1[i].level < min_div_level)) {
+			/* A later fraction can only start before this one at a lower level, without any lower level between. */
+			break;
+		}
 		if (p1[i].kind == OPERATOR && p1[i].token.operatr == DIVIDE) {
 			level = p1[i].level;
 			for (j = i - 2; j > 0; j -= 2) {
@@ -1318,13 +2053,13 @@ check_again:
 		}
 		if (i == stop_at) {
 			level = p1[div_loc].level;
-			len1 = flist_recurse(&p1[stop_at], div_loc - stop_at, false, string, sbuffer_size, line + 1, pos + len, level, &high, &low);
+			len1 = flist_recurse(&p1[stop_at], div_loc - stop_at, false, rows, line + 1, pos + len, level, &high, &low);
 			l1 = (2 * (line + 1)) - low;
 			for (j = div_loc + 2; j < n; j += 2) {
 				if (p1[j].level <= level)
 					break;
 			}
-			len2 = flist_recurse(&p1[div_loc+1], j - (div_loc + 1), false, string, sbuffer_size, line - 1, pos + len, level, &high, &low);
+			len2 = flist_recurse(&p1[div_loc+1], j - (div_loc + 1), false, rows, line - 1, pos + len, level, &high, &low);
 			l2 = (2 * (line - 1)) - high;
 			ii = j;
 			len_div = max(len1, len2);
@@ -1332,7 +2067,7 @@ check_again:
 			if (len1 < len_div) {
 				j = (len_div - len1) / 2;
 			}
-			flist_recurse(&p1[stop_at], div_loc - stop_at, out_flag, string, sbuffer_size, l1, pos + len + j, level, &high, &low);
+			flist_recurse(&p1[stop_at], div_loc - stop_at, out_flag, rows, l1, pos + len + j, level, &high, &low);
 			if (high > *highp)
 				*highp = high;
 			if (low < *lowp)
@@ -1355,7 +2090,7 @@ check_again:
 			if (len2 < len_div) {
 				j = (len_div - len2) / 2;
 			}
-			flist_recurse(&p1[div_loc+1], ii - (div_loc + 1), out_flag, string, sbuffer_size, l2, pos + len + j, level, &high, &low);
+			flist_recurse(&p1[div_loc+1], ii - (div_loc + 1), out_flag, rows, l2, pos + len + j, level, &high, &low);
 			if (high > *highp)
 				*highp = high;
 			if (low < *lowp)
@@ -1394,6 +2129,14 @@ check_again:
 					len += snprintf(buf, sizeof(buf), "%.*f", finance_option, p1[i].token.constant);
 #endif
 				}
+			} else if (exact_string(p1[i].token.constant, buf, sizeof(buf) - 2)) {
+				if (p1[i].token.constant < 0.0 && (i + 1) < n && p1[i+1].level == p1[i].level
+				    && (p1[i+1].token.operatr >= POWER)) {
+					blt(&buf[1], buf, strlen(buf) + 1);
+					buf[0] = '(';
+					strcat(buf, ")");
+				}
+				len += strlen(buf);
 			} else {
 				if (p1[i].token.constant < 0.0 && (i + 1) < n && p1[i+1].level == p1[i].level
 				    && (p1[i+1].token.operatr >= POWER)) {
@@ -1504,6 +2247,6 @@ check_again:
 		}
 	}
 	if (oflag)
-		cur_pos += len;
+		*posp += len;
 	return len;
 }
@@ -362,7 +362,7 @@ char	**argv;
 			for (i = optind; i < argc && argv[i]; i++) {
 				if (strcmp(argv[i], "-") == 0) {
 					main_io_loop();
-				} else if (!read_file(argv[i])) {
+				} else if (!read_file(argv[i], false)) {
 					fflush(NULL);	/* flush all output */
 					fprintf(stderr, _("Read of file \"%s\" failed.\n"), argv[i]);
 					exit_program(1);
@@ -0,0 +1,98 @@
+/*
+ * Benchmark for the per-command overhead of matho_process(),
+ * running a script of many short commands,
+ * with equation spaces empty and then filled with large expressions,
+ * then searching for a variable in only the last equation space,
+ * then entering an expression that needs a new sign variable many times.
+ *
+ * Compile with:
+ *
+ * (cd ../lib.js && make lib)
+ * cc -O3 -DUNIX -DLIBRARY cmdbench.c ../lib.js/libmathomatic.a -lm -o cmdbench
+ *
+ * then type "./cmdbench".
+ */
+
+#include "../includes.h"
+#include "../lib.js/mathomatic.h"
+#include <time.h>
+
+#define	N_COMMANDS	20000	/* number of commands run per test */
+#define	N_SPACES	150	/* number of large equation spaces filled */
+#define	N_TERMS		1000	/* number of terms in each large expression */
+
+static char	*script[] = {	/* short commands, repeated in order */
+	"set precision 14",
+	"#1",
+	"vers",
+	"set no autoselect",
+	"set autoselect",
+};
+
+static char	*search_script[] = {	/* variable searches that pass all of the large equation spaces */
+	"/z",
+	"#1",
+	"#z",
+	"#1",
+};
+
+static char	*sign_script[] = {	/* each of these makes a new sign variable */
+	"#190 t=+/-2",
+};
+
+static char	buf[N_TERMS * 30 + 100];
+
+/*
+ * Return the average number of microseconds to run each command in "script".
+ */
+static double
+time_script(char **script, int n)
+{
+	int	i;
+	clock_t	start;
+	char	*out;
+
+	start = clock();
+	for (i = 0; i < N_COMMANDS; i++) {
+		if (matho_process(script[i % n], &out)) {
+			if (out)
+				free(out);
+		} else {
+			printf("\"%s\" failed: %s\n", script[i % n], out);
+			return -1.0;
+		}
+	}
+	return (double) (clock() - start) * 1000000.0 / CLOCKS_PER_SEC / N_COMMANDS;
+}
+
+int
+main(int argc, char **argv)
+{
+	int	i, j;
+
+	if (!matho_init()) {
+		fprintf(stderr, "Not enough memory.\n");
+		return 1;
+	}
+	matho_process("x=1", NULL);
+	printf("Microseconds per short command:\n\n");
+	printf("with 1 small equation space: %10.3f\n", time_script(script, ARR_CNT(script)));
+	for (i = 0; i < N_SPACES; i++) {
+		strcpy(buf, "");
+		for (j = 1; j <= N_TERMS; j++) {
+			sprintf(&buf[strlen(buf)], "%s%d*x^%d*y", (j > 1) ? "+" : "", j + i, j);
+		}
+		if (!matho_parse(buf, NULL)) {
+			printf("Error entering expression.\n");
+			return 1;
+		}
+	}
+	matho_parse("z=2", NULL);
+	matho_process("#1", NULL);
+	printf("with %d large equation spaces: %10.3f\n", N_SPACES, time_script(script, ARR_CNT(script)));
+	printf("searching for a variable, with %d large equation spaces: %10.3f\n", N_SPACES,
+	    time_script(search_script, ARR_CNT(search_script)));
+	printf("making sign variables, with %d large equation spaces: %10.3f\n", N_SPACES,
+	    time_script(sign_script, ARR_CNT(sign_script)));
+	return 0;
+}
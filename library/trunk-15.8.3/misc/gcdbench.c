@@ -0,0 +1,134 @@
+/*
+ * Microbenchmark for the Mathomatic gcd() and f_to_fraction() functions.
+ *
+ * Times gcd() against a copy of the original fmod(3) based floating point
+ * Euclidean loop, checks that both always give identical results,
+ * then times f_to_fraction() on a few hundred distinct fractions,
+ * repeated many times, like simplification does.
+ *
+ * Compile with:
+ *
+ * (cd ../lib.js && make lib)
+ * cc -O3 -DUNIX -DLIBRARY gcdbench.c ../lib.js/libmathomatic.a -lm -o gcdbench
+ *
+ * then type "./gcdbench".
+ */
+
+#include "../includes.h"
+#include <time.h>
+
+#define	N_PAIRS		100000	/* number of random integer pairs */
+#define	N_REPEAT	20	/* number of times to repeat each pair */
+#define	N_FRACTIONS	300	/* number of distinct fractions */
+
+static double	d1s[N_PAIRS], d2s[N_PAIRS];
+
+/*
+ * The original floating point gcd() loop, for comparison.
+ */
+static double
+float_gcd(double d1, double d2)
+{
+	int	count;
+	double	larger, divisor, remainder1, lower_limit;
+
+	if (!isfinite(d1) || !isfinite(d2)) {
+		return 0.0;
+	}
+	d1 = fabs(d1);
+	d2 = fabs(d2);
+	if (d1 == 0)
+		return d2;
+	if (d2 == 0)
+		return d1;
+	if (d1 > d2) {
+		larger = d1;
+		divisor = d2;
+	} else {
+		larger = d2;
+		divisor = d1;
+	}
+	lower_limit = larger * epsilon;
+	if (divisor <= lower_limit || larger >= MAX_K_INTEGER) {
+		return 0.0;
+	}
+	for (count = 1; count < 50; count++) {
+		remainder1 = fabs(fmod(larger, divisor));
+		if (remainder1 <= lower_limit || fabs(divisor - remainder1) <= lower_limit) {
+			if (remainder1 != 0.0 && divisor <= (100.0 * lower_limit))
+				return 0.0;
+			return divisor;
+		}
+		larger = divisor;
+		divisor = remainder1;
+	}
+	return 0.0;
+}
+
+static double
+random_integer(double limit)
+{
+	return floor(((double) rand() * RAND_MAX + rand()) / ((double) RAND_MAX * RAND_MAX) * limit);
+}
+
+static double
+seconds(clock_t start)
+{
+	return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int
+main(int argc, char **argv)
+{
+	int		i, j, mismatches = 0;
+	double		sum, t_float, t_gcd, t_frac;
+	double		numerator, denominator;
+	clock_t		start;
+
+	srand(1);
+	for (i = 0; i < N_PAIRS; i++) {
+		if (i & 1) {
+			d1s[i] = random_integer(1.0e6) * 12.0;
+			d2s[i] = random_integer(1.0e6) * 18.0;
+		} else {
+			d1s[i] = random_integer(MAX_K_INTEGER);
+			d2s[i] = random_integer(1.0e9);
+		}
+		if (gcd(d1s[i], d2s[i]) != float_gcd(d1s[i], d2s[i])) {
+			printf("Mismatch: gcd(%.0f, %.0f)\n", d1s[i], d2s[i]);
+			mismatches++;
+		}
+	}
+	sum = 0.0;
+	start = clock();
+	for (j = 0; j < N_REPEAT; j++)
+		for (i = 0; i < N_PAIRS; i++)
+			sum += float_gcd(d1s[i], d2s[i]);
+	t_float = seconds(start);
+	start = clock();
+	for (j = 0; j < N_REPEAT; j++)
+		for (i = 0; i < N_PAIRS; i++)
+			sum -= gcd(d1s[i], d2s[i]);
+	t_gcd = seconds(start);
+	if (sum != 0.0)
+		mismatches++;
+	start = clock();
+	for (j = 0; j < N_REPEAT * N_PAIRS / N_FRACTIONS; j++) {
+		for (i = 1; i <= N_FRACTIONS; i++) {
+			f_to_fraction((double) i / (double) (i % 97 + 2), &numerator, &denominator);
+		}
+	}
+	t_frac = seconds(start);
+
+	printf("%d gcd() calls on integer pairs:\n", N_PAIRS * N_REPEAT);
+	printf("  floating point loop: %.3f seconds\n", t_float);
+	printf("  gcd():               %.3f seconds\n", t_gcd);
+	printf("%d f_to_fraction() calls on %d distinct fractions: %.3f seconds\n", N_PAIRS * N_REPEAT, N_FRACTIONS, t_frac);
+	printf("Fraction conversion cache: %ld hits out of %ld lookups.\n", fraction_cache_hits, fraction_cache_lookups);
+	if (mismatches) {
+		printf("%d mismatches found!\n", mismatches);
+		return 1;
+	}
+	printf("All gcd() results identical.\n");
+	return 0;
+}
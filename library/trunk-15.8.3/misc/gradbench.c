@@ -0,0 +1,154 @@
+/*
+ * Benchmark for "code gradient", the reverse-mode automatic differentiation
+ * code generator, against the symbolic route of taking each partial
+ * derivative with the derivative command and outputting it with "code".
+ *
+ * The objective function has N variables, all coupled through a shared
+ * sum of squares, so each symbolic partial derivative is of size N.
+ * Times the code generation, then compiles both generated functions
+ * into one test program, which checks that they agree and times them.
+ *
+ * Compile with:
+ *
+ * (cd ../lib.js && make lib)
+ * cc -O3 -DUNIX -DLIBRARY gradbench.c ../lib.js/libmathomatic.a -lm -o gradbench
+ *
+ * then type "./gradbench [N]".  The default is N=12 variables.
+ * The symbolic route gets slow quickly with increasing N.
+ */
+
+#include "../includes.h"
+#include "../lib.js/mathomatic.h"
+#include <time.h>
+
+#define	GEN_FILE	"/tmp/gradbench_gen.c"	/* generated test program */
+#define	GEN_PROGRAM	"/tmp/gradbench_gen"	/* compiled test program */
+#define	N_EVALUATIONS	100000			/* number of gradient evaluations timed */
+
+static double
+seconds(clock_t start)
+{
+	return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+/*
+ * Append the sum of squares of the N variables to buf.
+ */
+static void
+sum_of_squares(char *buf, int n)
+{
+	int	i;
+
+	strcat(buf, "(");
+	for (i = 1; i <= n; i++) {
+		sprintf(&buf[strlen(buf)], "%sx%d^2", (i > 1) ? "+" : "", i);
+	}
+	strcat(buf, ")");
+}
+
+int
+main(int argc, char **argv)
+{
+	int	i, n = 12;
+	char	*buf, *out, *cp;
+	char	cmd[200];
+	clock_t	start;
+	double	t_reverse, t_symbolic;
+	FILE	*fp;
+
+	if (argc > 1)
+		n = atoi(argv[1]);
+	if (n < 2 || n > 200) {
+		fprintf(stderr, "N must be from 2 to 200.\n");
+		return 1;
+	}
+	if (!matho_init() || (buf = (char *) malloc(n * n * 40 + 1000)) == NULL) {
+		fprintf(stderr, "Not enough memory.\n");
+		return 1;
+	}
+/* f = sum((x[i] - x[i+1])^2/(1 + sum of squares)) + (sum of squares)^(1/2) */
+	strcpy(buf, "f=");
+	for (i = 1; i < n; i++) {
+		sprintf(&buf[strlen(buf)], "(x%d-x%d)^2/(1+", i, i + 1);
+		sum_of_squares(buf, n);
+		strcat(buf, ")+");
+	}
+	sum_of_squares(buf, n);
+	strcat(buf, "^(1/2)");
+	if (!matho_process(buf, NULL)) {
+		fprintf(stderr, "Error entering the objective function.\n");
+		return 1;
+	}
+	if ((fp = fopen(GEN_FILE, "w")) == NULL) {
+		perror(GEN_FILE);
+		return 1;
+	}
+	fprintf(fp, "#include <stdio.h>\n#include <stdlib.h>\n#include <math.h>\n#include <time.h>\n\n");
+	start = clock();
+	if (!matho_process("code gradient 1", &out)) {
+		fprintf(stderr, "code gradient failed: %s\n", out);
+		return 1;
+	}
+	t_reverse = seconds(start);
+	fprintf(fp, "%s\n", out);
+	free(out);
+	fprintf(fp, "double\nf_symbolic(");
+	for (i = 1; i <= n; i++)
+		fprintf(fp, "double x%d, ", i);
+	fprintf(fp, "double grad[])\n{\n");
+	start = clock();
+	for (i = 1; i <= n; i++) {
+		sprintf(cmd, "derivative x%d", i);
+		if (!matho_process("1", NULL) || !matho_process(cmd, NULL) || !matho_process("code", &out)) {
+			fprintf(stderr, "Symbolic derivative failed.\n");
+			return 1;
+		}
+		cp = strstr(out, " = ");
+		fprintf(fp, "\tgrad[%d]%s\n", i - 1, cp ? cp : out);
+		free(out);
+	}
+	t_symbolic = seconds(start);
+	if (!matho_process("1", NULL) || !matho_process("code", &out)) {
+		return 1;
+	}
+	cp = strstr(out, " = ");
+	fprintf(fp, "\treturn%s\n}\n\n", cp ? &cp[2] : out);
+	free(out);
+/* the test program */
+	fprintf(fp, "int\nmain(void)\n{\n\tint i, j, errors = 0;\n\tdouble x[%d], g1[%d], g2[%d], sum = 0.0;\n\tclock_t start;\n\n", n, n, n);
+	fprintf(fp, "\tsrand(1);\n\tfor (j = 0; j < 100; j++) {\n\t\tfor (i = 0; i < %d; i++)\n\t\t\tx[i] = (double) rand() / RAND_MAX * 2.0 - 1.0;\n", n);
+	fprintf(fp, "\t\tif (fabs(f_gradient(");
+	for (i = 0; i < n; i++)
+		fprintf(fp, "x[%d], ", i);
+	fprintf(fp, "g1) - f_symbolic(");
+	for (i = 0; i < n; i++)
+		fprintf(fp, "x[%d], ", i);
+	fprintf(fp, "g2)) > 1e-9)\n\t\t\terrors++;\n");
+	fprintf(fp, "\t\tfor (i = 0; i < %d; i++)\n\t\t\tif (fabs(g1[i] - g2[i]) > 1e-9 * (1.0 + fabs(g1[i])))\n\t\t\t\terrors++;\n\t}\n", n);
+	fprintf(fp, "\tstart = clock();\n\tfor (j = 0; j < %d; j++) {\n\t\tx[j %% %d] += 1e-9;\n\t\tsum += f_gradient(", N_EVALUATIONS, n);
+	for (i = 0; i < n; i++)
+		fprintf(fp, "x[%d], ", i);
+	fprintf(fp, "g1) + g1[0];\n\t}\n\tprintf(\"  reverse mode:  %%.3f seconds\\n\", (double) (clock() - start) / CLOCKS_PER_SEC);\n");
+	fprintf(fp, "\tstart = clock();\n\tfor (j = 0; j < %d; j++) {\n\t\tx[j %% %d] += 1e-9;\n\t\tsum += f_symbolic(", N_EVALUATIONS, n);
+	for (i = 0; i < n; i++)
+		fprintf(fp, "x[%d], ", i);
+	fprintf(fp, "g2) + g2[0];\n\t}\n");
+	fprintf(fp, "\tprintf(\"  symbolic:      %%.3f seconds\\n\", (double) (clock() - start) / CLOCKS_PER_SEC);\n");
+	fprintf(fp, "\tif (errors || sum == 0.0) {\n\t\tprintf(\"%%d gradient mismatches!\\n\", errors);\n\t\treturn 1;\n\t}\n");
+	fprintf(fp, "\tprintf(\"All gradients agree.\\n\");\n\treturn 0;\n}\n");
+	fclose(fp);
+
+	printf("Objective function with %d variables.\n", n);
+	printf("Code generation time:\n");
+	printf("  code gradient: %.3f seconds\n", t_reverse);
+	printf("  derivative:    %.3f seconds\n", t_symbolic);
+	fflush(stdout);
+	snprintf(cmd, sizeof(cmd), "cc -O2 %s -lm -o %s", GEN_FILE, GEN_PROGRAM);
+	if (system(cmd) != 0) {
+		fprintf(stderr, "Compiling %s failed.\n", GEN_FILE);
+		return 1;
+	}
+	printf("Time for %d evaluations of the value and gradient:\n", N_EVALUATIONS);
+	fflush(stdout);
+	return(system(GEN_PROGRAM) != 0);
+}
@@ -0,0 +1,94 @@
+/*
+ * Benchmark for the polynomial integration and Laplace transform commands,
+ * on univariate and bivariate polynomials with thousands of terms.
+ * Use "set debug 1" in Mathomatic to see how many terms each integration rule transformed.
+ * The integrate command is only tested with hundreds of terms,
+ * because it fully simplifies its result, which takes much longer than the integration.
+ *
+ * Compile with:
+ *
+ * (cd ../lib.js && make lib)
+ * cc -O3 -DUNIX -DLIBRARY intbench.c ../lib.js/libmathomatic.a -lm -o intbench
+ *
+ * then type "./intbench".
+ */
+
+#include "../includes.h"
+#include "../lib.js/mathomatic.h"
+#include <time.h>
+
+#define	MAX_TERMS	2000	/* largest number of polynomial terms tested */
+
+static char	buf[MAX_TERMS * 40 + 100];
+
+/*
+ * Enter a polynomial with n terms into equation space 1,
+ * univariate in x if "bivariate" is false, otherwise in x and y.
+ */
+static int
+enter_poly(int n, int bivariate)
+{
+	int	i;
+
+	strcpy(buf, "p=");
+	for (i = 0; i < n; i++) {
+		if (bivariate) {
+			sprintf(&buf[strlen(buf)], "%s%d*x^%d*y^%d", (i > 0) ? "+" : "", i % 97 + 2, i / 10, i % 10);
+		} else {
+			sprintf(&buf[strlen(buf)], "%s%d*x^%d", (i > 0) ? "+" : "", i % 97 + 2, i);
+		}
+	}
+	return(matho_process("clear all", NULL) && matho_process(buf, NULL));
+}
+
+/*
+ * Return the number of seconds to run command "cmd" on the current equation.
+ */
+static double
+time_command(char *cmd)
+{
+	clock_t	start;
+	char	*out;
+
+	start = clock();
+	if (!matho_process(cmd, &out)) {
+		printf("\"%s\" failed: %s\n", cmd, out);
+		return -1.0;
+	}
+	free(out);
+	return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int
+main(int argc, char **argv)
+{
+	int	n, bivariate;
+
+	if (!matho_init()) {
+		fprintf(stderr, "Not enough memory.\n");
+		return 1;
+	}
+	printf("Seconds per command on polynomials with n terms:\n\n");
+	printf("%8s %10s %12s %20s\n", "n", "variables", "laplace x", "laplace inverse x");
+	for (bivariate = false; bivariate <= true; bivariate++) {
+		for (n = 500; n <= MAX_TERMS; n *= 2) {
+			if (!enter_poly(n, bivariate)) {
+				printf("Error entering polynomial.\n");
+				return 1;
+			}
+			printf("%8d %10s %12.3f", n, bivariate ? "x, y" : "x", time_command("laplace x"));
+			printf(" %20.3f\n", time_command("laplace inverse x"));
+			fflush(stdout);
+		}
+	}
+	printf("\n%8s %10s %12s\n", "n", "variables", "integrate x");
+	for (n = 25; n <= 200; n *= 2) {
+		if (!enter_poly(n, false)) {
+			printf("Error entering polynomial.\n");
+			return 1;
+		}
+		printf("%8d %10s %12.3f\n", n, "x", time_command("integrate x"));
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * Benchmark for the library result strings, on expressions of up to 50,000 tokens.
+ * Times the "list" command, which returns the single-line format string,
+ * and the "display" command, which returns the 2D multi-line fraction format string,
+ * with the screen width set wide enough that nothing is truncated.
+ *
+ * Compile with:
+ *
+ * (cd ../lib.js && make lib)
+ * cc -O3 -DUNIX -DLIBRARY listbench.c ../lib.js/libmathomatic.a -lm -o listbench
+ *
+ * then type "./listbench".
+ */
+
+#include "../includes.h"
+#include "../lib.js/mathomatic.h"
+#include <time.h>
+
+#define	MAX_TERMS	5000	/* largest number of terms tested, 10 tokens each */
+#define	REPEAT		10	/* number of times each command is timed */
+
+static char	buf[MAX_TERMS * 40 + 100];
+
+/*
+ * Enter a sum of n fractions into equation space 1.
+ */
+static int
+enter_sum(int n)
+{
+	int	i;
+
+	strcpy(buf, "p=");
+	for (i = 1; i <= n; i++) {
+		sprintf(&buf[strlen(buf)], "%s(x^%d+%d)/(y+%d)", (i > 1) ? "+" : "", i, i, i + 1);
+	}
+	return(matho_process("clear all", NULL) && matho_process(buf, NULL));
+}
+
+/*
+ * Return the average number of seconds to run command "cmd" on the current equation,
+ * and the length of its result string in "lenp".
+ */
+static double
+time_command(char *cmd, int *lenp)
+{
+	int	i;
+	clock_t	start;
+	char	*out;
+
+	start = clock();
+	for (i = 0; i < REPEAT; i++) {
+		if (!matho_process(cmd, &out)) {
+			printf("\"%s\" failed: %s\n", cmd, out);
+			return -1.0;
+		}
+		*lenp = strlen(out);
+		free(out);
+	}
+	return (double) (clock() - start) / CLOCKS_PER_SEC / REPEAT;
+}
+
+int
+main(int argc, char **argv)
+{
+	int	n, len1 = 0, len2 = 0;
+	double	t1, t2;
+
+	if (!matho_init()) {
+		fprintf(stderr, "Not enough memory.\n");
+		return 1;
+	}
+	matho_process("set columns 1000000", NULL);
+	printf("Seconds per command on a sum of n fractions of 10 tokens each:\n\n");
+	printf("%8s %12s %12s %12s %12s\n", "n", "list", "characters", "display", "characters");
+	for (n = 625; n <= MAX_TERMS; n *= 2) {
+		if (!enter_sum(n)) {
+			printf("Error entering expression.\n");
+			return 1;
+		}
+		t1 = time_command("list", &len1);
+		t2 = time_command("display", &len2);
+		printf("%8d %12.4f %12d %12.4f %12d\n", n, t1, len1, t2, len2);
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * Benchmark for the Mathomatic dense polynomial multiplication routines,
+ * showing the crossover points between long multiplication, Karatsuba,
+ * and NTT (number-theoretic transform) multiplication.
+ * Use the results to set KARATSUBA_CUTOFF and NTT_CUTOFF in poly.c.
+ *
+ * Compile with:
+ *
+ * (cd ../lib.js && make lib)
+ * cc -O3 -DUNIX -DLIBRARY polybench.c ../lib.js/libmathomatic.a -lm -o polybench
+ *
+ * then type "./polybench".
+ */
+
+#include "../includes.h"
+#include <time.h>
+
+#define	MAX_N	262144		/* largest number of coefficients tested */
+#define	MAX_LONG_N	4096	/* largest number of coefficients tested with long multiplication */
+#define	MIN_CLOCKS	(CLOCKS_PER_SEC / 5)	/* minimum time to run each test */
+
+static double	a[MAX_N], b[MAX_N], r1[2*MAX_N], r2[2*MAX_N], r3[2*MAX_N];
+
+/*
+ * Return the number of microseconds per call of method "m" on n coefficients.
+ */
+static double
+time_method(int m, int n)
+{
+	long	count;
+	clock_t	start, elapsed;
+
+	start = clock();
+	count = 0;
+	do {
+		switch (m) {
+		case 0:
+			coef_mul_school(r1, a, n, b, n);
+			break;
+		case 1:
+			coef_mul_karatsuba(r2, a, n, b, n);
+			break;
+		case 2:
+			coef_mul_ntt(r3, a, n, b, n);
+			break;
+		}
+		count++;
+		elapsed = clock() - start;
+	} while (elapsed < MIN_CLOCKS);
+	return (double) elapsed / CLOCKS_PER_SEC / count * 1.0e6;
+}
+
+int
+main(int argc, char **argv)
+{
+	int	i, n, errors = 0;
+
+	srand(1);
+	for (i = 0; i < MAX_N; i++) {
+		a[i] = rand() % 2001 - 1000;
+		b[i] = rand() % 2001 - 1000;
+	}
+	printf("Microseconds per multiply of two polynomials with n integer coefficients:\n\n");
+	printf("%8s %12s %12s %12s\n", "n", "long", "Karatsuba", "NTT");
+	for (n = 8; n <= MAX_N; n *= 2) {
+		if (n <= MAX_LONG_N) {
+			printf("%8d %12.2f", n, time_method(0, n));
+		} else {
+			printf("%8d %12s", n, "-");
+		}
+		printf(" %12.2f %12.2f\n", time_method(1, n), time_method(2, n));
+		fflush(stdout);
+		for (i = 0; i < 2 * n - 1; i++) {
+			if ((n <= MAX_LONG_N && r1[i] != r2[i]) || r2[i] != r3[i]) {
+				errors++;
+				break;
+			}
+		}
+	}
+	if (errors) {
+		printf("\nResults differ!\n");
+		return 1;
+	}
+	printf("\nAll results identical.\n");
+	return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Benchmark for substituting many variables in a large expression,
+ * one variable at a time with subst_var_with_exp(),
+ * and all at once with subst_vars_with_exps(), which the replace and calculate commands use.
+ * The expression is a sum of n products, each of 2 of the variables,
+ * and every variable is substituted with a 3 token expression.
+ *
+ * Compile with:
+ *
+ * (cd ../lib.js && make lib)
+ * cc -O3 -DUNIX -DLIBRARY substbench.c ../lib.js/libmathomatic.a -lm -o substbench
+ *
+ * then type "./substbench".
+ */
+
+#include "../includes.h"
+#include "../lib.js/mathomatic.h"
+#include <time.h>
+
+#define	MAX_TERMS	6000	/* largest number of terms tested */
+#define	N_VARS		50	/* number of variables substituted */
+#define	REPEAT		10	/* number of times each substitution is timed */
+
+static char		buf[MAX_TERMS * 20 + 100];
+static subst_type	subs[N_VARS];
+
+int
+main(int argc, char **argv)
+{
+	int	i, j, n, en;
+	long	v;
+	double	t1, t2;
+	clock_t	start;
+
+	if (!matho_init()) {
+		fprintf(stderr, "Not enough memory.\n");
+		return 1;
+	}
+	if (!matho_parse("t+1", NULL)) {
+		printf("Error entering expression.\n");
+		return 1;
+	}
+	en = cur_equation;
+	for (i = 0; i < N_VARS; i++) {
+		sprintf(buf, "v%d", i);
+		parse_var(&v, buf);
+		subs[i].v = v;
+		subs[i].expression = lhs[en];
+		subs[i].len = n_lhs[en];
+	}
+	printf("Seconds to substitute %d variables in a sum of n products:\n\n", N_VARS);
+	printf("%8s %12s %16s %12s\n", "n", "tokens", "one at a time", "all at once");
+	for (n = 750; n <= MAX_TERMS; n *= 2) {
+		strcpy(buf, "");
+		for (i = 0; i < n; i++) {
+			sprintf(&buf[strlen(buf)], "%sv%d*v%d", (i > 0) ? "+" : "", i % N_VARS, (i / N_VARS) % N_VARS);
+		}
+		if (!matho_parse(buf, NULL)) {
+			printf("Error entering expression.\n");
+			return 1;
+		}
+		start = clock();
+		for (j = 0; j < REPEAT; j++) {
+			n_tlhs = n_lhs[cur_equation];
+			blt(tlhs, lhs[cur_equation], n_tlhs * sizeof(token_type));
+			for (i = 0; i < N_VARS; i++) {
+				subst_var_with_exp(tlhs, &n_tlhs, subs[i].expression, subs[i].len, subs[i].v);
+			}
+		}
+		t1 = (double) (clock() - start) / CLOCKS_PER_SEC / REPEAT;
+		start = clock();
+		for (j = 0; j < REPEAT; j++) {
+			n_tlhs = n_lhs[cur_equation];
+			blt(tlhs, lhs[cur_equation], n_tlhs * sizeof(token_type));
+			subst_vars_with_exps(tlhs, &n_tlhs, subs, N_VARS);
+		}
+		t2 = (double) (clock() - start) / CLOCKS_PER_SEC / REPEAT;
+		printf("%8d %12d %16.5f %12.5f\n", n, n_tlhs, t1, t2);
+		fflush(stdout);
+	}
+	return 0;
+}
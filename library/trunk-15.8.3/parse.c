@@ -476,6 +476,9 @@ parse_power:
 				put_up_arrow(cp1 - cp_start, _("Constant out of range."));
 				return(NULL);
 			}
+			if (d >= MAX_K_INTEGER && strspn(cp1, "0123456789") == (size_t) (cp - cp1)) {
+				d = exact_constant(cp1, cp - cp1, d);
+			}
 			equation[n].kind = CONSTANT;
 			equation[n].token.constant = d;
 			equation[n].level = cur_level;
@@ -68,6 +68,54 @@ static int pdiv_recurse(token_type *equation, int *np, int loc, int level, int c
 static int poly_div_sub(token_type *d1, int len1, token_type *d2, int len2, long *vp);
 static int find_highest_count(token_type *p1, int n1, token_type *p2, int n2, long *vp1);
 
+/*
+ * Polynomial index data structures, see poly_index() below.
+ */
+#define	POLY_INDEX_SLOTS	4	/* number of expressions to keep indexed at once */
+
+typedef struct {	/* a remembered find_greatest_power() result */
+	int	valid;		/* true if this result has been computed */
+	int	count;		/* returned number of terms raised to the highest power */
+	double	power;		/* returned highest power */
+	int	tp, len;	/* returned term index and length */
+	int	dcode;		/* returned divide flag */
+} power_memo_type;
+
+typedef struct {	/* polynomial index entry for each variable in an expression */
+	long		v;		/* Mathomatic variable */
+	int		count;		/* number of times it occurs */
+	double		degree;		/* highest constant power it is raised to, 1 if never raised to a power */
+	int		lead_term;	/* first additive term number (origin 0) with that power */
+	int		symbolic;	/* true if it is ever raised to a non-constant power */
+	int		integral;	/* true if all its constant powers are non-negative integers */
+	signed char	in_poly[2];	/* remembered poly_in_v() results by allow_divides, -1 if unknown */
+	power_memo_type	power[4];	/* remembered find_greatest_power() results by divide flag code */
+} poly_var_type;
+
+typedef struct {
+	token_type	*p1;		/* the indexed expression */
+	int		n1;		/* length of the indexed expression */
+	unsigned long long hash;	/* poly_hash() of the indexed expression, to quickly detect changes */
+	token_type	*copy;		/* copy of the indexed expression, to detect changes exactly */
+	int		copy_size;	/* number of tokens allocated for copy[] */
+	int		n_terms;	/* number of additive terms */
+	int		*term_loc;	/* index of each term; term_loc[n_terms] is n1 + 1 */
+	int		term_size;	/* number of ints allocated for term_loc[] */
+	int		nv;		/* number of distinct variables */
+	poly_var_type	*va;		/* the variables, in ascending order */
+	int		va_size;	/* number of entries allocated for va[] */
+	long		age;		/* last use, for least recently used replacement */
+	long		generation;	/* incremented every time this index is rebuilt */
+} poly_index_type;
+
+static poly_index_type	poly_index_slots[POLY_INDEX_SLOTS];
+static long		poly_index_age;
+
+static poly_index_type *poly_index(token_type *p1, int n1);
+static int index_term(poly_index_type *ip, int count, int *tp1, int *lentp1);
+static int index_poly_in_v(poly_index_type *ip, long v, int allow_divides);
+static int index_greatest_power(poly_index_type *ip, token_type *p1, int n1, long *vp1, double *pp1, int *tp1, int *lentp1, int *dcodep);
+
 /*
  * Compare function for qsort(3).
  */
@@ -153,8 +201,12 @@ int		n;		/* expression length */
 long		v;		/* Mathomatic variable */
 int		allow_divides;	/* allow variable to be right of a divide (negative exponents) as a polynomial term */
 {
-	int	i, j;
+	int		i, j;
+	poly_index_type	*ip;
 
+	if ((ip = poly_index(p1, n)) != NULL) {
+		return index_poly_in_v(ip, v, allow_divides);
+	}
 	for (i = 1, j = 0;; i += 2) {
 		if (i >= n || (p1[i].level == 1
 		    && (p1[i].token.operatr == PLUS || p1[i].token.operatr == MINUS))) {
@@ -169,6 +221,440 @@ int		allow_divides;	/* allow variable to be right of a divide (negative exponent
 	return true;
 }
 
+/*
+ * The polynomial index routines follow.
+ *
+ * A polynomial index records, in one pass, the additive term boundaries of an expression,
+ * and the variables it contains, with how many times each occurs
+ * and the highest constant power each is raised to.
+ * It also remembers the results of poly_in_v() and find_greatest_power() calls,
+ * so that asking about the same expression and variable again doesn't rescan it.
+ * An index is reused until the indexed expression changes.
+ */
+
+/*
+ * Return the polynomial index entry for variable v, or NULL if v isn't in the expression.
+ * If "add" is true, add v to the index if it is missing; return NULL if out of memory.
+ */
+static poly_var_type *
+index_var(ip, v, add)
+poly_index_type	*ip;
+long		v;
+int		add;
+{
+	int		lo, hi, mid;
+	poly_var_type	*vp;
+
+	lo = 0;
+	hi = ip->nv;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (ip->va[mid].v < v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < ip->nv && ip->va[lo].v == v)
+		return &ip->va[lo];
+	if (!add)
+		return NULL;
+	if (ip->nv >= ip->va_size) {
+		vp = (poly_var_type *) realloc(ip->va, (ip->va_size + 32) * sizeof(poly_var_type));
+		if (vp == NULL)
+			return NULL;
+		ip->va = vp;
+		ip->va_size += 32;
+	}
+	blt(&ip->va[lo+1], &ip->va[lo], (ip->nv - lo) * sizeof(poly_var_type));
+	ip->nv++;
+	vp = &ip->va[lo];
+	memset(vp, 0, sizeof(*vp));
+	vp->v = v;
+	vp->integral = true;
+	vp->in_poly[0] = vp->in_poly[1] = -1;
+	return vp;
+}
+
+/*
+ * Return a hash value for the expression in "p1", to quickly tell if it changed since it was indexed.
+ * Equal hash values don't prove the expression is unchanged; poly_index() compares it with its copy too.
+ */
+static unsigned long long
+poly_hash(p1, n1)
+token_type	*p1;	/* expression pointer */
+int		n1;	/* expression length */
+{
+	int			i;
+	unsigned long long	h, w;
+
+	h = n1;
+	for (i = 0; i < n1; i++) {
+		h = h * 31 + p1[i].kind * 7 + p1[i].level;
+		switch (p1[i].kind) {
+		case CONSTANT:
+			memcpy(&w, &p1[i].token.constant, sizeof(w));
+			h = (h ^ w) * 1099511628211ULL;
+			break;
+		case VARIABLE:
+			h = h * 31 + p1[i].token.variable;
+			break;
+		case OPERATOR:
+			h = h * 31 + p1[i].token.operatr;
+			break;
+		}
+	}
+	return h;
+}
+
+/*
+ * Return the polynomial index of the passed expression,
+ * building it in a single pass, unless the expression is unchanged since it was last indexed.
+ * The poly_hash() is compared first, so the exact comparison with the copy is usually only done when unchanged.
+ * The returned index stays valid until the expression is modified
+ * or POLY_INDEX_SLOTS other expressions are indexed.
+ *
+ * Returns NULL if out of memory.
+ */
+static poly_index_type *
+poly_index(p1, n1)
+token_type	*p1;	/* expression pointer */
+int		n1;	/* expression length */
+{
+	int		i, level;
+	double		d;
+	unsigned long long h;
+	poly_index_type	*ip, *oldest;
+	poly_var_type	*vp;
+	void		*mp;
+
+	poly_index_lookups++;
+	h = poly_hash(p1, n1);
+	oldest = &poly_index_slots[0];
+	for (i = 0; i < POLY_INDEX_SLOTS; i++) {
+		ip = &poly_index_slots[i];
+		if (ip->p1 == p1) {
+			if (ip->n1 == n1 && ip->hash == h && memcmp(ip->copy, p1, n1 * sizeof(token_type)) == 0) {
+				poly_index_hits++;
+				ip->age = ++poly_index_age;
+				return ip;
+			}
+			oldest = ip;
+			break;
+		}
+		if (ip->age < oldest->age)
+			oldest = ip;
+	}
+	ip = oldest;
+	ip->p1 = NULL;
+	ip->generation++;
+	if (n1 > ip->copy_size) {
+		if ((mp = realloc(ip->copy, n1 * sizeof(token_type))) == NULL)
+			return NULL;
+		ip->copy = (token_type *) mp;
+		ip->copy_size = n1;
+	}
+	if ((n1 / 2 + 2) > ip->term_size) {
+		if ((mp = realloc(ip->term_loc, (n1 / 2 + 2) * sizeof(int))) == NULL)
+			return NULL;
+		ip->term_loc = (int *) mp;
+		ip->term_size = n1 / 2 + 2;
+	}
+	ip->n_terms = 0;
+	ip->term_loc[0] = 0;
+	ip->nv = 0;
+	for (i = 0; i < n1; i++) {
+		switch (p1[i].kind) {
+		case OPERATOR:
+			if (p1[i].level == 1 && (p1[i].token.operatr == PLUS || p1[i].token.operatr == MINUS)) {
+				ip->term_loc[++(ip->n_terms)] = i + 1;
+			}
+			break;
+		case VARIABLE:
+			if ((vp = index_var(ip, p1[i].token.variable, true)) == NULL)
+				return NULL;
+			vp->count++;
+			level = p1[i].level;
+			d = 1.0;
+			if ((i + 2) < n1 && p1[i+1].level == level && p1[i+1].token.operatr == POWER) {
+				if (p1[i+2].level == level && p1[i+2].kind == CONSTANT) {
+					d = p1[i+2].token.constant;
+					if (d < 0.0 || fmod(d, 1.0) != 0.0)
+						vp->integral = false;
+				} else {
+					vp->symbolic = true;
+				}
+			}
+			if (vp->count == 1 || d > vp->degree) {
+				vp->degree = d;
+				vp->lead_term = ip->n_terms;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	ip->term_loc[++(ip->n_terms)] = n1 + 1;
+	blt(ip->copy, p1, n1 * sizeof(token_type));
+	ip->hash = h;
+	ip->p1 = p1;
+	ip->n1 = n1;
+	ip->age = ++poly_index_age;
+	return ip;
+}
+
+/*
+ * Return the indexed additive term number "count" (origin 1) in *tp1 and *lentp1,
+ * like get_term().
+ */
+static int
+index_term(ip, count, tp1, lentp1)
+poly_index_type	*ip;
+int		count;
+int		*tp1, *lentp1;
+{
+	if (count < 1 || count > ip->n_terms)
+		return false;
+	*tp1 = ip->term_loc[count-1];
+	*lentp1 = ip->term_loc[count] - 1 - *tp1;
+	return true;
+}
+
+/*
+ * Return the result of poly_in_v() for the indexed expression, remembering it.
+ */
+static int
+index_poly_in_v(ip, v, allow_divides)
+poly_index_type	*ip;
+long		v;
+int		allow_divides;
+{
+	int		i, t, len;
+	poly_var_type	*vp;
+
+	if ((vp = index_var(ip, v, false)) == NULL)
+		return true;	/* an expression without v is a degree 0 polynomial in v */
+	allow_divides = (allow_divides != false);
+	if (vp->in_poly[allow_divides] < 0) {
+		vp->in_poly[allow_divides] = true;
+		for (i = 1; index_term(ip, i, &t, &len); i++) {
+			if (!poly_in_v_sub(&ip->p1[t], len, v, allow_divides)) {
+				vp->in_poly[allow_divides] = false;
+				break;
+			}
+		}
+	}
+	return vp->in_poly[allow_divides];
+}
+
+/*
+ * Call find_greatest_power() for the expression p1, remembering the result in its index ip.
+ * If ip is NULL, just call find_greatest_power().
+ */
+static int
+index_greatest_power(ip, p1, n1, vp1, pp1, tp1, lentp1, dcodep)
+poly_index_type	*ip;		/* the polynomial index of p1, or NULL */
+token_type	*p1;
+int		n1;
+long		*vp1;
+double		*pp1;
+int		*tp1, *lentp1;
+int		*dcodep;
+{
+	poly_var_type	*vp;
+	power_memo_type	*mp;
+
+	if (ip == NULL || *vp1 == 0 || *dcodep < 0 || *dcodep >= ARR_CNT(vp->power)) {
+		return find_greatest_power(p1, n1, vp1, pp1, tp1, lentp1, dcodep);
+	}
+	if ((vp = index_var(ip, *vp1, false)) == NULL) {
+		/* the same result find_greatest_power() gives when *vp1 isn't found */
+		*pp1 = 0.0;
+		*tp1 = -1;
+		*lentp1 = 0;
+		return 0;
+	}
+	mp = &vp->power[*dcodep];
+	if (!mp->valid) {
+		mp->dcode = *dcodep;
+		mp->count = find_greatest_power(p1, n1, vp1, &mp->power, &mp->tp, &mp->len, &mp->dcode);
+		mp->valid = true;
+	}
+	*pp1 = mp->power;
+	*tp1 = mp->tp;
+	*lentp1 = mp->len;
+	*dcodep = mp->dcode;
+	return mp->count;
+}
+
+/*
+ * Return the constant power variable v is raised to in the polynomial term p1,
+ * 1 if it isn't raised to a power, or 0 if the term doesn't contain v.
+ */
+static double
+term_degree(p1, n1, v)
+token_type	*p1;
+int		n1;
+long		v;
+{
+	int	i;
+
+	for (i = 0; i < n1; i += 2) {
+		if (p1[i].kind == VARIABLE && p1[i].token.variable == v) {
+			if ((i + 2) < n1 && p1[i+1].level == p1[i].level && p1[i+1].token.operatr == POWER
+			    && p1[i+2].level == p1[i].level && p1[i+2].kind == CONSTANT) {
+				return p1[i+2].token.constant;
+			}
+			return 1.0;
+		}
+	}
+	return 0.0;
+}
+
+/*
+ * Store the leading coefficient of the indexed polynomial in variable vp->v into dest.
+ * This is the sum of the terms with the highest power of the variable,
+ * with the variable replaced by 1.
+ */
+static void
+lead_coefficient(ip, vp, dest, np)
+poly_index_type	*ip;
+poly_var_type	*vp;
+token_type	*dest;	/* where to store the simplified coefficient, must be an equation side */
+int		*np;	/* pointer to returned length of dest */
+{
+	int		i, j;
+	int		t, len;
+	token_type	*p1;
+
+	*np = 1;
+	dest[0] = zero_token;
+	for (i = vp->lead_term + 1; index_term(ip, i, &t, &len); i++) {
+		p1 = &ip->p1[t];
+		if (term_degree(p1, len, vp->v) != vp->degree)
+			continue;
+		if ((*np + len + 1) > n_tokens) {
+			error_huge();
+		}
+		dest[*np].kind = OPERATOR;
+		dest[*np].level = 1;
+		if (t > 0)
+			dest[*np].token.operatr = ip->p1[t-1].token.operatr;
+		else
+			dest[*np].token.operatr = PLUS;
+		(*np)++;
+		for (j = 0; j < len; j++, (*np)++) {
+			dest[*np] = p1[j];
+			dest[*np].level++;
+			if (p1[j].kind == VARIABLE && p1[j].token.variable == vp->v) {
+				dest[*np].kind = CONSTANT;
+				dest[*np].token.constant = 1.0;
+			}
+		}
+	}
+	simpa_side(dest, np, false, false);
+}
+
+/*
+ * The polynomial command.
+ * Tell what type and degree of polynomial the fully expanded current expression is,
+ * in the specified variable, or in each of its normal variables.
+ */
+int
+polynomial_cmd(cp)
+char	*cp;
+{
+	int		i, j;
+	int		t, len;
+	int		old_partial;
+	int		var_count = 0, poly_count = 0;
+	long		v = 0;			/* Mathomatic variable */
+	double		d, total_degree;
+	poly_index_type	*ip;
+	poly_var_type	*vp;
+
+	if (current_not_defined()) {
+		return false;
+	}
+	if (*cp) {
+		cp = parse_var2(&v, cp);
+		if (cp == NULL) {
+			return false;
+		}
+		if (extra_characters(cp))
+			return false;
+	}
+	if (n_rhs[cur_equation]) {
+		blt(tes, rhs[cur_equation], n_rhs[cur_equation] * sizeof(token_type));
+		n_tes = n_rhs[cur_equation];
+	} else {
+		blt(tes, lhs[cur_equation], n_lhs[cur_equation] * sizeof(token_type));
+		n_tes = n_lhs[cur_equation];
+	}
+	old_partial = partial_flag;
+	partial_flag = false;
+	uf_simp(tes, &n_tes);
+	partial_flag = old_partial;
+	if ((ip = poly_index(tes, n_tes)) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		return false;
+	}
+	fprintf(gfp, _("The expanded expression has %d additive term%s.\n"), ip->n_terms, (ip->n_terms == 1) ? "" : "s");
+	j = next_espace();	/* temporary storage for the leading coefficients */
+	if (v && index_var(ip, v, false) == NULL) {
+		list_var(v, 0);
+		fprintf(gfp, _("Degree 0 polynomial in (%s), with leading coefficient: "), var_str);
+		list_proc(tes, n_tes, false);
+		fprintf(gfp, "\n");
+		return true;
+	}
+	for (i = 0; i < ip->nv; i++) {
+		if ((ip = poly_index(tes, n_tes)) == NULL) {	/* simplifying the last coefficient may have reused the index */
+			error(_("Out of memory (can't malloc(3))."));
+			return false;
+		}
+		vp = &ip->va[i];
+		if (v ? (vp->v != v) : ((vp->v & VAR_MASK) <= SIGN))
+			continue;
+		var_count++;
+		list_var(vp->v, 0);
+		if (!index_poly_in_v(ip, vp->v, false) || vp->symbolic || !vp->integral) {
+			fprintf(gfp, _("Not a polynomial in (%s).\n"), var_str);
+			continue;
+		}
+		poly_count++;
+		fprintf(gfp, _("Degree %.*g polynomial in (%s), with leading coefficient: "), precision, vp->degree, var_str);
+		lead_coefficient(ip, vp, rhs[j], &n_rhs[j]);
+		list_proc(rhs[j], n_rhs[j], false);
+		fprintf(gfp, "\n");
+	}
+	n_lhs[j] = n_rhs[j] = 0;
+	if (v)
+		return true;
+	if ((ip = poly_index(tes, n_tes)) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		return false;
+	}
+	if (var_count == 0) {
+		fprintf(gfp, _("The expression is a constant, a degree 0 polynomial.\n"));
+	} else if (poly_count < var_count) {
+		fprintf(gfp, _("The expression is not a polynomial in all of its variables.\n"));
+	} else if (var_count == 1) {
+		fprintf(gfp, _("Univariate polynomial.\n"));
+	} else {
+		total_degree = 0.0;
+		for (j = 1; index_term(ip, j, &t, &len); j++) {
+			for (d = 0.0, i = 0; i < ip->nv; i++) {
+				if ((ip->va[i].v & VAR_MASK) > SIGN)
+					d += term_degree(&ip->p1[t], len, ip->va[i].v);
+			}
+			if (d > total_degree)
+				total_degree = d;
+		}
+		fprintf(gfp, _("Multivariate polynomial in %d variables, with total degree %.*g.\n"), var_count, precision, total_degree);
+	}
+	return true;
+}
+
 /*
  * Factor polynomials by calling pf_sub() for every additive sub-expression.
  * Factors repeated factor polynomials (like (x+1)^5) if "do_repeat".
@@ -256,6 +742,7 @@ int		do_repeat;	/* factor repeated factors flag */
 	sort_type	va[MAX_VARS];
 	double		d;
 	int		old_partial;
+	poly_index_type	*ip;
 
 	debug_string(3, "Entering pf_sub().");
 	old_partial = partial_flag;
@@ -285,26 +772,33 @@ int		do_repeat;	/* factor repeated factors flag */
 			goto skip_factor;
 		}
 /* create a variable list with counts of the number of times each variable occurs: */
-		last_v = 0;
-		for (vc = 0; vc < ARR_CNT(va);) {
-			cnt = 0;
-			v1 = -1;
-			for (i = 0; i < n_trhs; i += 2) {
-				if (trhs[i].kind == VARIABLE && trhs[i].token.variable > last_v) {
-					if (v1 == -1 || trhs[i].token.variable < v1) {
-						v1 = trhs[i].token.variable;
-						cnt = 1;
-					} else if (trhs[i].token.variable == v1) {
-						cnt++;
+		if ((ip = poly_index(trhs, n_trhs)) != NULL) {
+			for (vc = 0; vc < ip->nv && vc < ARR_CNT(va); vc++) {
+				va[vc].v = ip->va[vc].v;
+				va[vc].count = ip->va[vc].count;
+			}
+		} else {
+			last_v = 0;
+			for (vc = 0; vc < ARR_CNT(va);) {
+				cnt = 0;
+				v1 = -1;
+				for (i = 0; i < n_trhs; i += 2) {
+					if (trhs[i].kind == VARIABLE && trhs[i].token.variable > last_v) {
+						if (v1 == -1 || trhs[i].token.variable < v1) {
+							v1 = trhs[i].token.variable;
+							cnt = 1;
+						} else if (trhs[i].token.variable == v1) {
+							cnt++;
+						}
 					}
 				}
+				if (v1 == -1)
+					break;
+				last_v = v1;
+				va[vc].v = v1;
+				va[vc].count = cnt;
+				vc++;
 			}
-			if (v1 == -1)
-				break;
-			last_v = v1;
-			va[vc].v = v1;
-			va[vc].count = cnt;
-			vc++;
 		}
 		side_debug(3, &equation[loc1], len);
 		side_debug(3, trhs, n_trhs);
@@ -424,7 +918,8 @@ next_v:
 			}
 			last_v = v;
 			/* make sure there is more than one "v" raised to the highest power: */
-			if (find_greatest_power(trhs, n_trhs, &v, &d, &j, &k, &div_flag) <= 1) {
+			ip = poly_index(trhs, n_trhs);
+			if (index_greatest_power(ip, trhs, n_trhs, &v, &d, &j, &k, &div_flag) <= 1) {
 				continue;
 			}
 			blt(tlhs, trhs, n_trhs * sizeof(token_type));
@@ -1425,6 +1920,8 @@ long		*vp;
 	int		last_count, count;	/* dividend number of terms raised to the highest power */
 	int		divisor_count;		/* divisor number of terms raised to the highest power */
 	long		tmp_v = 0;
+	poly_index_type	*ip1, *ip2;
+	long		gen1;
 
 	if (vp == NULL)
 		vp = &tmp_v;
@@ -1456,14 +1953,22 @@ long		*vp;
 		side_debug(3, tlhs, n_tlhs);
 	}
 #endif
-	/* Determine divide_flag and if the polynomials can be divided. */
+	/* Determine divide_flag and if the polynomials can be divided, */
+	/* reusing what find_highest_count() found out. */
+	if ((ip1 = poly_index(trhs, n_trhs)) != NULL) {
+		gen1 = ip1->generation;
+		if ((ip2 = poly_index(tlhs, n_tlhs)) == NULL || ip1->generation != gen1)
+			ip1 = ip2 = NULL;
+	} else {
+		ip2 = NULL;
+	}
 	divide_flag = 2;
-	last_count = find_greatest_power(trhs, n_trhs, vp, &last_power, &t1, &len_t1, &divide_flag);
-	divisor_count = find_greatest_power(tlhs, n_tlhs, vp, &divisor_power, &t2, &len_t2, &divide_flag);
+	last_count = index_greatest_power(ip1, trhs, n_trhs, vp, &last_power, &t1, &len_t1, &divide_flag);
+	divisor_count = index_greatest_power(ip2, tlhs, n_tlhs, vp, &divisor_power, &t2, &len_t2, &divide_flag);
 	if (divisor_power <= 0 || last_power < divisor_power) {
 		divide_flag = !divide_flag;
-		last_count = find_greatest_power(trhs, n_trhs, vp, &last_power, &t1, &len_t1, &divide_flag);
-		divisor_count = find_greatest_power(tlhs, n_tlhs, vp, &divisor_power, &t2, &len_t2, &divide_flag);
+		last_count = index_greatest_power(ip1, trhs, n_trhs, vp, &last_power, &t1, &len_t1, &divide_flag);
+		divisor_count = index_greatest_power(ip2, tlhs, n_tlhs, vp, &divisor_power, &t2, &len_t2, &divide_flag);
 		if (divisor_power <= 0 || last_power < divisor_power) {
 			return false;
 		}
@@ -1627,6 +2132,8 @@ int		len2;		/* length of divisor */
 	int		count;
 	int		dcount = 0;		/* divisor term count */
 	int		flag;
+	poly_index_type	*ip;
+	long		gen = 0;
 
 	blt(trhs, d1, len1 * sizeof(token_type));
 	n_trhs = len1;
@@ -1672,9 +2179,15 @@ try_one:
 	trhs_size = n_trhs;
 	for (skip_count = 0, count = 0;;) {
 		sum_size = n_trhs + n_quotient;
+		if ((ip = poly_index(trhs, n_trhs)) != NULL)
+			gen = ip->generation;
 		for (term_count = 1, q_size = 0;; term_count++) {
-			if (!get_term(trhs, n_trhs, term_count, &t1, &len_t1))
+			if (ip != NULL && ip->generation == gen) {
+				if (!index_term(ip, term_count, &t1, &len_t1))
+					break;
+			} else if (!get_term(trhs, n_trhs, term_count, &t1, &len_t1)) {
 				break;
+			}
 			flag = false;
 			for (i = 0; i < skip_count; i++) {
 				if (skip_terms[i] == t1) {
@@ -1925,7 +2438,20 @@ long		*vp1;		/* variable pointer to return base variable with */
 	int		t2, len_t2;
 	double		d1, d2;
 	int		count1, count2;
+	poly_index_type	*ip1, *ip2;
+	long		gen1;
 
+	if ((ip1 = poly_index(p1, n1)) != NULL) {
+		gen1 = ip1->generation;
+		if ((ip2 = poly_index(p2, n2)) != NULL && ip1->generation == gen1) {
+			for (vc = 0; vc < ip1->nv && vc < ARR_CNT(va); vc++) {
+				va[vc].v = ip1->va[vc].v;
+				va[vc].count = ip1->va[vc].count;
+			}
+			goto sort_vars;
+		}
+	}
+	ip1 = ip2 = NULL;
 	last_v = 0;
 	for (vc = 0; vc < ARR_CNT(va);) {
 		cnt = 0;
@@ -1947,6 +2473,7 @@ long		*vp1;		/* variable pointer to return base variable with */
 		va[vc].count = cnt;
 		vc++;
 	}
+sort_vars:
 	if (vc <= 0)
 		return 0;
 	qsort((char *) va, vc, sizeof(*va), vcmp);
@@ -1957,12 +2484,12 @@ long		*vp1;		/* variable pointer to return base variable with */
 			}
 			*vp1 = va[i].v;
 			divide_flag = 2;
-			count1 = find_greatest_power(p1, n1, vp1, &d1, &t1, &len_t1, &divide_flag);
-			count2 = find_greatest_power(p2, n2, vp1, &d2, &t2, &len_t2, &divide_flag);
+			count1 = index_greatest_power(ip1, p1, n1, vp1, &d1, &t1, &len_t1, &divide_flag);
+			count2 = index_greatest_power(ip2, p2, n2, vp1, &d2, &t2, &len_t2, &divide_flag);
 			if (d2 <= 0 || d1 < d2 || count2 > count1) {
 				divide_flag = !divide_flag;
-				count1 = find_greatest_power(p1, n1, vp1, &d1, &t1, &len_t1, &divide_flag);
-				count2 = find_greatest_power(p2, n2, vp1, &d2, &t2, &len_t2, &divide_flag);
+				count1 = index_greatest_power(ip1, p1, n1, vp1, &d1, &t1, &len_t1, &divide_flag);
+				count2 = index_greatest_power(ip2, p2, n2, vp1, &d2, &t2, &len_t2, &divide_flag);
 				if (d2 <= 0 || d1 < d2 || count2 > count1) {
 					continue;
 				}
@@ -2225,3 +2752,347 @@ int		*dcodep;	/* divide flag pointer indicates if term is a denominator; */
 		*dcodep = rv;
 	return count;
 }
+
+/*
+ * Dense polynomial coefficient array multiplication routines follow.
+ * Coefficient arrays hold the coefficient of x^i in element i.
+ * These are used to quickly expand products of large univariate polynomials
+ * and by the arbitrary precision integer routines.
+ */
+
+#define	KARATSUBA_CUTOFF	32	/* below this many coefficients, long multiplication is faster than Karatsuba */
+#define	NTT_CUTOFF		131072	/* at or above this many coefficients, the NTT is faster than Karatsuba */
+#define	NTT_PRIME1	7340033.0	/* 7 * 2^20 + 1, with primitive root 3 */
+#define	NTT_PRIME2	23068673.0	/* 11 * 2^21 + 1, with primitive root 3 */
+#define	NTT_MAX_LEN	1048576L	/* 2^20, the longest transform supported by both primes */
+
+/*
+ * Long multiplication: r[0] through r[na+nb-2] = a[] * b[].
+ * r[] must not overlap a[] or b[].
+ */
+void
+coef_mul_school(r, a, na, b, nb)
+double	*r, *a;
+int	na;
+double	*b;
+int	nb;
+{
+	int	i, j;
+
+	for (i = 0; i < na + nb - 1; i++)
+		r[i] = 0.0;
+	for (i = 0; i < na; i++) {
+		if (a[i] == 0.0)
+			continue;
+		for (j = 0; j < nb; j++) {
+			r[i+j] += a[i] * b[j];
+		}
+	}
+}
+
+/*
+ * Karatsuba multiplication of two n coefficient arrays into r[0] through r[2*n-1].
+ * "work" must have room for 16 * n + 64 doubles.
+ */
+static void
+karatsuba_sub(r, a, b, n, work)
+double	*r, *a, *b;
+int	n;
+double	*work;
+{
+	int	i, h, l;
+	double	*a_hi, *b_hi, *a_sum, *b_sum, *z1, *z2;
+
+	if (n <= KARATSUBA_CUTOFF) {
+		coef_mul_school(r, a, n, b, n);
+		r[2*n-1] = 0.0;
+		return;
+	}
+/* split a = a_lo + a_hi * x^h, and the same for b: */
+	h = (n + 1) / 2;
+	l = n - h;
+	a_hi = work;
+	b_hi = a_hi + h;
+	a_sum = b_hi + h;
+	b_sum = a_sum + h;
+	z1 = b_sum + h;
+	z2 = z1 + 2 * h;
+	for (i = 0; i < h; i++) {
+		a_hi[i] = (i < l) ? a[h+i] : 0.0;
+		b_hi[i] = (i < l) ? b[h+i] : 0.0;
+		a_sum[i] = a[i] + a_hi[i];
+		b_sum[i] = b[i] + b_hi[i];
+	}
+/* only 3 half size multiplies are needed: */
+	karatsuba_sub(r, a, b, h, z2 + 2 * h);
+	karatsuba_sub(z2, a_hi, b_hi, h, z2 + 2 * h);
+	karatsuba_sub(z1, a_sum, b_sum, h, z2 + 2 * h);
+	for (i = 0; i < 2 * h; i++) {
+		z1[i] -= r[i] + z2[i];
+	}
+	for (i = 2 * h; i < 2 * n; i++) {
+		r[i] = 0.0;
+	}
+	for (i = 0; i < 2 * h; i++) {
+		if (h + i < 2 * n)
+			r[h+i] += z1[i];
+		if (2 * h + i < 2 * n)
+			r[2*h+i] += z2[i];
+	}
+}
+
+/*
+ * Karatsuba multiplication: r[0] through r[na+nb-2] = a[] * b[].
+ * Unbalanced operands are multiplied in pieces the size of the shorter one.
+ * Only exact for integer coefficients if no intermediate result exceeds 2^53.
+ * r[] must not overlap a[] or b[].
+ *
+ * Return false if out of memory.
+ */
+int
+coef_mul_karatsuba(r, a, na, b, nb)
+double	*r, *a;
+int	na;
+double	*b;
+int	nb;
+{
+	int	i, j, n;
+	double	*work, *piece, *product;
+
+	if (na > nb) {
+		return coef_mul_karatsuba(r, b, nb, a, na);
+	}
+	if (na <= KARATSUBA_CUTOFF) {
+		coef_mul_school(r, a, na, b, nb);
+		return true;
+	}
+	n = na;
+	if ((work = (double *) malloc((16 * n + 64 + 3 * n) * sizeof(double))) == NULL) {
+		return false;
+	}
+	piece = work + 16 * n + 64;
+	product = piece + n;
+	for (i = 0; i < na + nb - 1; i++)
+		r[i] = 0.0;
+	for (j = 0; j < nb; j += n) {
+		for (i = 0; i < n; i++) {
+			piece[i] = (j + i < nb) ? b[j+i] : 0.0;
+		}
+		karatsuba_sub(product, a, piece, n, work);
+		for (i = 0; i < 2 * n - 1 && j + i < na + nb - 1; i++) {
+			r[j+i] += product[i];
+		}
+	}
+	free(work);
+	return true;
+}
+
+/*
+ * Return (a * b) % p, for non-negative integers a and b less than p < 2^26.
+ * The quotient estimate is always within 1 of the true quotient.
+ */
+static double
+mod_mul(a, b, p)
+double	a, b, p;
+{
+	double	t, q;
+
+	t = a * b;
+	q = (double) (long) (t / p);
+	t -= q * p;
+	if (t < 0.0)
+		t += p;
+	else if (t >= p)
+		t -= p;
+	return t;
+}
+
+/*
+ * Return (b ^ e) % p.
+ */
+static double
+mod_pow(b, e, p)
+double	b, e, p;
+{
+	double	r = 1.0;
+
+	while (e > 0.0) {
+		if (fmod(e, 2.0) != 0.0)
+			r = mod_mul(r, b, p);
+		b = mod_mul(b, b, p);
+		e = floor(e / 2.0);
+	}
+	return r;
+}
+
+/*
+ * In-place number-theoretic transform of the "len" integers in x[], modulo the prime p.
+ * "len" must be a power of 2 that divides p - 1.
+ * If "invert" is true, do the inverse transform.
+ * "w" is work space for len / 2 roots of unity.
+ */
+static void
+ntt(x, len, p, invert, w)
+double	*x;
+long	len;
+double	p;
+int	invert;
+double	*w;
+{
+	long	i, j, k, m, h;
+	double	wm, u, t;
+
+	for (i = 1, j = 0; i < len; i++) {	/* bit reversal permutation */
+		for (k = len >> 1; j & k; k >>= 1)
+			j ^= k;
+		j ^= k;
+		if (i < j) {
+			t = x[i];
+			x[i] = x[j];
+			x[j] = t;
+		}
+	}
+	for (m = 2; m <= len; m <<= 1) {
+		h = m / 2;
+		wm = mod_pow(3.0, (p - 1.0) / m, p);
+		if (invert)
+			wm = mod_pow(wm, p - 2.0, p);
+		w[0] = 1.0;
+		for (k = 1; k < h; k++)
+			w[k] = mod_mul(w[k-1], wm, p);
+		for (i = 0; i < len; i += m) {
+			for (k = 0; k < h; k++) {
+				u = x[i+k];
+				t = mod_mul(w[k], x[i+k+h], p);
+				x[i+k] = (u + t >= p) ? (u + t - p) : (u + t);
+				x[i+k+h] = (u - t < 0.0) ? (u - t + p) : (u - t);
+			}
+		}
+	}
+	if (invert) {
+		t = mod_pow((double) len, p - 2.0, p);
+		for (i = 0; i < len; i++)
+			x[i] = mod_mul(x[i], t, p);
+	}
+}
+
+/*
+ * Return the largest absolute value in a[], or -1 if any element is not an integer.
+ */
+static double
+coef_max(a, n)
+double	*a;
+int	n;
+{
+	int	i;
+	double	d, max_d = 0.0;
+
+	for (i = 0; i < n; i++) {
+		d = fabs(a[i]);
+		if (!isfinite(d) || fmod(d, 1.0) != 0.0)
+			return -1.0;
+		if (d > max_d)
+			max_d = d;
+	}
+	return max_d;
+}
+
+/*
+ * Number-theoretic transform multiplication of integer coefficient arrays:
+ * r[0] through r[na+nb-2] = a[] * b[].
+ * Two primes and the Chinese remainder theorem give exact results.
+ * r[] must not overlap a[] or b[].
+ *
+ * Return false if not possible, because the coefficients are not all integers,
+ * the results would be too large, or out of memory.
+ */
+int
+coef_mul_ntt(r, a, na, b, nb)
+double	*r, *a;
+int	na;
+double	*b;
+int	nb;
+{
+	long	i, len;
+	int	k;
+	double	d, max_a, max_b, p, inv, m;
+	double	*x[2], *y, *w;
+
+	max_a = coef_max(a, na);
+	max_b = coef_max(b, nb);
+	if (max_a < 0.0 || max_b < 0.0)
+		return false;
+	m = NTT_PRIME1 * NTT_PRIME2;
+	if (max_a * max_b * min(na, nb) >= m / 2.0)
+		return false;
+	for (len = 1; len < na + nb - 1; len <<= 1)
+		;
+	if (len > NTT_MAX_LEN)
+		return false;
+	if ((x[0] = (double *) malloc((3 * len + len / 2 + 1) * sizeof(double))) == NULL)
+		return false;
+	x[1] = x[0] + len;
+	y = x[1] + len;
+	w = y + len;
+	for (k = 0; k < 2; k++) {
+		p = (k == 0) ? NTT_PRIME1 : NTT_PRIME2;
+		for (i = 0; i < len; i++) {
+			d = (i < na) ? fmod(a[i], p) : 0.0;
+			x[k][i] = (d < 0.0) ? (d + p) : d;
+			d = (i < nb) ? fmod(b[i], p) : 0.0;
+			y[i] = (d < 0.0) ? (d + p) : d;
+		}
+		ntt(x[k], len, p, false, w);
+		ntt(y, len, p, false, w);
+		for (i = 0; i < len; i++)
+			x[k][i] = mod_mul(x[k][i], y[i], p);
+		ntt(x[k], len, p, true, w);
+	}
+/* combine the two residues (Garner's algorithm) and restore the sign: */
+	inv = mod_pow(NTT_PRIME1, NTT_PRIME2 - 2.0, NTT_PRIME2);
+	for (i = 0; i < na + nb - 1; i++) {
+		d = x[1][i] - x[0][i];
+		if (d < 0.0)
+			d += NTT_PRIME2;
+		d = x[0][i] + NTT_PRIME1 * mod_mul(d, inv, NTT_PRIME2);
+		if (d > m / 2.0)
+			d -= m;
+		r[i] = d;
+	}
+	free(x[0]);
+	return true;
+}
+
+/*
+ * Multiply two coefficient arrays: r[0] through r[na+nb-2] = a[] * b[],
+ * choosing the fastest exact method.
+ * Karatsuba and NTT multiplication are only used for integer coefficients,
+ * because they can lose floating point accuracy otherwise.
+ * r[] must not overlap a[] or b[].
+ */
+void
+coef_multiply(r, a, na, b, nb)
+double	*r, *a;
+int	na;
+double	*b;
+int	nb;
+{
+	int	n;
+	double	max_a, max_b, bound;
+
+	n = min(na, nb);
+	if (n > KARATSUBA_CUTOFF) {
+		max_a = coef_max(a, na);
+		max_b = coef_max(b, nb);
+		if (max_a >= 0.0 && max_b >= 0.0) {
+			if (n >= NTT_CUTOFF && coef_mul_ntt(r, a, na, b, nb))
+				return;
+/* Karatsuba sums of coefficients double in size at each level of recursion: */
+			for (bound = max_a * max_b * n; n > KARATSUBA_CUTOFF; n = (n + 1) / 2)
+				bound *= 4.0;
+			if (bound < 9.0e15 && coef_mul_karatsuba(r, a, na, b, nb))
+				return;
+		}
+	}
+	coef_mul_school(r, a, na, b, nb);
+}
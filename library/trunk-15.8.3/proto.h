@@ -9,11 +9,12 @@ void error_huge(void);
 void error_bug(const char *str);
 void check_err(void);
 int get_screen_size(void);
-int malloc_vscreen(void);
 int init_mem(void);
 int check_gvars(void);
 void init_gvars(void);
 void clean_up(void);
+void espace_written(int en);
+void reset_sign_array(void);
 void set_sign_array(void);
 int next_sign(long *vp);
 void clear_all(void);
@@ -24,10 +25,12 @@ int next_espace(void);
 void copy_espace(int src, int dest);
 int solved_equation(int i);
 int found_var(token_type *p1, int n, long v);
+int espace_var_list(int en, sort_type **vpp);
 int var_in_equation(int i, long v);
 int search_all_for_var(long v, int forward_direction);
 void rename_var_in_es(int en, long from_v, long to_v);
 int subst_var_with_exp(token_type *equation, int *np, token_type *expression, int len, long v);
+int subst_vars_with_exps(token_type *equation, int *np, subst_type *subs, int n_subs);
 int min_level(token_type *expression, int n);
 int get_default_en(char *cp);
 int get_expr(token_type *equation, int *np);
@@ -57,6 +60,17 @@ int exp_contains_nan(token_type *p1, int n1);
 int exp_is_numeric(token_type *p1, int n1);
 int exp_is_absolute(token_type *p1, int n1);
 int check_divide_by_zero(double denominator);
+/* bignum.c */
+int factor_big_number(char *cp, int len);
+void clear_exact(void);
+void exact_collect(void);
+double exact_float(double d);
+int exact_save(strbuf_type *keys, strbuf_type *digits);
+int exact_restore_ok(double key, char *digits);
+void exact_restore(double key, char *digits);
+double exact_constant(char *cp, int len, double d);
+int exact_string(double d, char *buf, int size);
+int exact_calc(int op, double k1, double k2, double *dp);
 /* cmds.c */
 int plot_cmd(char *cp);
 int version_cmd(char *cp);
@@ -66,6 +80,7 @@ int solve_cmd(char *cp);
 int sum_cmd(char *cp);
 int product_cmd(char *cp);
 int for_cmd(char *cp);
+int new_temp_var(long *vp);
 int optimize_cmd(char *cp);
 int push_cmd(char *cp);
 int push_en(int en);
@@ -102,10 +117,12 @@ int div_loc_find(token_type *expression, int n);
 int fraction_cmd(char *cp);
 int quit_cmd(char *cp);
 int read_cmd(char *cp);
-int read_file(char *cp);
-int read_sub(FILE *fp);
+int read_file(char *cp, int continue_flag);
+int read_sub(FILE *fp, int continue_flag);
 int edit_cmd(char *cp);
 int save_cmd(char *cp);
+int save_binary(char *filename);
+int read_binary(char *filename);
 /* complex.c */
 void rect_to_polar(double x, double y, double *radiusp, double *thetap);
 int roots_cmd(char *cp);
@@ -122,9 +139,23 @@ complexs complex_div(complexs a, complexs b);
 complexs complex_log(complexs a);
 complexs complex_exp(complexs a);
 complexs complex_pow(complexs a, complexs b);
+/* dag.c */
+void dag_clear(void);
+int dag_count(void);
+void dag_node(int x, token_type *tp, int *leftp, int *rightp);
+int dag_constant(double d);
+int dag_variable(long v);
+int dag_op(int op, int a, int b);
+int dag_build(token_type *p1, int n);
+int dag_depends(int x, long v);
+void dag_flatten(int x, token_type *dest, int *np);
+double dag_eval(int x, long v, double value);
+int dag_diff(int x, long v);
+int dag_temps(int x, token_type *dest, int *np, int simplify_flag);
 /* diff.c */
 int differentiate(token_type *equation, int *np, long v);
 int derivative_cmd(char *cp);
+int jacobian_cmd(char *cp);
 int extrema_cmd(char *cp);
 int taylor_cmd(char *cp);
 int limit_cmd(char *cp);
@@ -146,6 +177,7 @@ int factor_constants(token_type *equation, int *np, int level_code);
 /* gcd.c */
 double gcd(double d1, double d2);
 double gcd_verified(double d1, double d2);
+int int_cache_index(double d1, double d2);
 double my_round(double d1);
 int f_to_fraction(double d, double *numeratorp, double *denominatorp);
 int make_fractions(token_type *equation, int *np);
@@ -168,7 +200,6 @@ void underline_title(int count);
 int help_cmd(char *cp);
 /* integrate.c */
 void make_powers(token_type *equation, int *np, long v);
-int int_dispatch(token_type *equation, int *np, long v, int (*func)(token_type *equation, int *np, int loc, int eloc, long v));
 int integrate_cmd(char *cp);
 int laplace_cmd(char *cp);
 int nintegrate_cmd(char *cp);
@@ -177,6 +208,10 @@ void reset_attr(void);
 int set_color(int color);
 void default_color(void);
 int display_all_colors(void);
+void strbuf_init(strbuf_type *sb);
+int strbuf_appendn(strbuf_type *sb, char *str, int len);
+int strbuf_append(strbuf_type *sb, char *str);
+char *strbuf_finish(strbuf_type *sb);
 int list1_sub(int n, int export_flag);
 int list_sub(int n);
 void list_debug(int level, token_type *p1, int n1, token_type *p2, int n2);
@@ -186,10 +221,13 @@ int list_proc(token_type *p1, int n, int export_flag);
 char *list_equation(int n, int export_flag);
 char *list_expression(token_type *p1, int n, int export_flag);
 int list_string(token_type *p1, int n, char *string, int export_flag);
-int list_string_sub(token_type *p1, int n, int outflag, char *string, int export_flag);
+int list_string_sub(token_type *p1, int n, int outflag, char *string, strbuf_type *sb, int export_flag);
+void json_string(strbuf_type *sb, char *str);
 int int_expr(token_type *p1, int n);
 int list_code_equation(int en, enum language_list language, int int_flag);
 char *string_code_equation(int en, enum language_list language, int int_flag);
+char *string_code_gradient(int en, enum language_list language);
+void gradient_clean_up(void);
 int list_code(token_type *equation, int *np, int outflag, char *string, enum language_list language, int int_flag);
 char *flist_equation_string(int n);
 int flist_equation(int n);
@@ -227,6 +265,7 @@ int my_strlcpy(char *dest, char *src, int n);
 /* poly.c */
 int poly_in_v_sub(token_type *p1, int n, long v, int allow_divides);
 int poly_in_v(token_type *p1, int n, long v, int allow_divides);
+int polynomial_cmd(char *cp);
 int poly_factor(token_type *equation, int *np, int do_repeat);
 int remove_factors(void);
 int poly_gcd(token_type *larger, int llen, token_type *smaller, int slen, long v);
@@ -242,6 +281,10 @@ int basic_size(token_type *p1, int len);
 int get_term(token_type *p1, int n1, int count, int *tp1, int *lentp1);
 void term_value(double *dp, token_type *p1, int n1, int loc);
 int find_greatest_power(token_type *p1, int n1, long *vp1, double *pp1, int *tp1, int *lentp1, int *dcodep);
+void coef_mul_school(double *r, double *a, int na, double *b, int nb);
+int coef_mul_karatsuba(double *r, double *a, int na, double *b, int nb);
+int coef_mul_ntt(double *r, double *a, int na, double *b, int nb);
+void coef_multiply(double *r, double *a, int na, double *b, int nb);
 /* simplify.c */
 void organize(token_type *equation, int *np);
 void elim_loop(token_type *equation, int *np);
@@ -281,7 +324,9 @@ int reorder(token_type *equation, int *np);
 int rationalize(token_type *equation, int *np);
 /* solve.c */
 int solve_espace(int want, int have);
+void clear_solve_memo(void);
 int solve_sub(token_type *wantp, int wantn, token_type *leftp, int *leftnp, token_type *rightp, int *rightnp);
+int solve_linear(char *cp);
 /* super.c */
 void group_proc(token_type *equation, int *np);
 int fractions_and_group(token_type *equation, int *np);
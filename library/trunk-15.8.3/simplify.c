@@ -1233,8 +1233,68 @@ int		iflag;		/* produce imaginary numbers flag */
 	return const_recurse(equation, np, 0, 1, iflag);
 }
 
+/*
+ * Do the exact integer arithmetic for calc(), using exact_calc(),
+ * with the same arguments as calc().
+ *
+ * Return 1 if done, 0 if floating point arithmetic should be used instead,
+ * or -1 if the result is an exact fraction, which should be left alone.
+ */
+static int
+calc_exact(op1p, k1p, op2, k2)
+int	*op1p;
+double	*k1p;
+int	op2;
+double	k2;
+{
+	int	op1, rv;
+	double	d;
+
+	op1 = op1p ? *op1p : 0;
+	switch (op2) {
+	case PLUS:
+	case MINUS:
+		if ((rv = exact_calc(op2, (op1 == MINUS) ? -(*k1p) : *k1p, k2, &d)) <= 0)
+			return rv;
+		if (op1 == 0) {
+			*k1p = d;
+		} else if (d >= 0.0) {
+			*op1p = PLUS;
+			*k1p = d;
+		} else {
+			*op1p = MINUS;
+			*k1p = -d;
+		}
+		return 1;
+	case TIMES:
+	case DIVIDE:
+		if (op1 == 0)
+			op1 = TIMES;
+		if (op1 == op2) {
+			rv = exact_calc(TIMES, *k1p, k2, &d);
+		} else if (op1 == DIVIDE) {
+			rv = exact_calc(DIVIDE, k2, *k1p, &d);
+			if (rv > 0)
+				*op1p = TIMES;
+		} else {
+			rv = exact_calc(DIVIDE, *k1p, k2, &d);
+		}
+		break;
+	case IDIVIDE:
+	case POWER:
+		rv = exact_calc(op2, *k1p, k2, &d);
+		break;
+	default:
+		return 0;
+	}
+	if (rv > 0)
+		*k1p = d;
+	return rv;
+}
+
 /*
  * Do the floating point arithmetic for Mathomatic.
+ * Large integers are calculated exactly by calc_exact() when "set exact_integers" is on.
  *
  * Return true if successful.
  * domain_check must be set to false after this.
@@ -1254,6 +1314,17 @@ double	k2;	/* Operand 2; ignored for unary operators. */
 
 	domain_check = false;
 	errno = 0;
+	if (exact_integers) {
+		switch (calc_exact(op1p, k1p, op2, k2)) {
+		case 1:
+			domain_check = (op2 == POWER);
+			return true;
+		case -1:
+			return false;	/* leave exact fractions alone */
+		}
+		*k1p = exact_float(*k1p);	/* use the correctly rounded values of exact integers */
+		k2 = exact_float(k2);
+	}
 	if (op1p) {
 		op1 = *op1p;
 	} else {
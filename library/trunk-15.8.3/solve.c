@@ -25,9 +25,24 @@ George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
 #include "includes.h"
 
 #define	MAX_RAISE_POWER	20	/* Maximum number of times to increase power in solve function. */
+#define	MAX_ROOT_ITERATIONS	1000	/* Maximum number of Aberth-Ehrlich iterations when finding numeric roots. */
+#define	SOLVE_MEMO_SIZE	64	/* Number of failed solves remembered, so they are not retried. */
+
+/* The solve strategies tried by solve_main(), for the debug trace. */
+#define	S_SIMPLIFY	0
+#define	S_G_OF_F	1
+#define	S_FLIP		2
+#define	S_UNFACTOR	3
+#define	S_INCREASE	4
+#define	S_POLY		5
+#define	S_NUMERIC	6
+#define	N_STRATEGIES	7
 
 static int increase(double d, long v);
 static int poly_solve(long v);
+static int numeric_poly_solve(long v);
+static void store_extra_roots(int en);
+static int solve_main(token_type *wantp, int wantn, token_type *leftp, int *leftnp, token_type *rightp, int *rightnp);
 static int g_of_f(int op, token_type *operandp, token_type *side1p, int *side1np, token_type *side2p, int *side2np);
 static int flip(token_type *side1p, int *side1np, token_type *side2p, int *side2np);
 
@@ -36,6 +51,25 @@ static int	prev_n1, prev_n2;
 
 static int	last_int_var = 0;
 
+static int	want_all_roots;		/* true if extra numeric polynomial roots can be stored in new equation spaces */
+static complexs	*extra_roots;		/* the extra roots, from the last numeric_poly_solve() */
+static int	n_extra_roots;
+
+static char	*strategy_names[N_STRATEGIES] = { "simplify", "g_of_f", "flip", "unfactor", "increase", "poly", "numeric" };
+static long	strategy_calls[N_STRATEGIES];	/* number of times each strategy was tried in the current solve */
+static long	strategy_wins[N_STRATEGIES];	/* number of times each strategy succeeded */
+static clock_t	strategy_time[N_STRATEGIES];	/* CPU time spent in each strategy */
+static int	solve_steps;			/* passes through the solve loop in the current solve */
+
+static struct solve_memo_type {			/* a solve that failed */
+	unsigned long	hash;			/* solve_hash() of what to solve for and the equation */
+	int		wantn, n1, n2;		/* lengths of what to solve for and the equation sides */
+	token_type	*tokens;		/* copy of what to solve for and the equation sides, compared on a hash match */
+} solve_memo[SOLVE_MEMO_SIZE];
+static int	n_solve_memo;			/* number of entries used in solve_memo[] */
+static int	next_solve_memo;		/* next entry to overwrite when solve_memo[] is full */
+static int	solve_limited;			/* true if the current solve skipped something that might succeed another time */
+
 /*
  * Solve using equation spaces.
  *
@@ -51,6 +85,8 @@ int	have;	/* equation number to solve */
 	int	rv = 0;	/* return value */
 
 	blt(save_save, jmp_save, sizeof(jmp_save));
+	want_all_roots = true;
+	n_extra_roots = 0;
 	if ((i = setjmp(jmp_save)) != 0) {	/* trap errors */
 		clean_up();
 		if (i == 14) {
@@ -73,12 +109,265 @@ int	have;	/* equation number to solve */
 		}
 	}
 	blt(jmp_save, save_save, sizeof(jmp_save));
+	want_all_roots = false;
 	if (rv <= 0) {
 		printf(_("Solve failed for equation space #%d.\n"), have + 1);
+	} else {
+		store_extra_roots(have);
 	}
 	return(rv > 0);
 }
 
+/*
+ * Put numeric complex number "c" in "p1" as an expression.
+ *
+ * Return the length of the expression.
+ */
+static int
+complex_tokens(c, p1)
+complexs	c;
+token_type	*p1;
+{
+	int	n = 0;
+
+	if (c.re != 0.0 || c.im == 0.0) {
+		p1[n].level = 1;
+		p1[n].kind = CONSTANT;
+		p1[n].token.constant = c.re;
+		n++;
+		if (c.im == 0.0)
+			return n;
+		p1[n].level = 1;
+		p1[n].kind = OPERATOR;
+		p1[n].token.operatr = (c.im < 0.0) ? MINUS : PLUS;
+		n++;
+		c.im = fabs(c.im);
+	}
+	p1[n].level = 2;
+	p1[n].kind = CONSTANT;
+	p1[n].token.constant = c.im;
+	n++;
+	p1[n].level = 2;
+	p1[n].kind = OPERATOR;
+	p1[n].token.operatr = TIMES;
+	n++;
+	p1[n].level = 2;
+	p1[n].kind = VARIABLE;
+	p1[n].token.variable = IMAGINARY;
+	n++;
+	if (n == 3) {
+		p1[0].level = p1[1].level = p1[2].level = 1;
+	}
+	return n;
+}
+
+/*
+ * Store the extra numeric roots of the polynomial equation just solved in equation space "en"
+ * in new equation spaces, solved the same way, and display them.
+ */
+static void
+store_extra_roots(en)
+int	en;
+{
+	int		k, i;
+	token_type	*p1;
+	int		*np;
+
+	for (k = 0; k < n_extra_roots; k++) {
+		i = next_espace();
+		copy_espace(en, i);
+		if (n_lhs[i] == 1 && lhs[i][0].kind == VARIABLE) {
+			p1 = rhs[i];
+			np = &n_rhs[i];
+		} else {
+			p1 = lhs[i];
+			np = &n_lhs[i];
+		}
+		*np = complex_tokens(extra_roots[k], p1);
+#if	!LIBRARY
+		list_sub(i);
+#endif
+	}
+	n_extra_roots = 0;
+}
+
+/*
+ * Forget all failed solves, because a set option changed that might make them succeed.
+ */
+void
+clear_solve_memo(void)
+{
+	int	i;
+
+	for (i = 0; i < n_solve_memo; i++) {
+		free(solve_memo[i].tokens);
+		solve_memo[i].tokens = NULL;
+	}
+	n_solve_memo = 0;
+	next_solve_memo = 0;
+}
+
+/*
+ * Return true if solve_memo[] entry "mp" is for solving equation "leftp = rightp" for "wantp".
+ */
+static int
+solve_memo_match(mp, wantp, wantn, leftp, leftn, rightp, rightn)
+struct solve_memo_type	*mp;
+token_type		*wantp, *leftp, *rightp;
+int			wantn, leftn, rightn;
+{
+	if (mp->wantn != wantn || mp->n1 != leftn || mp->n2 != rightn)
+		return false;
+	return(memcmp(mp->tokens, wantp, wantn * sizeof(token_type)) == 0
+	    && memcmp(&mp->tokens[wantn], leftp, leftn * sizeof(token_type)) == 0
+	    && memcmp(&mp->tokens[wantn+leftn], rightp, rightn * sizeof(token_type)) == 0);
+}
+
+/*
+ * Remember that solving equation "leftp = rightp" for "wantp" failed.
+ */
+static void
+solve_memo_add(h, wantp, wantn, leftp, leftn, rightp, rightn)
+unsigned long	h;
+token_type	*wantp, *leftp, *rightp;
+int		wantn, leftn, rightn;
+{
+	struct solve_memo_type	*mp;
+	token_type		*tp;
+
+	if ((tp = (token_type *) malloc((wantn + leftn + rightn) * sizeof(token_type))) == NULL)
+		return;
+	blt(tp, wantp, wantn * sizeof(token_type));
+	blt(&tp[wantn], leftp, leftn * sizeof(token_type));
+	blt(&tp[wantn+leftn], rightp, rightn * sizeof(token_type));
+	mp = &solve_memo[next_solve_memo];
+	if (next_solve_memo < n_solve_memo)
+		free(mp->tokens);
+	mp->hash = h;
+	mp->wantn = wantn;
+	mp->n1 = leftn;
+	mp->n2 = rightn;
+	mp->tokens = tp;
+	next_solve_memo = (next_solve_memo + 1) % SOLVE_MEMO_SIZE;
+	if (n_solve_memo < SOLVE_MEMO_SIZE)
+		n_solve_memo++;
+}
+
+/*
+ * Return a hash value for solving equation "leftp = rightp" for "wantp".
+ */
+static unsigned long
+solve_hash(wantp, wantn, leftp, leftn, rightp, rightn)
+token_type	*wantp, *leftp, *rightp;
+int		wantn, leftn, rightn;
+{
+	token_type	*p1, *ep;
+	unsigned long	h;
+	unsigned char	*cp;
+	int		i, side;
+
+	h = wantn;
+	for (side = 0; side < 3; side++) {
+		switch (side) {
+		case 0:
+			p1 = wantp;
+			ep = &wantp[wantn];
+			break;
+		case 1:
+			p1 = leftp;
+			ep = &leftp[leftn];
+			break;
+		default:
+			p1 = rightp;
+			ep = &rightp[rightn];
+			break;
+		}
+		h = h * 1000003UL + (ep - p1);
+		for (; p1 < ep; p1++) {
+			h = h * 31UL + p1->kind * 7 + p1->level;
+			switch (p1->kind) {
+			case CONSTANT:
+				cp = (unsigned char *) &p1->token.constant;
+				for (i = 0; i < sizeof(p1->token.constant); i++)
+					h = h * 131UL + cp[i];
+				break;
+			case VARIABLE:
+				h = h * 131UL + (unsigned long) p1->token.variable;
+				break;
+			case OPERATOR:
+				h = h * 131UL + (unsigned long) p1->token.operatr;
+				break;
+			}
+		}
+	}
+	return h ^ (h >> 17);
+}
+
+/*
+ * Count one pass through the solve loop.
+ *
+ * Return false if the solve step budget ("set solve_steps") is used up.
+ */
+static int
+solve_step(void)
+{
+	solve_steps++;
+	if (max_solve_steps > 0 && solve_steps > max_solve_steps) {
+		error(_("Solve step budget exceeded, giving up."));
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Record the result "rv" of trying strategy "s", which was started at CPU time "start".
+ *
+ * Return "rv".
+ */
+static int
+tally(s, start, rv)
+int	s;
+clock_t	start;
+int	rv;
+{
+	strategy_calls[s]++;
+	if (rv)
+		strategy_wins[s]++;
+	strategy_time[s] += clock() - start;
+	return rv;
+}
+
+/*
+ * Display the one line solve trace at debug level 1 or higher,
+ * as space separated "name=value" fields,
+ * with each strategy as "name=tries/successes/milliseconds".
+ */
+static void
+solve_trace(v, result, start)
+long	v;		/* variable solved for, or 0 */
+char	*result;	/* outcome of the solve */
+clock_t	start;		/* CPU time when the solve started */
+{
+#if	!SILENT
+	int	s;
+
+	if (debug_level < 1)
+		return;
+	if (v) {
+		list_var(v, 0);
+	} else {
+		my_strlcpy(var_str, "0", sizeof(var_str));
+	}
+	fprintf(gfp, "solve-trace: var=%s result=%s steps=%d ms=%.3f", var_str, result, solve_steps,
+	    (double) (clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+	for (s = 0; s < N_STRATEGIES; s++) {
+		fprintf(gfp, " %s=%ld/%ld/%.3f", strategy_names[s], strategy_calls[s], strategy_wins[s],
+		    (double) strategy_time[s] * 1000.0 / CLOCKS_PER_SEC);
+	}
+	fprintf(gfp, "\n");
+#endif
+}
+
 /*
  * Main Mathomatic symbolic solve routine.
  *
@@ -94,6 +383,11 @@ int	have;	/* equation number to solve */
  * Returns 0 on failure.  Might succeed at a numeric solve.
  * Returns -1 if solving for a variable and the equation is an identity.
  * Returns -2 if unsolvable in all realms.
+ *
+ * Equations that failed to solve are remembered for the session and not retried,
+ * unless the failure might depend on the context, like the free equation spaces,
+ * and each solve is limited to "set solve_steps" passes through the solve loop.
+ * "set debug 1" displays a one line trace of each solve.
  */
 int
 solve_sub(wantp, wantn, leftp, leftnp, rightp, rightnp)
@@ -103,6 +397,70 @@ token_type	*leftp;		/* LHS of equation */
 int		*leftnp;	/* pointer to length of LHS */
 token_type	*rightp;	/* RHS of equation */
 int		*rightnp;	/* pointer to length of RHS */
+{
+	int		i, s;
+	int		rv;
+	int		n1, n2;
+	int		old_limited;
+	char		*result;
+	long		v = 0;
+	unsigned long	h;
+	clock_t		start;
+
+	if (wantn == 1 && wantp->kind == VARIABLE) {
+		v = wantp->token.variable;
+	}
+	for (s = 0; s < N_STRATEGIES; s++) {
+		strategy_calls[s] = 0;
+		strategy_wins[s] = 0;
+		strategy_time[s] = 0;
+	}
+	solve_steps = 0;
+	start = clock();
+	n1 = *leftnp;
+	n2 = *rightnp;
+	h = solve_hash(wantp, wantn, leftp, n1, rightp, n2);
+	for (i = 0; i < n_solve_memo; i++) {
+		if (solve_memo[i].hash == h && solve_memo_match(&solve_memo[i], wantp, wantn, leftp, n1, rightp, n2)) {
+			error(_("This equation failed to solve before, not retrying."));
+			solve_trace(v, "memo", start);
+			return false;
+		}
+	}
+	old_limited = solve_limited;
+	solve_limited = false;
+	rv = solve_main(wantp, wantn, leftp, leftnp, rightp, rightnp);
+	if (rv == 0 && solve_steps > 0 && !solve_limited) {
+		/* remember this failure, unless nothing was tried or it might succeed another time */
+		solve_memo_add(h, wantp, wantn, leftp, n1, rightp, n2);
+	}
+	solve_limited = (solve_limited || old_limited);
+	if (rv > 0) {
+		result = "ok";
+	} else if (rv == -1) {
+		result = "identity";
+	} else if (rv == -2) {
+		result = "unsolvable";
+	} else if (max_solve_steps > 0 && solve_steps > max_solve_steps) {
+		result = "budget";
+	} else {
+		result = "fail";
+	}
+	solve_trace(v, result, start);
+	return rv;
+}
+
+/*
+ * The body of solve_sub(), which calls itself to solve for zero.
+ */
+static int
+solve_main(wantp, wantn, leftp, leftnp, rightp, rightnp)
+token_type	*wantp;		/* expression to solve for */
+int		wantn;		/* length of expression to solve for */
+token_type	*leftp;		/* LHS of equation */
+int		*leftnp;	/* pointer to length of LHS */
+token_type	*rightp;	/* RHS of equation */
+int		*rightnp;	/* pointer to length of RHS */
 {
 	int		i, j;
 	int		found, found_count;
@@ -120,6 +478,7 @@ int		*rightnp;	/* pointer to length of RHS */
 	int		zero_solved = false;
 	double		numerator, denominator;
 	int		success = 1;
+	clock_t		start;
 
 	repeat_count = 0;
 	prev_n1 = 0;
@@ -143,14 +502,15 @@ int		*rightnp;	/* pointer to length of RHS */
 			if (wantp[0].kind == VARIABLE) {
 				v = wantp[0].token.variable;
 			}
-			if (solve_sub(&zero_token, 1, rightp, rightnp, leftp, leftnp) <= 0)
+			if (solve_main(&zero_token, 1, rightp, rightnp, leftp, leftnp) <= 0)
 				return false;
 			n_tlhs = *leftnp;
 			blt(tlhs, leftp, n_tlhs * sizeof(*leftp));
 			n_trhs = *rightnp;
 			blt(trhs, rightp, n_trhs * sizeof(*rightp));
 			uf_simp(tlhs, &n_tlhs);
-			if (increase(1 / wantp[2].token.constant, v) != true) {
+			start = clock();
+			if (tally(S_INCREASE, start, increase(1 / wantp[2].token.constant, v)) != true) {
 				error(_("Unable to isolate root."));
 				return false;
 			}
@@ -195,8 +555,11 @@ int		*rightnp;	/* pointer to length of RHS */
 	uf_power(tlhs, &n_tlhs);
 	uf_power(trhs, &n_trhs);
 simp_again:
+	if (!solve_step())
+		return false;
 	/* Make sure equation is a bit simplified. */
 	list_tdebug(2);
+	start = clock();
 	simps_side(tlhs, &n_tlhs, zsolve);
 	if (uf_flag) {
 		simp_loop(trhs, &n_trhs);
@@ -205,6 +568,7 @@ simp_again:
 	} else {
 		simps_side(trhs, &n_trhs, zsolve);
 	}
+	tally(S_SIMPLIFY, start, true);
 	list_tdebug(1);
 no_simp:
 	/* First selectively move sub-expressions from the RHS to the LHS. */
@@ -216,7 +580,8 @@ no_simp:
 				op = p1->token.operatr;
 				b1 = p1 + 1;
 				if (op == DIVIDE) {
-					if (!g_of_f(op, b1, trhs, &n_trhs, tlhs, &n_tlhs))
+					start = clock();
+					if (!tally(S_G_OF_F, start, g_of_f(op, b1, trhs, &n_trhs, tlhs, &n_tlhs)))
 						return false;
 					goto simp_again;
 				}
@@ -259,7 +624,8 @@ no_simp:
 						p1->level++;
 					break;
 				}
-				if (!g_of_f(op, b1, trhs, &n_trhs, tlhs, &n_tlhs))
+				start = clock();
+				if (!tally(S_G_OF_F, start, g_of_f(op, b1, trhs, &n_trhs, tlhs, &n_tlhs)))
 					return false;
 				goto simp_again;
 			} else if (p1->level == 1 && p1->kind == OPERATOR) {
@@ -275,6 +641,8 @@ left_again:
 	worked = true;
 	uf_flag = false;
 see_work:
+	if (!solve_step())
+		return false;
 	if (found_var(trhs, n_trhs, v)) {
 		/* solve variable in RHS */
 		debug_string(1, _("Solve variable moved back to RHS, quitting solve routine."));
@@ -401,7 +769,8 @@ zero_simp:
 							}
 						}
 					}
-					if (!g_of_f(op, b1, tlhs, &n_tlhs, trhs, &n_trhs))
+					start = clock();
+					if (!tally(S_G_OF_F, start, g_of_f(op, b1, tlhs, &n_tlhs, trhs, &n_trhs)))
 						return false;
 					list_tdebug(2);
 					if (uf_flag) {
@@ -457,7 +826,8 @@ zero_simp:
 					trhs[0].token.constant = 0.0;
 				}
 				if (need_flip >= found_count) {
-					if (!flip(tlhs, &n_tlhs, trhs, &n_trhs))
+					start = clock();
+					if (!tally(S_FLIP, start, flip(tlhs, &n_tlhs, trhs, &n_trhs)))
 						return false;
 					list_tdebug(2);
 					simps_side(tlhs, &n_tlhs, zsolve);
@@ -468,10 +838,12 @@ zero_simp:
 				if (worked && !uf_flag) {
 					worked = false;
 					debug_string(1, _("Unfactoring..."));
+					start = clock();
 					partial_flag = false;
 					uf_simp(tlhs, &n_tlhs);
 					partial_flag = true;
 					factorv(tlhs, &n_tlhs, v);
+					tally(S_UNFACTOR, start, true);
 					list_tdebug(1);
 					uf_flag = true;
 					goto see_work;
@@ -539,7 +911,8 @@ zero_simp:
 						debug_string(1, _("Juggling..."));
 						uf_flag = true;
 					}
-					if (!g_of_f(op, b1, tlhs, &n_tlhs, trhs, &n_trhs))
+					start = clock();
+					if (!tally(S_G_OF_F, start, g_of_f(op, b1, tlhs, &n_tlhs, trhs, &n_trhs)))
 						return false;
 					goto simp_again;
 				}
@@ -573,7 +946,8 @@ zero_simp:
 						return false;
 					zero_solved = false;
 					qtries = 0;
-					if (!increase(b1->token.constant, v)) {
+					start = clock();
+					if (!tally(S_INCREASE, start, increase(b1->token.constant, v))) {
 						return false;
 					}
 					uf_flag = true;
@@ -586,17 +960,21 @@ zero_simp:
 				blt(leftp, tlhs, n_tlhs * sizeof(*leftp));
 				*rightnp = n_trhs;
 				blt(rightp, trhs, n_trhs * sizeof(*rightp));
-				if (solve_sub(&zero_token, 1, leftp, leftnp, rightp, rightnp) <= 0)
+				if (solve_main(&zero_token, 1, leftp, leftnp, rightp, rightnp) <= 0)
 					return false;
 				if (zero_solved) {
 					qtries++;
 				}
 				zero_solved = true;
-				if (poly_solve(v)) {
+				start = clock();
+				if (tally(S_POLY, start, poly_solve(v))) {
+					goto left_again;
+				}
+				start = clock();
+				if (tally(S_NUMERIC, start, numeric_poly_solve(v))) {
 					goto left_again;
-				} else {
-					goto simp_again;
 				}
+				goto simp_again;
 			} else {
 fin1:
 				found = 0;
@@ -1074,6 +1452,338 @@ big_bbreak:
 	return true;
 }
 
+/*
+ * Compare function for qsort(3) of complex roots:
+ * real roots first, in ascending order, then the complex roots by real, then imaginary part.
+ */
+static int
+root_cmp(p1, p2)
+complexs	*p1, *p2;
+{
+	if ((p1->im == 0.0) != (p2->im == 0.0))
+		return((p1->im == 0.0) ? -1 : 1);
+	if (p1->re != p2->re)
+		return((p1->re < p2->re) ? -1 : 1);
+	if (p1->im != p2->im)
+		return((p1->im < p2->im) ? -1 : 1);
+	return 0;
+}
+
+/*
+ * Evaluate the polynomial with the "n" + 1 coefficients "a" at "z" by Horner's rule,
+ * also returning its derivative in "*dp"
+ * and a bound on the round-off error of the result in "*ep".
+ */
+static complexs
+poly_eval(a, n, z, dp, ep)
+complexs	*a;
+int		n;
+complexs	z, *dp;
+double		*ep;
+{
+	complexs	p, d;
+	double		e, az;
+
+	p = a[n];
+	d.re = d.im = 0.0;
+	az = sqrt(z.re * z.re + z.im * z.im);
+	e = sqrt(p.re * p.re + p.im * p.im);
+	for (n--; n >= 0; n--) {
+		d = complex_add(complex_mult(d, z), p);
+		p = complex_add(complex_mult(p, z), a[n]);
+		e = e * az + sqrt(a[n].re * a[n].re + a[n].im * a[n].im);
+	}
+	*dp = d;
+	*ep = 4.0 * DBL_EPSILON * e;
+	return p;
+}
+
+static double
+complex_abs(c)
+complexs	c;
+{
+	return sqrt(c.re * c.re + c.im * c.im);
+}
+
+/*
+ * Numerically solve a polynomial equation with numeric coefficients, of any degree,
+ * when poly_solve() can't solve it symbolically.
+ * All complex roots are found at once with the Aberth-Ehrlich iteration,
+ * then polished with Newton's method on the original polynomial.
+ * The last root is the solution, the other roots are kept for store_extra_roots(),
+ * so this is only done when the caller wants them.
+ *
+ * The equation to solve is in tlhs and trhs, it must already be solved for zero.
+ *
+ * Return true if successful, with solved equation in tlhs and trhs.
+ */
+static int
+numeric_poly_solve(v)
+long	v;	/* solve variable */
+{
+	int		i, j, k, t1, t2, f1, fop, level;
+	int		n, n_terms = 0, degree = 0, n_zero = 0, n_roots, n_free = 0;
+	int		iter, converged;
+	int		*powers = NULL;
+	complexs	*terms = NULL, *a = NULL, *b = NULL, *z = NULL;
+	char		*mult = NULL;
+	complexs	c, coef, p, d, w, s, one;
+	double		power, r, bound, e;
+	int		rv = false;
+
+	if (n_tlhs != 1 || tlhs[0].kind != CONSTANT || tlhs[0].token.constant != 0.0)
+		return false;
+	if (!want_all_roots) {
+		solve_limited = true;	/* the numeric roots can't be stored here, but might be another time */
+		return false;
+	}
+	if ((powers = (int *) malloc((n_trhs / 2 + 1) * sizeof(int))) == NULL
+	    || (terms = (complexs *) malloc((n_trhs / 2 + 1) * sizeof(complexs))) == NULL) {
+		goto done;
+	}
+/* Get the numeric coefficient and power of "v" of each term. */
+	for (t1 = 0; t1 < n_trhs; t1 = t2 + 1) {
+		for (t2 = t1 + 1; t2 < n_trhs; t2 += 2) {
+			if (trhs[t2].level == 1 && (trhs[t2].token.operatr == PLUS || trhs[t2].token.operatr == MINUS))
+				break;
+		}
+		coef.re = (t1 > 0 && trhs[t1-1].token.operatr == MINUS) ? -1.0 : 1.0;
+		coef.im = 0.0;
+		power = 0.0;
+		level = min_level(&trhs[t1], t2 - t1);
+		for (i = t1 + 1; i < t2; i += 2) {
+			if (trhs[i].level == level && trhs[i].token.operatr != TIMES && trhs[i].token.operatr != DIVIDE)
+				break;
+		}
+		if (i < t2)
+			level = 0;	/* not a product, so the whole term is one factor */
+		fop = TIMES;
+		for (f1 = t1, j = t1 + 1;; j += 2) {
+			if (j < t2 && !(trhs[j].level == level && trhs[j].kind == OPERATOR))
+				continue;
+			k = j - f1;
+			if (found_var(&trhs[f1], k, v)) {
+				if (fop != TIMES || trhs[f1].kind != VARIABLE || trhs[f1].token.variable != v)
+					goto done;
+				if (k == 1) {
+					power += 1.0;
+				} else if (k == 3 && trhs[f1+1].token.operatr == POWER
+				    && trhs[f1+2].kind == CONSTANT && trhs[f1+2].token.constant >= 1.0
+				    && trhs[f1+2].token.constant <= N_EQUATIONS
+				    && fmod(trhs[f1+2].token.constant, 1.0) == 0.0) {
+					power += trhs[f1+2].token.constant;
+				} else {
+					goto done;
+				}
+			} else {
+				if (!parse_complex(&trhs[f1], k, &c))
+					goto done;
+				if (fop == DIVIDE)
+					coef = complex_div(coef, c);
+				else
+					coef = complex_mult(coef, c);
+			}
+			if (j >= t2)
+				break;
+			fop = trhs[j].token.operatr;
+			f1 = j + 1;
+		}
+		if (power > N_EQUATIONS)
+			goto done;
+		powers[n_terms] = power;
+		terms[n_terms++] = coef;
+		degree = max(degree, (int) power);
+	}
+	if (degree < 1)
+		goto done;
+	for (i = 0; i < N_EQUATIONS; i++) {
+		if (empty_equation_space(i))
+			n_free++;
+	}
+	if (degree - 1 > n_free) {
+		warning(_("Not enough free equation spaces to hold all numeric roots."));
+		solve_limited = true;
+		goto done;
+	}
+	if ((a = (complexs *) calloc(degree + 1, sizeof(complexs))) == NULL
+	    || (b = (complexs *) malloc((degree + 1) * sizeof(complexs))) == NULL
+	    || (z = (complexs *) malloc(degree * sizeof(complexs))) == NULL
+	    || (mult = (char *) calloc(degree, sizeof(char))) == NULL) {
+		goto done;
+	}
+	for (i = 0; i < n_terms; i++) {
+		a[powers[i]] = complex_add(a[powers[i]], terms[i]);
+	}
+	for (n = degree; n > 0 && a[n].re == 0.0 && a[n].im == 0.0; n--)
+		;
+	if (n < 1)
+		goto done;
+/* Zero roots are exact. */
+	for (n_zero = 0; n_zero < n && a[n_zero].re == 0.0 && a[n_zero].im == 0.0; n_zero++) {
+		z[n_zero].re = z[n_zero].im = 0.0;
+	}
+	n_roots = n;
+	n -= n_zero;
+	a += n_zero;
+	if (n > 0) {
+/* Start on a circle around the centroid of the roots, with a radius bounding all roots. */
+		c = complex_div(a[n-1], a[n]);
+		c.re /= -n;
+		c.im /= -n;
+		bound = 0.0;
+		for (i = 0; i < n; i++) {
+			p = complex_div(a[i], a[n]);
+			bound = max(bound, pow(complex_abs(p), 1.0 / (n - i)));
+		}
+		for (i = 0; i < n; i++) {
+			r = 2.0 * M_PI * i / n + 0.4;
+			z[n_zero+i].re = c.re + bound * cos(r);
+			z[n_zero+i].im = c.im + bound * sin(r);
+		}
+		one.re = 1.0;
+		one.im = 0.0;
+		for (iter = 0, converged = false; !converged && iter < MAX_ROOT_ITERATIONS; iter++) {
+			converged = true;
+			for (i = n_zero; i < n_roots; i++) {
+				p = poly_eval(a, n, z[i], &d, &e);
+				if (complex_abs(p) <= e)
+					continue;	/* as accurate as it can get */
+				converged = false;
+				w = complex_div(p, d);
+				s.re = s.im = 0.0;
+				for (j = n_zero; j < n_roots; j++) {
+					if (j != i) {
+						c.re = z[i].re - z[j].re;
+						c.im = z[i].im - z[j].im;
+						s = complex_add(s, complex_div(one, c));
+					}
+				}
+				c = complex_mult(w, s);
+				c.re = 1.0 - c.re;
+				c.im = -c.im;
+				w = complex_div(w, c);
+				z[i].re -= w.re;
+				z[i].im -= w.im;
+			}
+		}
+		if (!converged) {
+			warning(_("Numeric polynomial root finding did not converge."));
+			goto done;
+		}
+/*
+ * Multiple roots only converge to a cluster of approximations.
+ * A root of multiplicity k is a simple root of the (k-1)th derivative,
+ * so find that with Newton's method, starting at the mean of the cluster.
+ */
+		for (i = n_zero; i < n_roots; i++) {
+			if (mult[i])
+				continue;
+			c = z[i];
+			for (k = 1, j = i + 1; j < n_roots; j++) {
+				w.re = z[j].re - z[i].re;
+				w.im = z[j].im - z[i].im;
+				if (!mult[j] && complex_abs(w) <= 0.01 * max(1.0, complex_abs(z[i]))) {
+					c = complex_add(c, z[j]);
+					k++;
+				}
+			}
+			if (k == 1)
+				continue;
+			c.re /= k;
+			c.im /= k;
+			for (j = 0; j <= n - k + 1; j++) {
+				b[j] = a[j+k-1];
+				for (t1 = 1; t1 < k; t1++) {
+					b[j].re *= j + t1;
+					b[j].im *= j + t1;
+				}
+			}
+			for (iter = 0; iter < 20; iter++) {
+				p = poly_eval(b, n - k + 1, c, &d, &e);
+				if (complex_abs(p) <= e || (d.re == 0.0 && d.im == 0.0))
+					break;
+				w = complex_div(p, d);
+				c.re -= w.re;
+				c.im -= w.im;
+			}
+			if (complex_abs(poly_eval(a, n, c, &d, &e)) > k * e)
+				continue;	/* not a multiple root after all */
+			w = z[i];
+			for (j = i; j < n_roots; j++) {
+				s.re = z[j].re - w.re;
+				s.im = z[j].im - w.im;
+				if (!mult[j] && complex_abs(s) <= 0.01 * max(1.0, complex_abs(w))) {
+					z[j] = c;
+					mult[j] = true;
+				}
+			}
+		}
+/* Polish the simple roots with Newton's method, while it helps, and clean up round-off error. */
+		for (i = n_zero; i < n_roots; i++) {
+			for (k = 0; !mult[i] && k < 3; k++) {
+				p = poly_eval(a, n, z[i], &d, &e);
+				if (complex_abs(p) <= e || (d.re == 0.0 && d.im == 0.0))
+					break;
+				w = complex_div(p, d);
+				c.re = z[i].re - w.re;
+				c.im = z[i].im - w.im;
+				if (complex_abs(poly_eval(a, n, c, &d, &e)) >= complex_abs(p))
+					break;
+				z[i] = c;
+			}
+		}
+/* The non-real roots of a real polynomial are in conjugate pairs, so a root without its conjugate is real. */
+		for (i = 0; i <= n && a[i].im == 0.0; i++)
+			;
+		for (k = n_zero; i > n && k < n_roots; k++) {
+			if (z[k].im == 0.0)
+				continue;
+			for (j = n_zero; j < n_roots; j++) {
+				w.re = z[j].re - z[k].re;
+				w.im = z[j].im + z[k].im;
+				if (j != k && complex_abs(w) < fabs(z[k].im))
+					break;
+			}
+			if (j >= n_roots)
+				z[k].im = 0.0;
+		}
+		for (i = n_zero; i < n_roots; i++) {
+			complex_fixup(&z[i]);
+		}
+	}
+	qsort((char *) z, n_roots, sizeof(*z), root_cmp);
+	for (i = 1, j = 1; i < n_roots; i++) {
+		if (z[i].re != z[j-1].re || z[i].im != z[j-1].im)
+			z[j++] = z[i];
+	}
+	n_roots = j;
+/* The last root is the solution; the others are stored by store_extra_roots(). */
+	tlhs[0].level = 1;
+	tlhs[0].kind = VARIABLE;
+	tlhs[0].token.variable = v;
+	n_tlhs = 1;
+	n_trhs = complex_tokens(z[n_roots-1], trhs);
+	free(extra_roots);
+	extra_roots = z;
+	n_extra_roots = n_roots - 1;
+	z = NULL;
+#if	!SILENT
+	if (debug_level >= 0) {
+		fprintf(gfp, _("Equation was solved numerically, finding %d root%s.\n"), n_roots, (n_roots == 1) ? "" : "s");
+	}
+#endif
+	rv = true;
+done:
+	free(powers);
+	free(terms);
+	if (a)
+		free(a - n_zero);
+	free(b);
+	free(z);
+	free(mult);
+	return rv;
+}
+
 /*
  * This is the heart of Mathomatic solving:
  * It applies an identical mathematical operation to both sides of an equation.
@@ -1391,3 +2101,612 @@ int		*side2np;
 	side2p->token.operatr = DIVIDE;
 	return true;
 }
+
+/*
+ * The linear system solver of the "solve linear" command.
+ * The augmented coefficient matrix is kept here, one malloc()ed expression per entry,
+ * row r, column c being lin_cell[r*(lin_size+1)+c].  Column lin_size is the right-hand side.
+ */
+static token_type	**lin_cell;
+static int		*lin_len;
+static int		lin_size;
+static token_type	*lin_buf;	/* work area of n_tokens tokens */
+static double		*lin_lu;	/* LU decomposition of a numeric matrix */
+static double		*lin_inv;	/* the inverse matrix, or the solutions if lin_numeric_rhs */
+static int		lin_numeric_rhs;
+
+#define	LIN_CELL(r, c)	lin_cell[(r) * (lin_size + 1) + (c)]
+#define	LIN_LEN(r, c)	lin_len[(r) * (lin_size + 1) + (c)]
+
+static void
+lin_nomem(void)
+{
+	error(_("Out of memory (can't malloc(3))."));
+	longjmp(jmp_save, 2);
+}
+
+/*
+ * Free the matrix of the previous linear system and allocate one for an n by n system,
+ * with all entries 0.
+ */
+static void
+lin_alloc(n)
+int	n;
+{
+	int	k;
+
+	if (lin_cell) {
+		for (k = 0; k < lin_size * (lin_size + 1); k++) {
+			free(lin_cell[k]);
+		}
+		free(lin_cell);
+		free(lin_len);
+		lin_cell = NULL;
+		lin_len = NULL;
+	}
+	free(lin_lu);
+	lin_lu = NULL;
+	lin_size = n;
+	if (lin_buf == NULL && (lin_buf = (token_type *) malloc(n_tokens * sizeof(token_type))) == NULL) {
+		lin_nomem();
+	}
+	lin_cell = (token_type **) calloc(n * (n + 1), sizeof(token_type *));
+	lin_len = (int *) calloc(n * (n + 1), sizeof(int));
+	if (lin_cell == NULL || lin_len == NULL) {
+		lin_nomem();
+	}
+}
+
+/*
+ * Store expression "p1" of length "n" in matrix entry (r, c).
+ */
+static void
+lin_store(r, c, p1, n)
+int		r, c;
+token_type	*p1;
+int		n;
+{
+	token_type	*p2;
+
+	if ((p2 = (token_type *) realloc(LIN_CELL(r, c), n * sizeof(token_type))) == NULL) {
+		lin_nomem();
+	}
+	blt(p2, p1, n * sizeof(token_type));
+	LIN_CELL(r, c) = p2;
+	LIN_LEN(r, c) = n;
+}
+
+static int
+lin_is_constant(r, c)
+int	r, c;
+{
+	return(LIN_LEN(r, c) == 0 || (LIN_LEN(r, c) == 1 && LIN_CELL(r, c)[0].kind == CONSTANT));
+}
+
+static double
+lin_constant(r, c)
+int	r, c;
+{
+	return(LIN_LEN(r, c) ? LIN_CELL(r, c)[0].token.constant : 0.0);
+}
+
+static int
+lin_is_zero(r, c)
+int	r, c;
+{
+	return(lin_is_constant(r, c) && lin_constant(r, c) == 0.0);
+}
+
+/*
+ * Append expression "p1" of length "n" to lin_buf[] at position "i", with its levels increased by "add".
+ * An empty expression is 0.
+ *
+ * Return the new length of lin_buf[].
+ */
+static int
+lin_append(i, p1, n, add)
+int		i;
+token_type	*p1;
+int		n, add;
+{
+	int	k;
+
+	if (n == 0) {
+		p1 = &zero_token;
+		n = 1;
+	}
+	if (i + n > n_tokens) {
+		error_huge();
+	}
+	for (k = 0; k < n; k++, i++) {
+		lin_buf[i] = p1[k];
+		lin_buf[i].level += add;
+	}
+	return i;
+}
+
+/*
+ * Append operator "op" to lin_buf[] at position "i", at level "level".
+ */
+static int
+lin_op(i, op, level)
+int	i, op, level;
+{
+	if (i >= n_tokens) {
+		error_huge();
+	}
+	lin_buf[i].kind = OPERATOR;
+	lin_buf[i].level = level;
+	lin_buf[i].token.operatr = op;
+	return(i + 1);
+}
+
+/*
+ * Add a term of equation side "p1", the term from p1[i1] to p1[i2-1], to matrix entry (r, c).
+ * Variable "v" in the term, if not 0, is replaced with 1.
+ */
+static void
+lin_add_term(r, c, op, p1, i1, i2, v)
+int		r, c, op;
+token_type	*p1;
+int		i1, i2;
+long		v;
+{
+	int	i, n;
+
+	n = lin_append(0, LIN_CELL(r, c), LIN_LEN(r, c), 0);
+	n = lin_op(n, op, 1);
+	i = n;
+	n = lin_append(n, &p1[i1], i2 - i1, 1);
+	for (; i < n; i++) {
+		if (lin_buf[i].kind == VARIABLE && lin_buf[i].token.variable == v) {
+			lin_buf[i].kind = CONSTANT;
+			lin_buf[i].token.constant = 1.0;
+		}
+	}
+	lin_store(r, c, lin_buf, n);
+}
+
+/*
+ * Put equation space "en" in row "r" of the matrix, as coefficients of the "n" variables in "va".
+ *
+ * Return false if it is not linear in those variables.
+ */
+static int
+lin_extract(r, en, va, n)
+int	r, en;
+long	*va;
+int	n;
+{
+	int	i, j, k, c, col, n1, count, min_level, op;
+
+	n1 = lin_append(0, lhs[en], n_lhs[en], 1);
+	n1 = lin_op(n1, MINUS, 1);
+	n1 = lin_append(n1, rhs[en], n_rhs[en], 1);
+	n_tes = n1;
+	blt(tes, lin_buf, n1 * sizeof(token_type));
+	partial_flag = false;
+	uf_simp(tes, &n_tes);
+	partial_flag = true;
+	for (i = 0; i < n_tes; i = j + 1) {
+		op = (i > 0) ? tes[i-1].token.operatr : PLUS;
+		min_level = tes[i].level;
+		for (j = i; j < n_tes && !(tes[j].level == 1 && tes[j].kind == OPERATOR
+		    && (tes[j].token.operatr == PLUS || tes[j].token.operatr == MINUS)); j++) {
+			if (tes[j].level < min_level)
+				min_level = tes[j].level;
+		}
+		count = 0;
+		col = n;
+		for (k = i; k < j; k++) {
+			if (tes[k].kind != VARIABLE)
+				continue;
+			for (c = 0; c < n; c++) {
+				if (tes[k].token.variable == va[c])
+					break;
+			}
+			if (c >= n)
+				continue;
+			if (++count > 1 || tes[k].level != min_level
+			    || (k > i && tes[k-1].token.operatr != TIMES)
+			    || (k + 1 < j && tes[k+1].token.operatr != TIMES && tes[k+1].token.operatr != DIVIDE)) {
+				return false;
+			}
+			col = c;
+		}
+		if (count) {
+			lin_add_term(r, col, op, tes, i, j, va[col]);
+		} else {
+			lin_add_term(r, n, (op == PLUS) ? MINUS : PLUS, tes, i, j, 0L);
+		}
+	}
+	return true;
+}
+
+
+/*
+ * Append the product of matrix entries (r1, c1) and (r2, c2) to lin_buf[] at position "i".
+ */
+static int
+lin_product(i, r1, c1, r2, c2)
+int	i, r1, c1, r2, c2;
+{
+	i = lin_append(i, LIN_CELL(r1, c1), LIN_LEN(r1, c1), 2);
+	i = lin_op(i, TIMES, 2);
+	return lin_append(i, LIN_CELL(r2, c2), LIN_LEN(r2, c2), 2);
+}
+
+/*
+ * Divide the expression in lin_buf[] of length "n" by matrix entry (r, c).
+ * Polynomial division is tried first, because the fraction-free algorithm
+ * only divides when the division is known to be exact.
+ *
+ * Return the length of the quotient, which is left in lin_buf[].
+ */
+static int
+lin_divide(n, r, c)
+int	n, r, c;
+{
+	int	i;
+	long	v = 0;
+
+	if (lin_is_constant(r, c) && lin_constant(r, c) == 1.0)
+		return n;
+	if (n == 1 && lin_buf[0].kind == CONSTANT && lin_buf[0].token.constant == 0.0)
+		return n;
+	if (!lin_is_constant(r, c) && poly_div(lin_buf, n, LIN_CELL(r, c), LIN_LEN(r, c), &v) == 2) {
+		blt(lin_buf, tlhs, n_tlhs * sizeof(token_type));
+		n = n_tlhs;
+		uf_simp(lin_buf, &n);
+		return n;
+	}
+	for (i = 0; i < n; i++)
+		lin_buf[i].level++;
+	n = lin_op(n, DIVIDE, 1);
+	n = lin_append(n, LIN_CELL(r, c), LIN_LEN(r, c), 1);
+	if (lin_is_constant(r, c)) {
+		uf_simp(lin_buf, &n);
+	} else {
+		simpa_side(lin_buf, &n, false, false);
+	}
+	return n;
+}
+
+/*
+ * Solve the matrix by fraction-free Gaussian elimination (the Bareiss algorithm),
+ * for symbolic coefficients.  Every division is exact,
+ * so the entries stay polynomials if the coefficients are polynomials.
+ * Afterwards, column lin_size holds the solutions multiplied by the determinant,
+ * which is in the last diagonal entry.
+ *
+ * Return false if the matrix is singular.
+ */
+static int
+lin_bareiss(void)
+{
+	int		i, j, k, p, n, size = lin_size;
+	token_type	*tp;
+
+	for (k = 0; k < size; k++) {
+/* Select the smallest nonzero pivot, to keep the expressions small. */
+		p = -1;
+		for (i = k; i < size; i++) {
+			if (!lin_is_zero(i, k) && (p < 0 || LIN_LEN(i, k) < LIN_LEN(p, k)))
+				p = i;
+		}
+		if (p < 0)
+			return false;
+		if (p != k) {
+			for (j = 0; j <= size; j++) {
+				tp = LIN_CELL(k, j);
+				LIN_CELL(k, j) = LIN_CELL(p, j);
+				LIN_CELL(p, j) = tp;
+				n = LIN_LEN(k, j);
+				LIN_LEN(k, j) = LIN_LEN(p, j);
+				LIN_LEN(p, j) = n;
+			}
+		}
+		for (i = k + 1; i < size; i++) {
+			for (j = k + 1; j <= size; j++) {
+				n = lin_product(0, k, k, i, j);
+				if (!lin_is_zero(i, k) && !lin_is_zero(k, j)) {
+					n = lin_op(n, MINUS, 1);
+					n = lin_product(n, i, k, k, j);
+				}
+				uf_simp(lin_buf, &n);
+				if (k > 0)
+					n = lin_divide(n, k - 1, k - 1);
+				lin_store(i, j, lin_buf, n);
+			}
+			lin_store(i, k, &zero_token, 1);
+		}
+	}
+/* Fraction-free back substitution. */
+	for (i = size - 2; i >= 0; i--) {
+		n = lin_product(0, size - 1, size - 1, i, size);
+		for (j = i + 1; j < size; j++) {
+			if (!lin_is_zero(i, j)) {
+				n = lin_op(n, MINUS, 1);
+				n = lin_product(n, i, j, j, size);
+			}
+		}
+		uf_simp(lin_buf, &n);
+		n = lin_divide(n, i, i);
+		lin_store(i, size, lin_buf, n);
+	}
+	return true;
+}
+
+/*
+ * Solve the matrix by LU decomposition with partial pivoting, for numeric coefficients.
+ * If the right-hand sides are numeric too, the first column of lin_inv[] is set to the solutions,
+ * otherwise lin_inv[] is set to the inverse matrix, for lin_solution().
+ *
+ * Return false if the matrix is singular.
+ */
+static int
+lin_lu_solve(void)
+{
+	int	i, j, k, p, size = lin_size;
+	double	*a, *inv, *z, d, largest = 0.0;
+	int	*perm;
+
+	if ((lin_lu = (double *) malloc((2 * size * size + size) * sizeof(double) + size * sizeof(int))) == NULL) {
+		lin_nomem();
+	}
+	a = lin_lu;
+	inv = lin_inv = &a[size*size];
+	z = &inv[size*size];
+	perm = (int *) &z[size];
+	lin_numeric_rhs = true;
+	for (i = 0; i < size; i++) {
+		perm[i] = i;
+		for (j = 0; j < size; j++) {
+			a[i*size+j] = lin_constant(i, j);
+			largest = max(largest, fabs(a[i*size+j]));
+		}
+		if (!lin_is_constant(i, size))
+			lin_numeric_rhs = false;
+	}
+	for (k = 0; k < size; k++) {
+		p = k;
+		for (i = k + 1; i < size; i++) {
+			if (fabs(a[i*size+k]) > fabs(a[p*size+k]))
+				p = i;
+		}
+		if (fabs(a[p*size+k]) <= size * DBL_EPSILON * largest)
+			return false;
+		if (p != k) {
+			for (j = 0; j < size; j++) {
+				d = a[k*size+j];
+				a[k*size+j] = a[p*size+j];
+				a[p*size+j] = d;
+			}
+			i = perm[k];
+			perm[k] = perm[p];
+			perm[p] = i;
+		}
+		for (i = k + 1; i < size; i++) {
+			a[i*size+k] /= a[k*size+k];
+			for (j = k + 1; j < size; j++) {
+				a[i*size+j] -= a[i*size+k] * a[k*size+j];
+			}
+		}
+	}
+/* Solve for each column of the identity matrix, or just once for numeric right-hand sides. */
+	for (k = 0; k < (lin_numeric_rhs ? 1 : size); k++) {
+		for (i = 0; i < size; i++) {
+			if (lin_numeric_rhs)
+				z[i] = lin_constant(perm[i], size);
+			else
+				z[i] = (perm[i] == k);
+			for (j = 0; j < i; j++)
+				z[i] -= a[i*size+j] * z[j];
+		}
+		for (i = size - 1; i >= 0; i--) {
+			for (j = i + 1; j < size; j++)
+				z[i] -= a[i*size+j] * z[j];
+			z[i] /= a[i*size+i];
+			inv[i*size+k] = z[i];
+		}
+	}
+	return true;
+}
+
+/*
+ * Put the solution for unknown number "r" in lin_buf[].
+ *
+ * Return its length.
+ */
+static int
+lin_solution(r, numeric_flag)
+int	r, numeric_flag;
+{
+	int	k, n, size = lin_size;
+
+	if (!numeric_flag) {
+/* Divide out the determinant. */
+		n = lin_append(0, LIN_CELL(r, size), LIN_LEN(r, size), 1);
+		n = lin_op(n, DIVIDE, 1);
+		return lin_append(n, LIN_CELL(size - 1, size - 1), LIN_LEN(size - 1, size - 1), 1);
+	}
+	if (lin_numeric_rhs) {
+		lin_buf[0] = zero_token;
+		lin_buf[0].token.constant = lin_inv[r*size];
+		return 1;
+	}
+	n = lin_append(0, &zero_token, 1, 1);
+	for (k = 0; k < size; k++) {
+		if (lin_inv[r*size+k] == 0.0)
+			continue;
+		n = lin_op(n, PLUS, 1);
+		n = lin_append(n, &zero_token, 1, 2);
+		lin_buf[n-1].token.constant = lin_inv[r*size+k];
+		n = lin_op(n, TIMES, 2);
+		n = lin_append(n, LIN_CELL(k, size), LIN_LEN(k, size), 2);
+	}
+	return n;
+}
+
+/*
+ * The "solve linear" command.
+ * Solves a system of n linear equations in n unknowns, all at once,
+ * by extracting the coefficient matrix and eliminating on it directly,
+ * instead of substituting equations into each other with the eliminate command.
+ * Each solution is stored in a new equation space.
+ *
+ * Return true if successful.
+ */
+int
+solve_linear(cp)
+char	*cp;
+{
+	int	i, j, r, n, n_rows = 0, n_vars = 0, n_free = 0;
+	int	start, stop;
+	int	numeric_flag = true;
+	int	rows[N_EQUATIONS], ens[N_EQUATIONS];
+	long	va[N_EQUATIONS], v, last_v;
+	char	buf[MAX_CMD_LEN];
+#if	LIBRARY
+	char	*str;
+#endif
+
+	if (!get_range(&cp, &start, &stop)) {
+		warning(_("No equations to solve."));
+		return false;
+	}
+	if (strcmp_tospace(cp, "for") == 0) {
+		cp = skip_param(cp);
+	}
+	for (i = start; i <= stop; i++) {
+		if (n_lhs[i] > 0 && n_rhs[i] > 0) {
+			rows[n_rows++] = i;
+		}
+	}
+	while (*cp) {
+		if ((cp = parse_var2(&v, cp)) == NULL) {
+			return false;
+		}
+		if (n_vars >= ARR_CNT(va)) {
+			error(_("Too many variables specified."));
+			return false;
+		}
+		for (j = 0; j < n_vars; j++) {
+			if (va[j] == v) {
+				error(_("Variable specified more than once."));
+				return false;
+			}
+		}
+		va[n_vars++] = v;
+	}
+	if (n_rows == 0) {
+		warning(_("No equations to solve."));
+		return false;
+	}
+	show_usage = false;
+	if (n_vars == 0) {
+/* Solve for all normal variables, in order. */
+		for (last_v = 0;;) {
+			v = -1;
+			for (r = 0; r < n_rows; r++) {
+				i = rows[r];
+				for (j = 0; j < n_lhs[i]; j += 2) {
+					if (lhs[i][j].kind == VARIABLE && (lhs[i][j].token.variable & VAR_MASK) > SIGN
+					    && lhs[i][j].token.variable > last_v && (v == -1 || lhs[i][j].token.variable < v)) {
+						v = lhs[i][j].token.variable;
+					}
+				}
+				for (j = 0; j < n_rhs[i]; j += 2) {
+					if (rhs[i][j].kind == VARIABLE && (rhs[i][j].token.variable & VAR_MASK) > SIGN
+					    && rhs[i][j].token.variable > last_v && (v == -1 || rhs[i][j].token.variable < v)) {
+						v = rhs[i][j].token.variable;
+					}
+				}
+			}
+			if (v == -1)
+				break;
+			if (n_vars >= ARR_CNT(va)) {
+				error(_("Too many variables."));
+				return false;
+			}
+			va[n_vars++] = last_v = v;
+		}
+	}
+	if (n_vars != n_rows) {
+		snprintf(buf, sizeof(buf), _("Found %d equations and %d unknowns; the number of each must be the same."), n_rows, n_vars);
+		error(buf);
+		return false;
+	}
+	for (i = 0; i < N_EQUATIONS; i++) {
+		if (empty_equation_space(i))
+			n_free++;
+	}
+	if (n_rows > n_free) {
+		error(_("Not enough free equation spaces to hold the solutions."));
+		return false;
+	}
+	lin_alloc(n_rows);
+	for (r = 0; r < n_rows; r++) {
+		if (!lin_extract(r, rows[r], va, n_vars)) {
+			snprintf(buf, sizeof(buf), _("Equation #%d is not linear in the solve variables."), rows[r] + 1);
+			error(buf);
+			return false;
+		}
+		for (j = 0; j <= n_vars; j++) {
+			n = lin_append(0, LIN_CELL(r, j), LIN_LEN(r, j), 0);
+			uf_simp(lin_buf, &n);
+			lin_store(r, j, lin_buf, n);
+			if (j < n_vars && !lin_is_constant(r, j))
+				numeric_flag = false;
+		}
+	}
+#if	!SILENT
+	if (debug_level >= 0) {
+		fprintf(gfp, _("Solving %d linear equation%s by %s...\n"), n_rows, (n_rows == 1) ? "" : "s",
+		    numeric_flag ? _("LU decomposition") : _("fraction-free Gaussian elimination"));
+	}
+#endif
+	if (!(numeric_flag ? lin_lu_solve() : lin_bareiss())) {
+		error(_("The system of equations is singular, so it has no unique solution."));
+		return false;
+	}
+	for (r = 0; r < n_rows; r++) {
+		n = lin_solution(r, numeric_flag);
+		ens[r] = next_espace();
+		lhs[ens[r]][0].level = 1;
+		lhs[ens[r]][0].kind = VARIABLE;
+		lhs[ens[r]][0].token.variable = va[r];
+		n_lhs[ens[r]] = 1;
+		blt(rhs[ens[r]], lin_buf, n * sizeof(token_type));
+		n_rhs[ens[r]] = n;
+		simpa_repeat_side(rhs[ens[r]], &n_rhs[ens[r]], true, false);
+	}
+#if	!LIBRARY
+	for (r = 0; r < n_rows - 1; r++) {
+		list_sub(ens[r]);
+	}
+#endif
+	cur_equation = ens[n_rows-1];
+	if (!return_result(cur_equation)) {
+		return false;
+	}
+#if	LIBRARY
+	free_result_str();
+	for (r = 0, n = 0; r < n_rows; r++) {
+		if ((cp = list_equation(ens[r], false)) == NULL) {
+			return false;
+		}
+		if ((str = (char *) realloc(result_str, n + strlen(cp) + 2)) == NULL) {
+			free(cp);
+			return false;
+		}
+		result_str = str;
+		if (n)
+			result_str[n++] = '\n';
+		strcpy(&result_str[n], cp);
+		n += strlen(cp);
+		free(cp);
+	}
+#endif
+	return true;
+}
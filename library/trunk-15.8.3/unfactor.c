@@ -25,6 +25,10 @@ George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
 #include "includes.h"
 
 static int unf_sub(token_type *equation, int *np, int b1, int loc, int e1, int level, int ii);
+static int fast_poly_times(token_type *equation, int *np, int b1, int e1, int level);
+
+#define	FAST_EXPAND_MIN_TERMS	64	/* minimum number of term products for fast_poly_times() to be used */
+#define	FAST_EXPAND_MAX_POWER	1000	/* maximum exponent expanded by fast_poly_times() */
 
 /*
  * Unfactor times and divide only (products of sums) and simplify.
@@ -309,6 +313,8 @@ int		ii;
 	case DIVIDE:
 		if (ii != 1)
 			break;
+		if (fast_poly_times(equation, np, b1, e1, level))
+			return true;
 		for (i = b1 + 1; i < e1; i += 2) {
 			if (equation[i].level == level + 1) {
 				switch (equation[i].token.operatr) {
@@ -750,3 +756,255 @@ int		*np;
 	}
 	return modified;
 }
+
+/*
+ * Convert the expression in equation[b1] through equation[e1-1], whose base level is "level",
+ * into a newly malloc()ed dense coefficient array in *cpp,
+ * if it is a polynomial with constant coefficients in a single normal variable.
+ * The polynomial variable is returned in *vp, which must be 0 on the first call.
+ *
+ * Return the number of coefficients (degree + 1),
+ * or 0 if the expression is not such a polynomial.
+ */
+static int
+get_coefs(equation, b1, e1, level, vp, cpp)
+token_type	*equation;
+int		b1, e1, level;
+long		*vp;
+double		**cpp;
+{
+	int	i, j, op, n, n1, n2;
+	double	d, *c = NULL, *c1, *c2, *t;
+
+	*cpp = NULL;
+	if (e1 - b1 == 1) {
+		switch (equation[b1].kind) {
+		case CONSTANT:
+			if (!isfinite(equation[b1].token.constant))
+				return 0;
+			if ((c = (double *) malloc(sizeof(double))) == NULL)
+				return 0;
+			c[0] = equation[b1].token.constant;
+			*cpp = c;
+			return 1;
+		case VARIABLE:
+			if ((equation[b1].token.variable & VAR_MASK) <= SIGN)
+				return 0;
+			if (*vp == 0)
+				*vp = equation[b1].token.variable;
+			if (equation[b1].token.variable != *vp)
+				return 0;
+			if ((c = (double *) malloc(2 * sizeof(double))) == NULL)
+				return 0;
+			c[0] = 0.0;
+			c[1] = 1.0;
+			*cpp = c;
+			return 2;
+		default:
+			return 0;
+		}
+	}
+	for (op = 0, i = b1 + 1; i < e1; i += 2) {
+		if (equation[i].level == level) {
+			if (op == POWER)
+				return 0;	/* a^b^c not handled */
+			op = equation[i].token.operatr;
+		}
+	}
+	if (op == 0)
+		return get_coefs(equation, b1, e1, level + 1, vp, cpp);
+	n = 0;
+	op = 0;
+	for (i = b1; i < e1; i = j + 1) {
+		for (j = i + 1; j < e1 && equation[j].level > level; j += 2)
+			;
+		if ((n1 = get_coefs(equation, i, j, level + 1, vp, &c1)) == 0)
+			goto fail;
+		if (op == 0) {
+			c = c1;
+			n = n1;
+		} else {
+			switch (op) {
+			case PLUS:
+			case MINUS:
+				if (n1 > n) {
+					t = c;
+					c = c1;
+					c1 = t;
+					n2 = n;
+					n = n1;
+					n1 = n2;
+					if (op == MINUS) {
+						for (n2 = 0; n2 < n; n2++)
+							c[n2] = -c[n2];
+						op = PLUS;
+					}
+				}
+				for (n2 = 0; n2 < n1; n2++) {
+					if (op == MINUS)
+						c[n2] -= c1[n2];
+					else
+						c[n2] += c1[n2];
+				}
+				free(c1);
+				break;
+			case TIMES:
+				if (n + n1 - 1 > n_tokens || (c2 = (double *) malloc((n + n1 - 1) * sizeof(double))) == NULL) {
+					free(c1);
+					goto fail;
+				}
+				coef_multiply(c2, c, n, c1, n1);
+				free(c);
+				free(c1);
+				c = c2;
+				n += n1 - 1;
+				break;
+			case DIVIDE:
+				if (n1 != 1 || c1[0] == 0.0) {
+					free(c1);
+					goto fail;
+				}
+				for (n2 = 0; n2 < n; n2++)
+					c[n2] /= c1[0];
+				free(c1);
+				break;
+			case POWER:
+				d = c1[0];
+				free(c1);
+				if (n1 != 1 || d < 0.0 || d > FAST_EXPAND_MAX_POWER || fmod(d, 1.0) != 0.0
+				    || (n - 1) * d + 1 > n_tokens) {
+					goto fail;
+				}
+				if ((c1 = (double *) malloc(sizeof(double))) == NULL)
+					goto fail;
+				c1[0] = 1.0;
+				n1 = 1;
+				for (; d > 0.0; d -= 1.0) {
+					if ((c2 = (double *) malloc((n + n1 - 1) * sizeof(double))) == NULL) {
+						free(c1);
+						goto fail;
+					}
+					coef_multiply(c2, c1, n1, c, n);
+					free(c1);
+					c1 = c2;
+					n1 += n - 1;
+				}
+				free(c);
+				c = c1;
+				n = n1;
+				break;
+			default:
+				free(c1);
+				goto fail;
+			}
+		}
+		if (j < e1)
+			op = equation[j].token.operatr;
+	}
+	*cpp = c;
+	return n;
+fail:
+	if (c)
+		free(c);
+	return 0;
+}
+
+/*
+ * Quickly expand a large product of polynomials in the same variable,
+ * in equation[b1] through equation[e1-1], whose base level is "level",
+ * by multiplying their dense coefficient arrays with coef_multiply(),
+ * instead of distributing one term at a time.
+ * Only used when there are at least FAST_EXPAND_MIN_TERMS term products to do,
+ * so small expansions are done the usual way.
+ *
+ * Return true if the product was replaced with the expanded polynomial.
+ */
+static int
+fast_poly_times(equation, np, b1, e1, level)
+token_type	*equation;
+int		*np;
+int		b1, e1, level;
+{
+	int	i, j, n, len, terms, sums;
+	double	work, *c;
+	long	v = 0;
+
+/* estimate the work of the usual expansion: */
+	work = 1.0;
+	sums = 0;
+	for (i = b1; i < e1; i = j + 1) {
+		terms = 1;
+		for (j = i + 1; j < e1 && equation[j].level > level; j += 2) {
+			if (equation[j].level == level + 1 && (equation[j].token.operatr == PLUS || equation[j].token.operatr == MINUS))
+				terms++;
+		}
+		if (terms > 1)
+			sums++;
+		work *= terms;
+	}
+	if (sums < 2 || work < FAST_EXPAND_MIN_TERMS)
+		return false;
+	if ((n = get_coefs(equation, b1, e1, level, &v, &c)) == 0)
+		return false;
+	if (v == 0) {
+		free(c);
+		return false;
+	}
+	for (len = 0, i = 0; i < n; i++) {
+		if (c[i] != 0.0)
+			len += 6;
+	}
+	if (len == 0)
+		len = 1;
+	if (*np - (e1 - b1) + len > n_tokens) {
+		free(c);
+		return false;
+	}
+/* build the expanded polynomial in scratch[]: */
+	for (len = 0, i = 0; i < n; i++) {
+		if (c[i] == 0.0)
+			continue;
+		if (len) {
+			scratch[len].kind = OPERATOR;
+			scratch[len].level = level;
+			scratch[len].token.operatr = (c[i] < 0.0) ? MINUS : PLUS;
+			len++;
+			c[i] = fabs(c[i]);
+		}
+		scratch[len].kind = CONSTANT;
+		scratch[len].level = (i == 0) ? level : (level + 1);
+		scratch[len].token.constant = c[i];
+		len++;
+		if (i == 0)
+			continue;
+		scratch[len].kind = OPERATOR;
+		scratch[len].level = level + 1;
+		scratch[len].token.operatr = TIMES;
+		len++;
+		scratch[len].kind = VARIABLE;
+		scratch[len].level = (i == 1) ? (level + 1) : (level + 2);
+		scratch[len].token.variable = v;
+		len++;
+		if (i == 1)
+			continue;
+		scratch[len].kind = OPERATOR;
+		scratch[len].level = level + 2;
+		scratch[len].token.operatr = POWER;
+		len++;
+		scratch[len].kind = CONSTANT;
+		scratch[len].level = level + 2;
+		scratch[len].token.constant = i;
+		len++;
+	}
+	free(c);
+	if (len == 0) {
+		scratch[0].kind = CONSTANT;
+		scratch[0].level = level;
+		scratch[0].token.constant = 0.0;
+		len = 1;
+	}
+	blt(&equation[b1+len], &equation[e1], (*np - e1) * sizeof(token_type));
+	*np += len - (e1 - b1);
+	blt(&equation[b1], scratch, len * sizeof(token_type));
+	return true;
+}